@@ -0,0 +1,251 @@
+// measures how long it takes to decompress nav tiles: with deflate into a
+// buffer grown as the output arrives, which is how loose nav files are read,
+// with deflate into a buffer of the known size, and with lz4, which are the
+// two ways nav archives may store their tiles.  the tiles are synthetic
+// unless nav files are given, in which case their tiles are used.  the tiles
+// are laid out like real ones: a packed height field of a rolling terrain
+// followed by mesh vertices and polygons.  the benchmark fails if any of the
+// ways does not reproduce the tiles exactly.
+//
+// build and run with: make bench
+// or with real data:  bench/decompress_bench /path/to/Nav/<map>/*.nav
+
+#include "Common.hpp"
+#include "pathfind/Tile.hpp"
+#include "utility/BinaryStream.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+using Bytes = std::vector<std::uint8_t>;
+
+Bytes MakeTile(int seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> noise(0, 3);
+
+    utility::BinaryStream out(1024 * 1024);
+
+    constexpr int width = MeshSettings::TileVoxelSize + 8;
+    out << width << width;
+
+    // one span per column on open ground, more where something overhangs
+    for (auto y = 0; y < width; ++y)
+        for (auto x = 0; x < width; ++x)
+        {
+            auto const ground = static_cast<std::uint32_t>(
+                200 + 40 * std::sin((x + seed) * 0.05) * std::cos(y * 0.04));
+            auto const spans = noise(random) == 0 ? 2u : 1u;
+
+            out << spans;
+            for (auto s = 0u; s < spans; ++s)
+                out << ground + 60 * s << ground + 60 * s + 4 + noise(random)
+                    << std::uint32_t(63);
+        }
+
+    // the mesh: a grid of vertices on the terrain and quads between them
+    constexpr int vertices = 96;
+    for (auto y = 0; y < vertices; ++y)
+        for (auto x = 0; x < vertices; ++x)
+            out << x * 0.35f << 20.f * std::sin((x + seed) * 0.05f) << y * 0.35f;
+
+    for (auto y = 0; y + 1 < vertices; ++y)
+        for (auto x = 0; x + 1 < vertices; ++x)
+        {
+            auto const v = static_cast<std::uint16_t>(y * vertices + x);
+            out << v << static_cast<std::uint16_t>(v + 1)
+                << static_cast<std::uint16_t>(v + vertices + 1)
+                << static_cast<std::uint16_t>(v + vertices)
+                << static_cast<std::uint16_t>(noise(random))
+                << std::uint8_t(1) << std::uint8_t(4);
+        }
+
+    Bytes result(out.wpos());
+    out.rpos(0);
+    out.ReadBytes(result.data(), result.size());
+    return result;
+}
+
+// the tiles of a loose nav file, as they are stored in an archive
+bool ReadTiles(const char* path, std::vector<Bytes>& tiles)
+{
+    utility::BinaryStream in {std::filesystem::path(path)};
+    in.Decompress();
+
+    std::uint32_t header[6];
+    in >> header;
+
+    if (header[0] != MeshSettings::FileSignature ||
+        header[1] != MeshSettings::FileVersion)
+        return false;
+
+    for (auto i = 0u; i < header[5]; ++i)
+    {
+        auto const start = in.rpos();
+        pathfind::Tile::Skip(in);
+
+        if (in.rpos() > in.wpos())
+            return false;
+
+        Bytes tile(in.rpos() - start);
+        in.rpos(start);
+        in.ReadBytes(tile.data(), tile.size());
+        tiles.push_back(std::move(tile));
+    }
+
+    return true;
+}
+
+enum class Way
+{
+    Growing,
+    KnownSize,
+    Lz4,
+};
+
+const char* WayName(Way way)
+{
+    switch (way)
+    {
+        case Way::Growing:
+            return "deflate, growing";
+        case Way::KnownSize:
+            return "deflate, known size";
+        case Way::Lz4:
+            return "lz4";
+    }
+
+    return "unknown";
+}
+
+bool Measure(const std::vector<Bytes>& tiles, Way way)
+{
+    auto const compression =
+        way == Way::Lz4 ? utility::Compression::Lz4
+                        : utility::Compression::Deflate;
+
+    std::vector<Bytes> compressed;
+    std::size_t original = 0, packed = 0;
+
+    for (auto tile : tiles)
+    {
+        original += tile.size();
+
+        utility::BinaryStream stream(tile);
+        stream.Compress(compression);
+
+        Bytes data(stream.wpos());
+        stream.ReadBytes(data.data(), data.size());
+        packed += data.size();
+
+        compressed.push_back(std::move(data));
+    }
+
+    double best = 0;
+    auto matches = true;
+
+    for (auto round = 0; round < 5; ++round)
+    {
+        auto const start = std::chrono::steady_clock::now();
+
+        for (auto i = 0u; i < compressed.size(); ++i)
+        {
+            auto data = compressed[i];
+            utility::BinaryStream stream(data);
+
+            if (way == Way::Growing)
+                stream.Decompress();
+            else
+                stream.Decompress(tiles[i].size(), compression);
+
+            if (round == 0)
+            {
+                Bytes result(stream.wpos());
+                stream.ReadBytes(result.data(), result.size());
+                matches = matches && result == tiles[i];
+            }
+        }
+
+        auto const end = std::chrono::steady_clock::now();
+        auto const elapsed =
+            std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (round == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(20)
+              << std::left << WayName(way) << std::right << std::setw(8)
+              << packed / 1024.0 << " KiB" << std::setw(8) << best << " ms"
+              << std::setw(8) << original / best / 1000.0 << " MB/s"
+              << std::endl;
+
+    if (!matches)
+        std::cerr << WayName(way) << " did not reproduce the tiles"
+                  << std::endl;
+
+    return matches;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<Bytes> tiles;
+
+    try
+    {
+        for (auto i = 1; i < argc; ++i)
+            if (!ReadTiles(argv[i], tiles))
+            {
+                std::cerr << argv[i] << " is not a nav file" << std::endl;
+                return EXIT_FAILURE;
+            }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 1)
+        for (auto i = 0; i < 64; ++i)
+            tiles.push_back(MakeTile(i));
+
+    std::size_t size = 0;
+    for (auto const& tile : tiles)
+        size += tile.size();
+
+    std::cout << tiles.size() << " tiles, " << std::fixed
+              << std::setprecision(1) << size / 1024.0 << " KiB" << std::endl;
+
+    for (auto way : {Way::Growing, Way::KnownSize, Way::Lz4})
+        if (!Measure(tiles, way))
+            return EXIT_FAILURE;
+
+    // a damaged lz4 block must be rejected rather than read past its end
+    auto tile = tiles.front();
+    utility::BinaryStream stream(tile);
+    stream.Compress(utility::Compression::Lz4);
+    stream.wpos(stream.wpos() / 2);
+
+    try
+    {
+        stream.Decompress(tiles.front().size(), utility::Compression::Lz4);
+        std::cerr << "a truncated lz4 block was accepted" << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+// measures the memory of model trees and the cost of ray casts against them,
+// before and after compacting them.  the models are synthetic (a rippled,
+// folded sheet of triangles, which gives the tree many overlapping boxes) in
+// two sizes: one with few enough vertices for 16 bit indices and one with
+// more, which the compact tree still indexes in 16 bits from the base of each
+// block of faces.  the full trees are serialized and loaded again first, so
+// that they are measured as they are after loading a model.  every ray is cast
+// against both trees, and the benchmark fails if the compact tree misses a
+// hit.
+//
+// build and run with: make bench
+
+#include "utility/AABBTree.hpp"
+#include "utility/BinaryStream.hpp"
+#include "utility/Ray.hpp"
+#include "utility/Vector.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+void BuildSheet(int size, std::vector<math::Vertex>& vertices,
+                std::vector<int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    for (auto y = 0; y <= size; ++y)
+        for (auto x = 0; x <= size; ++x)
+            vertices.push_back(
+                {static_cast<float>(x),
+                 static_cast<float>(y) + 4.f * std::sin(x * 0.05f),
+                 6.f * std::sin(x * 0.3f) * std::cos(y * 0.2f)});
+
+    auto const vertex = [size](int x, int y) { return y * (size + 1) + x; };
+
+    for (auto y = 0; y < size; ++y)
+        for (auto x = 0; x < size; ++x)
+        {
+            indices.insert(indices.end(), {vertex(x, y), vertex(x + 1, y),
+                                           vertex(x, y + 1)});
+            indices.insert(indices.end(), {vertex(x + 1, y),
+                                           vertex(x + 1, y + 1),
+                                           vertex(x, y + 1)});
+        }
+}
+
+std::vector<math::Ray> MakeRays(int size, int count)
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> horizontal(-5.f, size + 5.f);
+    std::uniform_real_distribution<float> vertical(-20.f, 20.f);
+
+    std::vector<math::Ray> rays;
+    rays.reserve(count);
+
+    for (auto i = 0; i < count; ++i)
+    {
+        // mostly short, steep rays, as for height and line of sight queries
+        auto const x = horizontal(random), y = horizontal(random);
+        rays.emplace_back(math::Vertex {x, y, vertical(random)},
+                          math::Vertex {x + vertical(random) * 0.5f,
+                                        y + vertical(random) * 0.5f,
+                                        vertical(random)});
+    }
+
+    return rays;
+}
+
+// nanoseconds per ray for the nearest hit, and the distances found
+double CastNearest(const math::AABBTree& tree,
+                   const std::vector<math::Ray>& rays,
+                   std::vector<float>& distances)
+{
+    distances.clear();
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (auto ray : rays)
+        distances.push_back(tree.IntersectRay(ray) ? ray.GetDistance() : 2.f);
+
+    auto const end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           rays.size();
+}
+
+// nanoseconds per ray for every hit, and the number of hits found
+double CastAll(const math::AABBTree& tree, const std::vector<math::Ray>& rays,
+               std::size_t& hits)
+{
+    std::vector<float> distances;
+    hits = 0;
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (auto const& ray : rays)
+    {
+        distances.clear();
+        tree.IntersectRayAll(ray, distances);
+        hits += distances.size();
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           rays.size();
+}
+
+bool Compare(int size, int rayCount)
+{
+    std::vector<math::Vertex> vertices;
+    std::vector<int> indices;
+    BuildSheet(size, vertices, indices);
+
+    utility::BinaryStream stream;
+    math::AABBTree(vertices, indices).Serialize(stream);
+
+    math::AABBTree full, compact;
+    stream.rpos(0);
+    full.Deserialize(stream);
+    stream.rpos(0);
+    compact.Deserialize(stream);
+    compact.Compact();
+
+    auto const rays = MakeRays(size, rayCount);
+
+    std::vector<float> fullDistances, compactDistances;
+    std::size_t fullHits, compactHits;
+
+    // warm up both, so that the comparison is fair
+    CastNearest(full, rays, fullDistances);
+    CastNearest(compact, rays, compactDistances);
+
+    auto const fullNearest = CastNearest(full, rays, fullDistances);
+    auto const compactNearest = CastNearest(compact, rays, compactDistances);
+    auto const fullAll = CastAll(full, rays, fullHits);
+    auto const compactAll = CastAll(compact, rays, compactHits);
+
+    std::cout << vertices.size() << " vertices, " << indices.size() / 3
+              << " faces" << std::endl
+              << std::fixed << std::setprecision(1) << "  full     "
+              << std::setw(8) << full.MemoryUsage() / 1024.0 << " KiB"
+              << "   nearest " << std::setw(7) << fullNearest << " ns"
+              << "   all " << std::setw(7) << fullAll << " ns" << std::endl
+              << "  compact  " << std::setw(8)
+              << compact.MemoryUsage() / 1024.0 << " KiB"
+              << "   nearest " << std::setw(7) << compactNearest << " ns"
+              << "   all " << std::setw(7) << compactAll << " ns" << std::endl;
+
+    // the larger boxes of the compact tree may let it find a hit which the
+    // full tree skips, when the hit is within rounding of the entry distance
+    // of a box, but never the other way around
+    for (auto i = 0u; i < rays.size(); ++i)
+        if (compactDistances[i] > fullDistances[i] + 1e-5f)
+        {
+            std::cerr << "compact tree missed a hit" << std::endl;
+            return false;
+        }
+
+    if (compactHits < fullHits)
+    {
+        std::cerr << "compact tree missed a hit" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    auto const rays = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    if (rays <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [rays]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // fewer vertices than 16 bits can index, then more
+    if (!Compare(200, rays) || !Compare(300, rays))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,418 @@
+// measures the latency of rebuilding a tile mesh from its height field, with
+// and without the per-thread recast arena, and for each region partitioning
+// available to temporary obstacle rebuilds.  the height field is synthetic (a
+// rolling terrain with a scattering of box obstacles) and uses the same voxel
+// settings as real tiles, so the allocation pattern matches what a temporary
+// obstacle rebuild sees.  rebuilds for obstacle shapes, which start from the
+// packed spans of the tile, are measured as well.
+//
+// build and run with: make bench
+
+#include "Common.hpp"
+#include "pathfind/Map.hpp"
+#include "pathfind/RecastArena.hpp"
+#include "recastnavigation/Detour/Include/DetourAlloc.h"
+#include "recastnavigation/Detour/Include/DetourNavMeshBuilder.h"
+#include "recastnavigation/Recast/Include/Recast.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+void InitializeConfig(rcConfig& config)
+{
+    memset(&config, 0, sizeof(config));
+
+    config.cs = MeshSettings::CellSize;
+    config.ch = MeshSettings::CellHeight;
+    config.walkableSlopeAngle = MeshSettings::WalkableSlope;
+    config.walkableClimb = MeshSettings::VoxelWalkableClimb;
+    config.walkableHeight = MeshSettings::VoxelWalkableHeight;
+    config.walkableRadius = MeshSettings::VoxelWalkableRadius;
+    config.maxEdgeLen = config.walkableRadius * 4;
+    config.maxSimplificationError = MeshSettings::MaxSimplificationError;
+    config.minRegionArea = MeshSettings::MinRegionSize;
+    config.mergeRegionArea = MeshSettings::MergeRegionSize;
+    config.maxVertsPerPoly = MeshSettings::VerticesPerPolygon;
+    config.tileSize = MeshSettings::TileVoxelSize;
+    config.borderSize = config.walkableRadius + 3;
+    config.width = config.tileSize + config.borderSize * 2;
+    config.height = config.tileSize + config.borderSize * 2;
+    config.detailSampleDist = MeshSettings::DetailSampleDistance;
+    config.detailSampleMaxError = MeshSettings::DetailSampleMaxError;
+
+    auto const border = config.borderSize * config.cs;
+    config.bmin[0] = config.bmin[2] = -border;
+    config.bmax[0] = config.bmax[2] = MeshSettings::TileSize + border;
+    config.bmin[1] = -50.f;
+    config.bmax[1] = 50.f;
+}
+
+void AddQuad(std::vector<float>& verts, std::vector<int>& tris, float x0,
+             float z0, float x1, float z1, float y00, float y10, float y01,
+             float y11)
+{
+    auto const base = static_cast<int>(verts.size() / 3);
+
+    const float corners[] = {x0, y00, z0, x1, y10, z0,
+                             x0, y01, z1, x1, y11, z1};
+    verts.insert(verts.end(), std::begin(corners), std::end(corners));
+
+    const int indices[] = {base, base + 2, base + 1,
+                           base + 1, base + 2, base + 3};
+    tris.insert(tris.end(), std::begin(indices), std::end(indices));
+}
+
+void BuildHeightField(const rcConfig& config, rcHeightfield& solid)
+{
+    rcContext ctx(false);
+
+    if (!rcCreateHeightfield(&ctx, solid, config.width, config.height,
+                             config.bmin, config.bmax, config.cs, config.ch))
+    {
+        std::cerr << "rcCreateHeightfield failed" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<float> verts;
+    std::vector<int> tris;
+
+    // rolling terrain
+    constexpr int steps = 32;
+    auto const step = (config.bmax[0] - config.bmin[0]) / steps;
+    auto const height = [](float x, float z)
+    { return 2.f * std::sin(x * 0.15f) + 1.5f * std::cos(z * 0.2f); };
+
+    for (auto i = 0; i < steps; ++i)
+        for (auto j = 0; j < steps; ++j)
+        {
+            auto const x0 = config.bmin[0] + i * step;
+            auto const z0 = config.bmin[2] + j * step;
+            auto const x1 = x0 + step;
+            auto const z1 = z0 + step;
+
+            AddQuad(verts, tris, x0, z0, x1, z1, height(x0, z0),
+                    height(x1, z0), height(x0, z1), height(x1, z1));
+        }
+
+    // box obstacles, standing in for game objects
+    for (auto i = 0; i < 6; ++i)
+    {
+        auto const x0 = 3.f + i * 5.f;
+        auto const z0 = 4.f + (i % 3) * 9.f;
+        auto const top = height(x0, z0) + 3.f;
+
+        AddQuad(verts, tris, x0, z0, x0 + 2.5f, z0 + 2.5f, top, top, top,
+                top);
+    }
+
+    std::vector<unsigned char> areas(tris.size() / 3, 0);
+    auto const vertCount = static_cast<int>(verts.size() / 3);
+    auto const triCount = static_cast<int>(tris.size() / 3);
+
+    rcMarkWalkableTriangles(&ctx, config.walkableSlopeAngle, &verts[0],
+                            vertCount, &tris[0], triCount, &areas[0]);
+
+    for (auto& area : areas)
+        if (area)
+            area = PolyFlags::Ground;
+
+    rcRasterizeTriangles(&ctx, &verts[0], vertCount, &tris[0], &areas[0],
+                         triCount, solid, config.walkableClimb);
+
+    rcFilterLowHangingWalkableObstacles(&ctx, config.walkableClimb, solid);
+    rcFilterLedgeSpans(&ctx, config.walkableHeight, config.walkableClimb,
+                       solid);
+    rcFilterWalkableLowHeightSpans(&ctx, config.walkableHeight, solid);
+}
+
+bool BuildRegions(rcContext& ctx, const rcConfig& config,
+                  pathfind::RegionPartition partition,
+                  rcCompactHeightfield& chf)
+{
+    switch (partition)
+    {
+        case pathfind::RegionPartition::Monotone:
+            return rcBuildRegionsMonotone(&ctx, chf, config.borderSize,
+                                          config.minRegionArea,
+                                          config.mergeRegionArea);
+        case pathfind::RegionPartition::Layers:
+            return rcBuildLayerRegions(&ctx, chf, config.borderSize,
+                                       config.minRegionArea);
+        case pathfind::RegionPartition::Watershed:
+        default:
+            return rcBuildDistanceField(&ctx, chf) &&
+                   rcBuildRegions(&ctx, chf, config.borderSize,
+                                  config.minRegionArea,
+                                  config.mergeRegionArea);
+    }
+}
+
+// the recast stages of a temporary obstacle rebuild which follow compaction
+bool BuildMesh(const rcConfig& config, pathfind::RegionPartition partition,
+               rcCompactHeightfield& chf)
+{
+    rcContext ctx(false);
+
+    auto cset = rcAllocContourSet();
+    auto polyMesh = rcAllocPolyMesh();
+    auto polyMeshDetail = rcAllocPolyMeshDetail();
+
+    auto success =
+        BuildRegions(ctx, config, partition, chf) &&
+        rcBuildContours(&ctx, chf, config.maxSimplificationError,
+                        config.maxEdgeLen, *cset) &&
+        rcBuildPolyMesh(&ctx, *cset, config.maxVertsPerPoly, *polyMesh) &&
+        rcBuildPolyMeshDetail(&ctx, *polyMesh, chf, config.detailSampleDist,
+                              config.detailSampleMaxError, *polyMeshDetail);
+
+    if (success)
+    {
+        for (auto i = 0; i < polyMesh->npolys; ++i)
+            polyMesh->flags[i] = polyMesh->areas[i];
+
+        dtNavMeshCreateParams params;
+        memset(&params, 0, sizeof(params));
+
+        params.verts = polyMesh->verts;
+        params.vertCount = polyMesh->nverts;
+        params.polys = polyMesh->polys;
+        params.polyAreas = polyMesh->areas;
+        params.polyFlags = polyMesh->flags;
+        params.polyCount = polyMesh->npolys;
+        params.nvp = polyMesh->nvp;
+        params.detailMeshes = polyMeshDetail->meshes;
+        params.detailVerts = polyMeshDetail->verts;
+        params.detailVertsCount = polyMeshDetail->nverts;
+        params.detailTris = polyMeshDetail->tris;
+        params.detailTriCount = polyMeshDetail->ntris;
+        params.walkableHeight = MeshSettings::WalkableHeight;
+        params.walkableRadius = MeshSettings::WalkableRadius;
+        params.walkableClimb = MeshSettings::WalkableClimb;
+        memcpy(params.bmin, polyMesh->bmin, sizeof(polyMesh->bmin));
+        memcpy(params.bmax, polyMesh->bmax, sizeof(polyMesh->bmax));
+        params.cs = config.cs;
+        params.ch = config.ch;
+        params.buildBvTree = true;
+
+        unsigned char* outData;
+        int outDataSize;
+        success = dtCreateNavMeshData(&params, &outData, &outDataSize);
+
+        if (success)
+            dtFree(outData);
+    }
+
+    rcFreePolyMeshDetail(polyMeshDetail);
+    rcFreePolyMesh(polyMesh);
+    rcFreeContourSet(cset);
+
+    return success;
+}
+
+// the same sequence of recast stages as a temporary obstacle rebuild
+bool BuildMesh(const rcConfig& config, pathfind::RegionPartition partition,
+               rcHeightfield& solid)
+{
+    rcContext ctx(false);
+
+    auto chf = rcAllocCompactHeightfield();
+
+    auto const success =
+        rcBuildCompactHeightfield(&ctx, config.walkableHeight,
+                                  (std::numeric_limits<int>::max)(), solid,
+                                  *chf) &&
+        BuildMesh(config, partition, *chf);
+
+    rcFreeCompactHeightfield(chf);
+
+    return success;
+}
+
+// the same sequence as a rebuild for an obstacle shape: the packed spans are
+// expanded and compacted, a cylinder is stamped onto them and the mesh is
+// built
+bool BuildStampedMesh(const rcConfig& config,
+                      pathfind::RegionPartition partition,
+                      const pathfind::TileHeightField& packed)
+{
+    rcContext ctx(false);
+
+    pathfind::ObstacleShape shape;
+    shape.m_position = {-10.f, -10.f, 0.f};
+    shape.m_radius = 1.5f;
+    shape.m_height = 4.f;
+
+    std::vector<rcSpan> storage;
+    rcHeightfield solid;
+    packed.Expand(solid, storage);
+
+    auto chf = rcAllocCompactHeightfield();
+
+    auto success = rcBuildCompactHeightfield(
+        &ctx, config.walkableHeight, (std::numeric_limits<int>::max)(), solid,
+        *chf);
+
+    if (success)
+    {
+        shape.Stamp(ctx, *chf);
+        success = BuildMesh(config, partition, *chf);
+    }
+
+    rcFreeCompactHeightfield(chf);
+
+    return success;
+}
+
+void Report(const char* name, std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    double total = 0.0;
+    for (auto sample : samples)
+        total += sample;
+
+    auto const percentile = [&samples](double p)
+    { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::fixed << std::setprecision(1)
+              << " mean " << std::setw(8) << total / samples.size() << " us"
+              << "   p50 " << std::setw(8) << percentile(0.50) << " us"
+              << "   p99 " << std::setw(8) << percentile(0.99) << " us"
+              << std::endl;
+}
+
+template <typename Build>
+std::vector<double> Measure(int iterations, Build build)
+{
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    for (auto i = 0; i < iterations; ++i)
+    {
+        auto const start = std::chrono::steady_clock::now();
+
+        if (!build())
+        {
+            std::cerr << "mesh build failed" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        auto const end = std::chrono::steady_clock::now();
+
+        samples.push_back(
+            std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    return samples;
+}
+
+std::vector<double>
+Measure(int iterations, const rcConfig& config, rcHeightfield& solid,
+        pathfind::RegionPartition partition = pathfind::RegionPartition::Watershed)
+{
+    return Measure(iterations, [&]()
+                   { return BuildMesh(config, partition, solid); });
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    auto const iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    rcConfig config;
+    InitializeConfig(config);
+
+    rcHeightfield solid;
+    BuildHeightField(config, solid);
+
+    std::cout << "rebuilding a " << config.width << "x" << config.height
+              << " voxel tile " << iterations << " times" << std::endl;
+
+    // warm up the system allocator as well, so that the comparison is fair
+    Measure(10, config, solid);
+
+    auto withoutArena = Measure(iterations, config, solid);
+
+    auto& arena = pathfind::RecastArena::ThreadLocal();
+    std::size_t systemAllocations = 0;
+    std::vector<double> withArena;
+
+    {
+        pathfind::RecastArena::Scope scope(arena);
+
+        Measure(10, config, solid);
+        systemAllocations = arena.SystemAllocations();
+
+        withArena = Measure(iterations, config, solid);
+    }
+
+    Report("malloc", withoutArena);
+    Report("arena", withArena);
+
+    std::cout << "arena: " << arena.CachedBytes() / 1024
+              << " KiB cached, "
+              << arena.SystemAllocations() - systemAllocations
+              << " system allocations after warm up" << std::endl;
+
+    {
+        pathfind::RecastArena::Scope scope(arena);
+
+        auto monotone = Measure(iterations, config, solid,
+                                pathfind::RegionPartition::Monotone);
+        auto layers = Measure(iterations, config, solid,
+                              pathfind::RegionPartition::Layers);
+
+        std::cout << "region partitioning (with arena):" << std::endl;
+        Report("watershed", withArena);
+        Report("monotone", monotone);
+        Report("layers", layers);
+    }
+
+    {
+        pathfind::RecastArena::Scope scope(arena);
+
+        pathfind::TileHeightField packed(pathfind::NavFile {});
+        packed.m_width = solid.width;
+        packed.m_height = solid.height;
+        memcpy(packed.m_bmin, solid.bmin, sizeof(solid.bmin));
+        memcpy(packed.m_bmax, solid.bmax, sizeof(solid.bmax));
+        packed.m_cs = solid.cs;
+        packed.m_ch = solid.ch;
+        packed.Store(solid);
+
+        auto const stamp = [&](pathfind::RegionPartition partition)
+        {
+            return Measure(iterations, [&]()
+                           { return BuildStampedMesh(config, partition,
+                                                     packed); });
+        };
+
+        auto watershed = stamp(pathfind::RegionPartition::Watershed);
+        auto monotone = stamp(pathfind::RegionPartition::Monotone);
+        auto layers = stamp(pathfind::RegionPartition::Layers);
+
+        std::cout << "obstacle shapes on " << packed.MemoryUsage() / 1024
+                  << " KiB of packed spans (with arena):" << std::endl;
+        Report("watershed", watershed);
+        Report("monotone", monotone);
+        Report("layers", layers);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -205,6 +205,12 @@ enum class Result {
 
     FAILED_TO_FIND_POINT_BETWEEN_VECTORS = 89,
     DECOMPRESS_OUTPUT_TOO_LARGE = 90,
+    UNKNOWN_PATH_FILTER = 91,
+    CANNOT_FORK_MAP_WITH_TEMPORARY_OBSTACLES = 92,
+    FAILED_TO_OPEN_NAV_ARCHIVE = 93,
+    INVALID_NAV_ARCHIVE = 94,
+    NAV_ARCHIVE_READ_FAILED = 95,
+    LZ4_DECOMPRESS_FAILED = 96,
 
     UNKNOWN_EXCEPTION = 0xFF,
 };
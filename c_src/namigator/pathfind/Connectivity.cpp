@@ -0,0 +1,168 @@
+#include "Connectivity.hpp"
+
+#include <cassert>
+#include <utility>
+
+namespace pathfind
+{
+void Connectivity::AddTile(const dtNavMesh& navMesh, dtTileRef ref)
+{
+    auto const tile = navMesh.getTileByRef(ref);
+
+    if (!tile || !tile->header)
+        return;
+
+    InsertTile(navMesh, tile);
+    LinkTile(navMesh, tile);
+}
+
+void Connectivity::RemoveTile(const dtNavMesh& navMesh, dtTileRef ref)
+{
+    auto const index = navMesh.decodePolyIdTile(ref);
+
+    if (index >= m_tiles.size())
+        return;
+
+    m_removedNodes += m_tiles[index].m_count;
+    m_tiles[index] = {};
+
+    // once most nodes belong to removed tiles, start over.  this also splits
+    // any islands which were only connected through the removed tiles
+    if (m_removedNodes > m_parent.size() / 2)
+        Rebuild(navMesh);
+}
+
+bool Connectivity::Connected(const dtNavMesh& navMesh, dtPolyRef a,
+                             dtPolyRef b) const
+{
+    auto const nodeA = NodeOf(navMesh, a);
+    auto const nodeB = NodeOf(navMesh, b);
+
+    // polygons which are not labelled cannot be ruled out
+    if (nodeA == NoNode || nodeB == NoNode)
+        return true;
+
+    return Root(nodeA) == Root(nodeB);
+}
+
+std::uint32_t Connectivity::NodeOf(const dtNavMesh& navMesh,
+                                   dtPolyRef ref) const
+{
+    auto const index = navMesh.decodePolyIdTile(ref);
+    auto const poly = navMesh.decodePolyIdPoly(ref);
+
+    if (index >= m_tiles.size() || poly >= m_tiles[index].m_count)
+        return NoNode;
+
+    return m_tiles[index].m_first + poly;
+}
+
+std::uint32_t Connectivity::Root(std::uint32_t node) const
+{
+    while (m_parent[node] != node)
+        node = m_parent[node];
+
+    return node;
+}
+
+std::uint32_t Connectivity::Find(std::uint32_t node)
+{
+    while (m_parent[node] != node)
+    {
+        m_parent[node] = m_parent[m_parent[node]];
+        node = m_parent[node];
+    }
+
+    return node;
+}
+
+void Connectivity::Union(std::uint32_t a, std::uint32_t b)
+{
+    a = Find(a);
+    b = Find(b);
+
+    if (a == b)
+        return;
+
+    // attaching the smaller tree keeps the depth logarithmic, which bounds
+    // the cost of Root() since queries never flatten the forest
+    if (m_size[a] < m_size[b])
+        std::swap(a, b);
+
+    m_parent[b] = a;
+    m_size[a] += m_size[b];
+}
+
+void Connectivity::InsertTile(const dtNavMesh& navMesh, const dtMeshTile* tile)
+{
+    auto const index = navMesh.decodePolyIdTile(navMesh.getTileRef(tile));
+
+    if (m_tiles.size() <= index)
+        m_tiles.resize(navMesh.getMaxTiles());
+
+    assert(index < m_tiles.size());
+
+    auto const first = static_cast<std::uint32_t>(m_parent.size());
+    auto const count = static_cast<std::uint32_t>(tile->header->polyCount);
+
+    m_tiles[index] = {first, count};
+
+    for (auto i = first; i < first + count; ++i)
+    {
+        m_parent.push_back(i);
+        m_size.push_back(1);
+    }
+}
+
+void Connectivity::LinkTile(const dtNavMesh& navMesh, const dtMeshTile* tile)
+{
+    auto const first =
+        m_tiles[navMesh.decodePolyIdTile(navMesh.getTileRef(tile))].m_first;
+
+    // detour links the portal edges of neighbouring tiles in both directions,
+    // and our meshes have no off-mesh connections, so the links of a tile are
+    // enough to connect it to everything around it
+    for (auto i = 0; i < tile->header->polyCount; ++i)
+    {
+        auto const& poly = tile->polys[i];
+
+        for (auto link = poly.firstLink; link != DT_NULL_LINK;
+             link = tile->links[link].next)
+        {
+            auto const ref = tile->links[link].ref;
+
+            if (!ref)
+                continue;
+
+            auto const neighbour = NodeOf(navMesh, ref);
+
+            if (neighbour != NoNode)
+                Union(first + i, neighbour);
+        }
+    }
+}
+
+void Connectivity::Rebuild(const dtNavMesh& navMesh)
+{
+    m_tiles.assign(navMesh.getMaxTiles(), {});
+    m_parent.clear();
+    m_size.clear();
+    m_removedNodes = 0;
+
+    for (auto i = 0; i < navMesh.getMaxTiles(); ++i)
+    {
+        auto const tile = navMesh.getTile(i);
+
+        if (tile && tile->header)
+            InsertTile(navMesh, tile);
+    }
+
+    for (auto i = 0; i < navMesh.getMaxTiles(); ++i)
+    {
+        auto const tile = navMesh.getTile(i);
+
+        if (tile && tile->header)
+            LinkTile(navMesh, tile);
+    }
+}
+} // namespace pathfind
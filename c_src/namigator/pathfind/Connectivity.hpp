@@ -0,0 +1,66 @@
+#pragma once
+
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace pathfind
+{
+// labels every polygon of a navmesh with the island (connected component) it
+// belongs to, so that a path between two polygons on different islands can be
+// rejected without searching.
+//
+// islands are merged incrementally as tiles are added.  removing a tile cannot
+// split an island incrementally, so islands which were joined only through a
+// removed tile remain joined until enough polygons have been removed that the
+// labels are rebuilt from scratch.  this errs on the side of reporting two
+// polygons as connected, which only means that the path search is not skipped.
+//
+// every modification must be made with the owning map locked exclusively.
+// queries do not modify the labels, and may run concurrently with each other.
+class Connectivity
+{
+public:
+    // must be called after the tile has been added to the navmesh
+    void AddTile(const dtNavMesh& navMesh, dtTileRef ref);
+
+    // must be called after the tile has been removed from the navmesh
+    void RemoveTile(const dtNavMesh& navMesh, dtTileRef ref);
+
+    // false only when the two polygons are known to be on different islands
+    bool Connected(const dtNavMesh& navMesh, dtPolyRef a, dtPolyRef b) const;
+
+private:
+    // the range of nodes assigned to the polygons of a tile, by tile index
+    struct TileNodes
+    {
+        std::uint32_t m_first = 0;
+        std::uint32_t m_count = 0;
+    };
+
+    static constexpr std::uint32_t NoNode = 0xFFFFFFFF;
+
+    std::uint32_t NodeOf(const dtNavMesh& navMesh, dtPolyRef ref) const;
+
+    // finds the root of a node without modifying the labels, for queries
+    std::uint32_t Root(std::uint32_t node) const;
+
+    // finds the root of a node, flattening the path to it
+    std::uint32_t Find(std::uint32_t node);
+    void Union(std::uint32_t a, std::uint32_t b);
+
+    void InsertTile(const dtNavMesh& navMesh, const dtMeshTile* tile);
+    void LinkTile(const dtNavMesh& navMesh, const dtMeshTile* tile);
+    void Rebuild(const dtNavMesh& navMesh);
+
+    std::vector<TileNodes> m_tiles;
+
+    // union-find forest over every polygon, merged by size
+    std::vector<std::uint32_t> m_parent;
+    std::vector<std::uint32_t> m_size;
+
+    // nodes which belonged to tiles since removed
+    std::size_t m_removedNodes = 0;
+};
+} // namespace pathfind
@@ -0,0 +1,628 @@
+#include "Crowd.hpp"
+
+#include "Map.hpp"
+#include "recastnavigation/Detour/Include/DetourCommon.h"
+#include "utility/MathHelper.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+// velocity sampling, and the weights of the penalty of each sample.  these
+// are the defaults of detour's dtObstacleAvoidanceQuery
+constexpr int SampleRings = 3;
+constexpr int SampleDivisions = 8;
+constexpr float WeightDesired = 2.f;
+constexpr float WeightCurrent = 0.75f;
+constexpr float WeightImpact = 2.5f;
+constexpr float HorizonTime = 2.5f;
+
+// fraction of the overlap between two agents removed per iteration
+constexpr float SeparationFactor = 0.7f;
+constexpr int SeparationIterations = 4;
+
+// agents slow down within this many radii of the end of their corridor, and
+// stop within a tenth of a radius of it
+constexpr float SlowDownRadii = 2.f;
+constexpr float ArriveRadii = 0.1f;
+
+// times at which a circle moving with velocity v from c0 touches a circle at
+// c1, where r is the sum of their radii
+bool SweepCircle(const float* c0, const float* c1, float r, const float* v,
+                 float& tmin, float& tmax)
+{
+    float s[3];
+    dtVsub(s, c1, c0);
+
+    auto const a = dtVdot2D(v, v);
+
+    if (a < 0.0001f)
+        return false;
+
+    auto const b = dtVdot2D(v, s);
+    auto const c = dtVdot2D(s, s) - r * r;
+    auto const d = b * b - a * c;
+
+    if (d < 0.f)
+        return false;
+
+    auto const root = std::sqrt(d);
+
+    tmin = (b - root) / a;
+    tmax = (b + root) / a;
+
+    return true;
+}
+
+// time at which a ray from origin with velocity v crosses the segment pq
+bool RaySegment(const float* origin, const float* v, const float* p,
+                const float* q, float& t)
+{
+    float pq[3], w[3];
+    dtVsub(pq, q, p);
+    dtVsub(w, origin, p);
+
+    auto const d = dtVperp2D(v, pq);
+
+    if (std::fabs(d) < 1e-6f)
+        return false;
+
+    t = dtVperp2D(pq, w) / d;
+
+    if (t < 0.f || t > 1.f)
+        return false;
+
+    auto const s = dtVperp2D(v, w) / d;
+
+    return s >= 0.f && s <= 1.f;
+}
+
+std::int64_t CellKey(int x, int z)
+{
+    return static_cast<std::int64_t>(x) << 32 | static_cast<std::uint32_t>(z);
+}
+} // namespace
+
+namespace pathfind
+{
+Crowd::Agent::Agent(const PathCorridor& corridor, const dtQueryFilter& filter,
+                    const AgentParams& params)
+    : m_corridor(corridor), m_filter(filter), m_params(params),
+      m_position(), m_velocity(), m_desired(), m_moving(false),
+      m_wallsCenter{FLT_MAX, FLT_MAX, FLT_MAX}
+{
+}
+
+Crowd::Crowd(const Map& map) : m_map(map), m_nextId(1) {}
+
+bool Crowd::AddAgent(const math::Vertex& position, const AgentParams& params,
+                     std::uint32_t& id)
+{
+    return Insert(PathCorridor(m_map), m_map.m_queryFilter, position, params,
+                  id);
+}
+
+bool Crowd::AddAgent(const math::Vertex& position, const AgentParams& params,
+                     const std::string& filter, std::uint32_t& id)
+{
+    return Insert(PathCorridor(m_map, filter), m_map.GetPathFilter(filter),
+                  position, params, id);
+}
+
+bool Crowd::Insert(const PathCorridor& corridor, const dtQueryFilter& filter,
+                   const math::Vertex& position, const AgentParams& params,
+                   std::uint32_t& id)
+{
+    auto const agent = m_agents
+                           .emplace(std::piecewise_construct,
+                                    std::forward_as_tuple(m_nextId),
+                                    std::forward_as_tuple(corridor, filter,
+                                                          params))
+                           .first;
+
+    // an empty corridor places the agent on the navmesh
+    if (!agent->second.m_corridor.Reset(position, position))
+    {
+        m_agents.erase(agent);
+        return false;
+    }
+
+    math::Convert::VertexToRecast(agent->second.m_corridor.Position(),
+                                  agent->second.m_position);
+
+    id = m_nextId++;
+
+    return true;
+}
+
+bool Crowd::RemoveAgent(std::uint32_t id)
+{
+    return m_agents.erase(id) > 0;
+}
+
+bool Crowd::SetTarget(std::uint32_t id, const math::Vertex& target)
+{
+    auto const agent = m_agents.find(id);
+
+    if (agent == m_agents.end())
+        return false;
+
+    agent->second.m_moving = agent->second.m_corridor.MoveTarget(target);
+
+    return agent->second.m_moving;
+}
+
+bool Crowd::Stop(std::uint32_t id)
+{
+    auto const agent = m_agents.find(id);
+
+    if (agent == m_agents.end())
+        return false;
+
+    agent->second.m_moving = false;
+
+    return true;
+}
+
+void Crowd::Update(float dt)
+{
+    if (dt <= 0.f || m_agents.empty())
+        return;
+
+    {
+        std::shared_lock<std::shared_mutex> guard(m_map.m_mutex);
+        std::lock_guard<std::mutex> search(m_map.m_queryMutex);
+
+        for (auto& entry : m_agents)
+        {
+            auto& agent = entry.second;
+            auto const threshold = agent.QueryRange() * 0.25f;
+
+            if (dtVdist2DSqr(agent.m_position, agent.m_wallsCenter) >
+                threshold * threshold)
+                UpdateWalls(agent);
+        }
+    }
+
+    FindNeighbours();
+
+    for (auto& entry : m_agents)
+        Steer(entry.second);
+
+    // every agent chooses its new velocity from the current velocities of
+    // its neighbours before any of them change
+    std::vector<float> velocities(3 * m_agents.size());
+
+    auto velocity = velocities.begin();
+    for (auto& entry : m_agents)
+    {
+        Avoid(entry.second, &*velocity);
+        velocity += 3;
+    }
+
+    velocity = velocities.begin();
+    for (auto& entry : m_agents)
+    {
+        auto& agent = entry.second;
+
+        float change[3];
+        dtVsub(change, &*velocity, agent.m_velocity);
+
+        auto const maxChange = agent.m_params.m_maxAcceleration * dt;
+        auto const length = dtVlen(change);
+
+        if (length > maxChange)
+            dtVscale(change, change, maxChange / length);
+
+        dtVadd(agent.m_velocity, agent.m_velocity, change);
+        dtVmad(agent.m_position, agent.m_position, agent.m_velocity, dt);
+
+        velocity += 3;
+    }
+
+    Separate();
+
+    // the new positions are constrained to the navmesh by the corridors
+    for (auto& entry : m_agents)
+    {
+        auto& agent = entry.second;
+
+        float current[3];
+        math::Convert::VertexToRecast(agent.m_corridor.Position(), current);
+
+        if (dtVdist2DSqr(agent.m_position, current) < 1e-8f)
+        {
+            dtVcopy(agent.m_position, current);
+            continue;
+        }
+
+        math::Vertex position;
+        math::Convert::VertexToWow(agent.m_position, position);
+
+        if (!agent.m_corridor.MovePosition(position))
+        {
+            agent.m_moving = false;
+            dtVset(agent.m_velocity, 0.f, 0.f, 0.f);
+        }
+
+        math::Convert::VertexToRecast(agent.m_corridor.Position(),
+                                      agent.m_position);
+    }
+}
+
+void Crowd::GetAgents(std::vector<AgentState>& agents) const
+{
+    agents.clear();
+    agents.reserve(m_agents.size());
+
+    for (auto const& entry : m_agents)
+    {
+        AgentState state;
+        state.m_id = entry.first;
+        math::Convert::VertexToWow(entry.second.m_position, state.m_position);
+        math::Convert::VertexToWow(entry.second.m_velocity, state.m_velocity);
+        state.m_moving = entry.second.m_moving;
+
+        agents.push_back(state);
+    }
+}
+
+void Crowd::UpdateWalls(Agent& agent) const
+{
+    auto const& query = m_map.m_navQuery;
+    auto const range = agent.QueryRange();
+
+    dtVcopy(agent.m_wallsCenter, agent.m_position);
+    agent.m_walls.clear();
+
+    float const extents[] = {agent.m_params.m_radius, agent.m_params.m_height,
+                             agent.m_params.m_radius};
+
+    dtPolyRef ref;
+    float nearest[3];
+    if (dtStatusFailed(query.findNearestPoly(agent.m_position, extents,
+                                             &agent.m_filter, &ref, nearest)) ||
+        !ref)
+        return;
+
+    dtPolyRef polys[MaxLocalPolys];
+    int polyCount;
+    if (dtStatusFailed(query.findLocalNeighbourhood(
+            ref, agent.m_position, range, &agent.m_filter, polys, nullptr,
+            &polyCount, MaxLocalPolys)))
+        return;
+
+    float segments[6 * MaxWallSegments];
+    int segmentCount;
+
+    for (auto i = 0; i < polyCount; ++i)
+    {
+        if (dtStatusFailed(query.getPolyWallSegments(
+                polys[i], &agent.m_filter, segments, nullptr, &segmentCount,
+                MaxWallSegments)))
+            continue;
+
+        for (auto j = 0; j < segmentCount; ++j)
+        {
+            auto const segment = &segments[6 * j];
+
+            float t;
+            if (dtDistancePtSegSqr2D(agent.m_position, segment, segment + 3,
+                                     t) > range * range)
+                continue;
+
+            agent.m_walls.insert(agent.m_walls.end(), segment, segment + 6);
+        }
+    }
+}
+
+void Crowd::FindNeighbours()
+{
+    // a grid with cells as large as the longest query range, so that the
+    // neighbours of an agent are in the nine cells around it
+    auto cellSize = 1.f;
+    for (auto const& entry : m_agents)
+        cellSize = (std::max)(cellSize, entry.second.QueryRange());
+
+    std::unordered_map<std::int64_t, std::vector<const Agent*>> grid;
+
+    for (auto const& entry : m_agents)
+    {
+        auto const& agent = entry.second;
+        grid[CellKey(static_cast<int>(std::floor(agent.m_position[0] / cellSize)),
+                     static_cast<int>(std::floor(agent.m_position[2] / cellSize)))]
+            .push_back(&agent);
+    }
+
+    std::vector<std::pair<float, const Agent*>> candidates;
+
+    for (auto& entry : m_agents)
+    {
+        auto& agent = entry.second;
+        auto const range = agent.QueryRange();
+        auto const cellX =
+            static_cast<int>(std::floor(agent.m_position[0] / cellSize));
+        auto const cellZ =
+            static_cast<int>(std::floor(agent.m_position[2] / cellSize));
+
+        candidates.clear();
+
+        for (auto x = cellX - 1; x <= cellX + 1; ++x)
+            for (auto z = cellZ - 1; z <= cellZ + 1; ++z)
+            {
+                auto const cell = grid.find(CellKey(x, z));
+
+                if (cell == grid.end())
+                    continue;
+
+                for (auto const other : cell->second)
+                {
+                    if (other == &agent)
+                        continue;
+
+                    // agents on different floors do not meet
+                    auto const height = 0.5f * (agent.m_params.m_height +
+                                                other->m_params.m_height);
+
+                    if (std::fabs(agent.m_position[1] - other->m_position[1]) >=
+                        height)
+                        continue;
+
+                    auto const distance =
+                        dtVdist2DSqr(agent.m_position, other->m_position);
+
+                    if (distance < range * range)
+                        candidates.push_back({distance, other});
+                }
+            }
+
+        auto const count = (std::min)(candidates.size(),
+                                      static_cast<std::size_t>(MaxNeighbours));
+
+        std::partial_sort(candidates.begin(), candidates.begin() + count,
+                          candidates.end(),
+                          [](const std::pair<float, const Agent*>& a,
+                             const std::pair<float, const Agent*>& b)
+                          { return a.first < b.first; });
+
+        agent.m_neighbours.clear();
+        for (auto i = 0u; i < count; ++i)
+            agent.m_neighbours.push_back(candidates[i].second);
+    }
+}
+
+void Crowd::Steer(Agent& agent) const
+{
+    dtVset(agent.m_desired, 0.f, 0.f, 0.f);
+
+    if (!agent.m_moving)
+        return;
+
+    auto const corners = agent.m_corridor.Corners(2);
+
+    if (corners.empty())
+    {
+        agent.m_moving = false;
+        return;
+    }
+
+    auto const radius = agent.m_params.m_radius;
+
+    float corner[3];
+    math::Convert::VertexToRecast(corners[0], corner);
+
+    // a corner the agent is standing on has already been turned
+    if (corners.size() > 1 && dtVdist2DSqr(agent.m_position, corner) <
+                                  ArriveRadii * ArriveRadii * radius * radius)
+        math::Convert::VertexToRecast(corners[1], corner);
+
+    float end[3];
+    math::Convert::VertexToRecast(agent.m_corridor.Target(), end);
+
+    auto const last = dtVdist2DSqr(corner, end) < 1e-6f;
+    auto const distance = dtVdist2D(agent.m_position, corner);
+
+    if (last && distance < ArriveRadii * radius)
+    {
+        agent.m_moving = false;
+        return;
+    }
+
+    if (distance < 1e-6f)
+        return;
+
+    auto speed = agent.m_params.m_maxSpeed;
+
+    if (last)
+        speed *= (std::min)(1.f, distance / (SlowDownRadii * radius));
+
+    agent.m_desired[0] = (corner[0] - agent.m_position[0]) * speed / distance;
+    agent.m_desired[2] = (corner[2] - agent.m_position[2]) * speed / distance;
+}
+
+void Crowd::Avoid(Agent& agent, float* velocity) const
+{
+    dtVcopy(velocity, agent.m_desired);
+
+    if (agent.m_neighbours.empty() && agent.m_walls.empty())
+        return;
+
+    auto const radius = agent.m_params.m_radius;
+    auto const maxSpeed = agent.m_params.m_maxSpeed;
+
+    // penalty of a candidate velocity, for straying from the desired and
+    // current velocities, and for leading to a collision soon
+    auto const penalty = [&](const float* candidate)
+    {
+        auto impact = HorizonTime;
+
+        for (auto const neighbour : agent.m_neighbours)
+        {
+            // each of the two agents is expected to take half of the effort
+            // of avoiding the other
+            float relative[3];
+            dtVscale(relative, candidate, 2.f);
+            dtVsub(relative, relative, agent.m_velocity);
+            dtVsub(relative, relative, neighbour->m_velocity);
+
+            float tmin, tmax;
+            if (!SweepCircle(agent.m_position, neighbour->m_position,
+                             radius + neighbour->m_params.m_radius, relative,
+                             tmin, tmax))
+                continue;
+
+            // overlapping agents prefer the velocities which separate them
+            // soonest
+            if (tmin < 0.f && tmax > 0.f)
+                tmin = -tmin * 0.5f;
+
+            if (tmin >= 0.f)
+                impact = (std::min)(impact, tmin);
+        }
+
+        for (auto i = 0u; i < agent.m_walls.size(); i += 6)
+        {
+            auto const p = &agent.m_walls[i];
+            auto const q = p + 3;
+
+            float t;
+
+            if (dtDistancePtSegSqr2D(agent.m_position, p, q, t) <
+                radius * radius)
+            {
+                // touching the wall, so only moving away from it is safe
+                float edge[3], normal[3] = {};
+                dtVsub(edge, q, p);
+                normal[0] = -edge[2];
+                normal[2] = edge[0];
+
+                if (dtVdot2D(normal, candidate) < 0.f)
+                    continue;
+
+                t = 0.f;
+            }
+            else if (!RaySegment(agent.m_position, candidate, p, q, t))
+                continue;
+
+            // walls are avoided less eagerly than agents
+            impact = (std::min)(impact, t * 2.f);
+        }
+
+        return WeightDesired * dtVdist2D(candidate, agent.m_desired) /
+                   maxSpeed +
+               WeightCurrent * dtVdist2D(candidate, agent.m_velocity) /
+                   maxSpeed +
+               WeightImpact / (0.1f + impact / HorizonTime);
+    };
+
+    auto best = penalty(agent.m_desired);
+
+    float candidate[3] = {};
+    if (auto const stop = penalty(candidate); stop < best)
+    {
+        best = stop;
+        dtVset(velocity, 0.f, 0.f, 0.f);
+    }
+
+    // rings of directions around the desired one, at increasing speeds
+    auto const heading = std::atan2(agent.m_desired[2], agent.m_desired[0]);
+
+    for (auto ring = 1; ring <= SampleRings; ++ring)
+    {
+        auto const speed = maxSpeed * ring / SampleRings;
+        auto const offset = ring % 2 ? 0.f : PI / SampleDivisions;
+
+        for (auto i = 0; i < SampleDivisions; ++i)
+        {
+            auto const angle =
+                heading + offset + 2.f * PI * i / SampleDivisions;
+
+            candidate[0] = std::cos(angle) * speed;
+            candidate[2] = std::sin(angle) * speed;
+
+            auto const sample = penalty(candidate);
+
+            if (sample < best)
+            {
+                best = sample;
+                dtVcopy(velocity, candidate);
+            }
+        }
+    }
+}
+
+void Crowd::Separate()
+{
+    std::vector<float> displacements(3 * m_agents.size());
+
+    for (auto iteration = 0; iteration < SeparationIterations; ++iteration)
+    {
+        auto displacement = displacements.begin();
+
+        for (auto const& entry : m_agents)
+        {
+            auto const& agent = entry.second;
+            auto const total = &*displacement;
+            auto weight = 0.f;
+
+            dtVset(total, 0.f, 0.f, 0.f);
+
+            for (auto const neighbour : agent.m_neighbours)
+            {
+                float difference[3];
+                dtVsub(difference, agent.m_position, neighbour->m_position);
+                difference[1] = 0.f;
+
+                auto const distanceSquared = dtVlenSqr(difference);
+                auto const radius =
+                    agent.m_params.m_radius + neighbour->m_params.m_radius;
+
+                if (distanceSquared > radius * radius)
+                    continue;
+
+                auto distance = std::sqrt(distanceSquared);
+
+                // agents at the same point are pushed apart along an
+                // arbitrary axis, in opposite directions
+                if (distance < 0.0001f)
+                {
+                    dtVset(difference,
+                           std::less<const Agent*>()(&agent, neighbour) ? 1.f
+                                                                        : -1.f,
+                           0.f, 0.f);
+                    distance = 1.f;
+                }
+
+                // each agent moves half of the way
+                auto const push =
+                    0.5f * (radius - distance) * SeparationFactor / distance;
+
+                dtVmad(total, total, difference, push);
+                weight += 1.f;
+            }
+
+            if (weight > 0.f)
+                dtVscale(total, total, 1.f / weight);
+
+            displacement += 3;
+        }
+
+        displacement = displacements.begin();
+
+        for (auto& entry : m_agents)
+        {
+            dtVadd(entry.second.m_position, entry.second.m_position,
+                   &*displacement);
+            displacement += 3;
+        }
+    }
+}
+} // namespace pathfind
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "PathCorridor.hpp"
+
+#include "recastnavigation/Detour/Include/DetourNavMeshQuery.h"
+#include "utility/Vector.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace pathfind
+{
+class Map;
+
+// agents moving over the navmesh of a map, stepped together once per tick.
+// each agent follows a PathCorridor towards its target, steers around its
+// neighbours and the walls near it by sampling candidate velocities, and is
+// moved along the surface of the navmesh.  this covers the parts of detour's
+// dtCrowd which a server needs, built on the queries of the owning map.
+//
+// a crowd is used under the same rules as the queries of its map, and the map
+// must outlive it.
+class Crowd
+{
+public:
+    struct AgentParams
+    {
+        float m_radius = 0.5f;
+        float m_height = 2.f;
+        float m_maxSpeed = 7.f;
+        float m_maxAcceleration = 20.f;
+    };
+
+    struct AgentState
+    {
+        std::uint32_t m_id;
+        math::Vertex m_position;
+        math::Vertex m_velocity;
+        bool m_moving;
+    };
+
+    explicit Crowd(const Map& map);
+
+    // adds an idle agent at the point of the navmesh nearest to position,
+    // optionally using a filter registered with Map::SetPathFilter.  returns
+    // false when there is no navmesh near the position
+    bool AddAgent(const math::Vertex& position, const AgentParams& params,
+                  std::uint32_t& id);
+    bool AddAgent(const math::Vertex& position, const AgentParams& params,
+                  const std::string& filter, std::uint32_t& id);
+
+    bool RemoveAgent(std::uint32_t id);
+    bool HasAgent(std::uint32_t id) const { return !!m_agents.count(id); }
+
+    // sets the target the agent moves towards from the next update.  returns
+    // false when the agent does not exist or cannot reach the target at all,
+    // in which case it keeps its previous target
+    bool SetTarget(std::uint32_t id, const math::Vertex& target);
+
+    // stops the agent where it is.  it still gives way to other agents
+    bool Stop(std::uint32_t id);
+
+    // advances every agent by the given number of seconds
+    void Update(float dt);
+
+    void GetAgents(std::vector<AgentState>& agents) const;
+
+    std::size_t AgentCount() const { return m_agents.size(); }
+
+private:
+    // how far ahead, in multiples of its radius, an agent looks for
+    // neighbours and walls
+    static constexpr float QueryRangeScale = 12.f;
+
+    static constexpr int MaxNeighbours = 6;
+    static constexpr int MaxLocalPolys = 16;
+    static constexpr int MaxWallSegments = 8;
+
+    struct Agent
+    {
+        Agent(const PathCorridor& corridor, const dtQueryFilter& filter,
+              const AgentParams& params);
+
+        PathCorridor m_corridor;
+        const dtQueryFilter m_filter;
+        const AgentParams m_params;
+
+        // recast coordinates
+        float m_position[3];
+        float m_velocity[3];
+        float m_desired[3];
+
+        bool m_moving;
+
+        // wall segments near the agent, six floats each, and where the agent
+        // was when they were collected
+        std::vector<float> m_walls;
+        float m_wallsCenter[3];
+
+        std::vector<const Agent*> m_neighbours;
+
+        float QueryRange() const
+        {
+            return m_params.m_radius * QueryRangeScale;
+        }
+    };
+
+    bool Insert(const PathCorridor& corridor, const dtQueryFilter& filter,
+                const math::Vertex& position, const AgentParams& params,
+                std::uint32_t& id);
+
+    // the caller must hold a shared lock on the map
+    void UpdateWalls(Agent& agent) const;
+
+    void FindNeighbours();
+    void Steer(Agent& agent) const;
+    void Avoid(Agent& agent, float* velocity) const;
+    void Separate();
+
+    const Map& m_map;
+
+    // ordered by id, so that agents are stepped in the same order every tick
+    std::map<std::uint32_t, Agent> m_agents;
+    std::uint32_t m_nextId;
+};
+} // namespace pathfind
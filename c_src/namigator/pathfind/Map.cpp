@@ -1,6 +1,7 @@
 #include "Map.hpp"
 
 #include "Common.hpp"
+#include "ModelCache.hpp"
 #include "Tile.hpp"
 #include "recastnavigation/Detour/Include/DetourCommon.h"
 #include "recastnavigation/Detour/Include/DetourNavMesh.h"
@@ -18,6 +19,7 @@
 #include <iomanip>
 #include <limits>
 #include <list>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <unordered_set>
@@ -29,24 +31,6 @@ static_assert(sizeof(char) == 1, "char must be one byte");
 static constexpr unsigned int GlobalWmoId = 0xFFFFFFFF;
 
 #pragma pack(push, 1)
-struct WmoFileInstance
-{
-    std::uint32_t m_id;
-    std::uint16_t m_doodadSet;
-    std::uint16_t m_nameSet;
-    float m_transformMatrix[16];
-    math::BoundingBox m_bounds;
-    char m_fileName[MeshSettings::MaxMPQPathLength];
-};
-
-struct DoodadFileInstance
-{
-    std::uint32_t m_id;
-    float m_transformMatrix[16];
-    math::BoundingBox m_bounds;
-    char m_fileName[MeshSettings::MaxMPQPathLength];
-};
-
 struct NavFileHeader
 {
     std::uint32_t sig;
@@ -95,8 +79,12 @@ float random_between_0_and_1() {
 namespace pathfind
 {
 Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
-    : m_bvhLoader(dataPath), m_hasADTs(false), m_globalWmoOriginX(0.f),
-      m_globalWmoOriginY(0.f), m_dataPath(dataPath), m_mapName(mapName)
+    : m_bvhLoader(std::make_shared<BVH>(dataPath)), m_hasADTs(false),
+      m_globalWmoOriginX(0.f),
+      m_globalWmoOriginY(0.f), m_dataPath(dataPath), m_mapName(mapName),
+      m_zoneAreaRaster(false), m_deferredTeardown(false),
+      m_translatedVertexSweepSize(64),
+      m_rebuildPartition(RegionPartition::Watershed)
 {
     utility::BinaryStream in(m_dataPath / (mapName + ".map"));
 
@@ -106,6 +94,11 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
     if (magic != MeshSettings::FileMap)
         THROW(Result::INVALID_MAP_FILE);
 
+    auto const archivePath = NavArchive::PathFor(m_dataPath, m_mapName);
+
+    if (fs::exists(archivePath))
+        m_navArchive = std::make_shared<const NavArchive>(archivePath);
+
     ::memset(m_loadedADT, 0, sizeof(m_loadedADT));
 
     std::uint8_t hasTerrain;
@@ -148,61 +141,8 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
         auto const result = m_navMesh.init(&params);
         assert(result == DT_SUCCESS);
 
-        std::uint32_t wmoInstanceCount;
-        in >> wmoInstanceCount;
-
-        if (wmoInstanceCount)
-        {
-            std::vector<WmoFileInstance> wmoInstances(wmoInstanceCount);
-            in.ReadBytes(&wmoInstances[0],
-                         wmoInstanceCount * sizeof(WmoFileInstance));
-
-            for (auto const& wmo : wmoInstances)
-            {
-                WmoInstance ins;
-
-                ins.m_doodadSet = static_cast<unsigned int>(wmo.m_doodadSet);
-                ins.m_nameSet = static_cast<unsigned int>(wmo.m_nameSet);
-                ins.m_transformMatrix = math::Matrix::CreateFromArray(
-                    wmo.m_transformMatrix,
-                    sizeof(wmo.m_transformMatrix) /
-                        sizeof(wmo.m_transformMatrix[0]));
-                ins.m_inverseTransformMatrix =
-                    ins.m_transformMatrix.ComputeInverse();
-                ins.m_bounds = wmo.m_bounds;
-                ins.m_modelFilename = wmo.m_fileName;
-
-                m_staticWmos.insert({static_cast<unsigned int>(wmo.m_id), ins});
-            }
-        }
-
-        std::uint32_t doodadInstanceCount;
-        in >> doodadInstanceCount;
-
-        if (doodadInstanceCount)
-        {
-            std::vector<DoodadFileInstance> doodadInstances(
-                doodadInstanceCount);
-            in.ReadBytes(&doodadInstances[0],
-                         doodadInstanceCount * sizeof(DoodadFileInstance));
-
-            for (auto const& doodad : doodadInstances)
-            {
-                DoodadInstance ins;
-
-                ins.m_transformMatrix = math::Matrix::CreateFromArray(
-                    doodad.m_transformMatrix,
-                    sizeof(doodad.m_transformMatrix) /
-                        sizeof(doodad.m_transformMatrix[0]));
-                ins.m_inverseTransformMatrix =
-                    ins.m_transformMatrix.ComputeInverse();
-                ins.m_bounds = doodad.m_bounds;
-                ins.m_modelFilename = doodad.m_fileName;
-
-                m_staticDoodads.insert(
-                    {static_cast<unsigned int>(doodad.m_id), ins});
-            }
-        }
+        // the instances are only materialized as tiles referencing them load
+        m_staticInstances = std::make_shared<const StaticInstances>(in);
     }
     else
     {
@@ -213,21 +153,11 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
         WmoFileInstance globalWmo;
         in >> globalWmo;
 
-        WmoInstance ins;
-
-        ins.m_doodadSet = globalWmo.m_doodadSet;
-        ins.m_nameSet = globalWmo.m_nameSet;
-        ins.m_transformMatrix = math::Matrix::CreateFromArray(
-            globalWmo.m_transformMatrix,
-            sizeof(globalWmo.m_transformMatrix) /
-                sizeof(globalWmo.m_transformMatrix[0]));
-        ins.m_inverseTransformMatrix = ins.m_transformMatrix.ComputeInverse();
-        ins.m_bounds = globalWmo.m_bounds;
+        m_staticInstances =
+            std::make_shared<const StaticInstances>(GlobalWmoId, globalWmo);
 
-        auto model = EnsureWmoModelLoaded(globalWmo.m_fileName);
-        ins.m_model = model;
-
-        m_staticWmos.insert({GlobalWmoId, ins});
+        auto instance = m_staticInstances->GetWmo(GlobalWmoId);
+        auto model = EnsureWmoModelLoaded(instance->m_modelFilename);
 
         dtNavMeshParams params;
 
@@ -252,108 +182,162 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
         auto const result = m_navMesh.init(&params);
         assert(result == DT_SUCCESS);
 
-        auto const navPath = m_dataPath / "Nav" / m_mapName / "Map.nav";
+        auto const found = ReadTiles(
+            MeshSettings::WMOcoordinate, MeshSettings::WMOcoordinate,
+            [](int, int) { return true; },
+            [this, &instance, &model](std::unique_ptr<Tile> tile)
+            {
+                // for a global wmo, all tiles are guarunteed to contain the
+                // model
+                tile->m_staticWmos.push_back(GlobalWmoId);
+                tile->m_staticWmoInstances.push_back(instance);
+                tile->m_staticWmoModels.push_back(model);
 
-        utility::BinaryStream navIn(navPath);
+                m_tiles[{tile->m_x, tile->m_y}] = std::move(tile);
+            });
 
-        navIn.Decompress();
+        if (!found)
+            THROW(Result::FAILED_TO_OPEN_FILE_FOR_BINARY_STREAM);
+    }
 
-        NavFileHeader header;
-        navIn >> header;
+    if (m_navQuery.init(&m_navMesh, 65535) != DT_SUCCESS)
+        THROW(Result::DTNAVMESHQUERY_INIT_FAILED);
+}
 
-        header.Verify(true);
+Map::Map(const Map& parent, Fork)
+    : m_bvhLoader(parent.m_bvhLoader), m_hasADTs(parent.m_hasADTs),
+      m_globalWmoOriginX(parent.m_globalWmoOriginX),
+      m_globalWmoOriginY(parent.m_globalWmoOriginY),
+      m_dataPath(parent.m_dataPath), m_mapName(parent.m_mapName),
+      m_navArchive(parent.m_navArchive),
+      m_zoneAreaRaster(false), m_deferredTeardown(parent.m_deferredTeardown),
+      m_staticInstances(parent.m_staticInstances),
+      m_translatedVertexSweepSize(64),
+      m_rebuildPartition(parent.GetRebuildPartition())
+{
+    std::shared_lock<std::shared_mutex> guard(parent.m_mutex);
 
-        if (header.x != MeshSettings::WMOcoordinate ||
-            header.y != MeshSettings::WMOcoordinate)
-            THROW(Result::INCORRECT_WMO_COORDINATES);
+    if (!parent.m_obstacleShapes.empty() || parent.PendingRebuilds() > 0)
+        THROW(Result::CANNOT_FORK_MAP_WITH_TEMPORARY_OBSTACLES);
 
-        for (auto i = 0u; i < header.tileCount; ++i)
-        {
-            auto tile = std::make_unique<Tile>(this, navIn, navPath);
+    for (auto const& tile : parent.m_tiles)
+        if (!tile.second->m_temporaryDoodads.empty() ||
+            !tile.second->m_temporaryWmos.empty())
+            THROW(Result::CANNOT_FORK_MAP_WITH_TEMPORARY_OBSTACLES);
 
-            // for a global wmo, all tiles are guarunteed to contain the model
-            tile->m_staticWmos.push_back(GlobalWmoId);
-            tile->m_staticWmoModels.push_back(model);
+    ::memcpy(m_hasADT, parent.m_hasADT, sizeof(m_hasADT));
+    ::memcpy(m_loadedADT, parent.m_loadedADT, sizeof(m_loadedADT));
+    m_readTiles = parent.m_readTiles;
 
-            m_tiles[{tile->m_x, tile->m_y}] = std::move(tile);
-        }
-    }
+    m_queryFilter = parent.m_queryFilter;
+    m_pathFilters = parent.m_pathFilters;
+    m_zoneAreaRaster = parent.m_zoneAreaRaster;
 
-    if (m_navQuery.init(&m_navMesh, 65535) != DT_SUCCESS)
-        THROW(Result::DTNAVMESHQUERY_INIT_FAILED);
-}
+    auto const result = m_navMesh.init(parent.m_navMesh.getParams());
+    assert(result == DT_SUCCESS);
 
-std::shared_ptr<WmoModel> Map::LoadModelForWmoInstance(unsigned int instanceId)
-{
-    auto const instance = m_staticWmos.find(instanceId);
+    // each tile is placed at the same index of the navmesh as in the parent.
+    // detour finds that index by walking its free list, which starts with the
+    // lowest free index, so adding the tiles in order of index keeps each
+    // walk short
+    std::vector<const Tile*> tiles;
+    tiles.reserve(parent.m_tiles.size());
 
-    // ensure it exists.  this should never fail
-    if (instance == m_staticWmos.end())
-        THROW(Result::UNKNOWN_WMO_INSTANCE_REQUESTED);
+    for (auto const& tile : parent.m_tiles)
+        tiles.push_back(tile.second.get());
 
-    // if the model is loaded, return it
-    if (!instance->second.m_model.expired())
-        return instance->second.m_model.lock();
+    std::sort(tiles.begin(), tiles.end(),
+              [&parent](const Tile* a, const Tile* b)
+              {
+                  return parent.m_navMesh.decodePolyIdTile(a->m_ref) <
+                         parent.m_navMesh.decodePolyIdTile(b->m_ref);
+              });
 
-    auto model = EnsureWmoModelLoaded(instance->second.m_modelFilename);
+    for (auto const tile : tiles)
+        m_tiles[{tile->m_x, tile->m_y}] = std::make_unique<Tile>(this, *tile);
 
-    instance->second.m_model = model;
+    // with the same tile references, the parent's islands and portal graph
+    // describe this navmesh as well, and copying them saves finding the
+    // entrance costs of every tile again
+    m_connectivity = parent.m_connectivity;
+    m_portalGraph = parent.m_portalGraph;
 
-    return model;
+    if (m_navQuery.init(&m_navMesh, 65535) != DT_SUCCESS)
+        THROW(Result::DTNAVMESHQUERY_INIT_FAILED);
 }
 
-std::shared_ptr<DoodadModel>
-Map::LoadModelForDoodadInstance(unsigned int instanceId)
+struct Map::Remains
 {
-    auto const instance = m_staticDoodads.find(instanceId);
+    std::unordered_map<std::pair<int, int>, std::unique_ptr<Tile>> m_tiles;
+    Connectivity m_connectivity;
+    PortalGraph m_portalGraph;
+    std::shared_ptr<const StaticInstances> m_staticInstances;
+    std::shared_ptr<const BVH> m_bvhLoader;
+};
+
+Map::~Map()
+{
+    // rebuild jobs use the tiles, so they must finish before any tile is freed
+    m_rebuilder.Stop();
 
-    // ensure it exists.  this should never fail
-    if (instance == m_staticDoodads.end())
-        THROW(Result::UNKNOWN_DOODAD_INSTANCE_REQUESTED);
+    // the navmesh is destroyed along with the map, so the tiles need not be
+    // removed from it, or from the islands and portal graph, one at a time.
+    // doing so is most of the cost of unloading a tile
+    for (auto& tile : m_tiles)
+        tile.second->m_ref = 0;
 
-    // if the model is loaded, return it
-    if (!instance->second.m_model.expired())
-        return instance->second.m_model.lock();
+    if (!m_deferredTeardown)
+        return;
 
-    auto model = EnsureDoodadModelLoaded(instance->second.m_modelFilename);
+    // the tiles no longer refer to the map, so they may outlive it
+    auto remains = std::make_shared<Remains>();
+    remains->m_tiles = std::move(m_tiles);
+    remains->m_connectivity = std::move(m_connectivity);
+    remains->m_portalGraph = std::move(m_portalGraph);
+    remains->m_staticInstances = std::move(m_staticInstances);
+    remains->m_bvhLoader = std::move(m_bvhLoader);
 
-    instance->second.m_model = model;
+    Teardown::Instance().Defer(std::move(remains));
+}
 
-    return model;
+void Map::SetDeferredTeardown(bool enabled)
+{
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+    m_deferredTeardown = enabled;
 }
 
 std::shared_ptr<DoodadModel>
 Map::EnsureDoodadModelLoaded(const std::string& mpq_path)
 {
-    auto const bvhFilename = m_bvhLoader.GetBVHPath(mpq_path);
+    auto const bvhFilename = m_bvhLoader->GetBVHPath(mpq_path);
 
-    // if this model is currently loaded, return it
-    auto const i = m_loadedDoodadModels.find(bvhFilename);
-    if (i != m_loadedDoodadModels.end() && !i->second.expired())
-        return i->second.lock();
+    // if this model is currently loaded by any map, share it.  else, load it
+    return ModelCache::Instance().GetDoodad(
+        bvhFilename,
+        [&bvhFilename]()
+        {
+            utility::BinaryStream in(bvhFilename);
 
-    // else, load it
-    utility::BinaryStream in(bvhFilename);
+            auto model = std::make_shared<pathfind::DoodadModel>();
 
-    auto model = std::make_shared<pathfind::DoodadModel>();
+            if (!model->m_aabbTree.Deserialize(in))
+                THROW(Result::COULD_NOT_DESERIALIZE_DOODAD).ErrorCode();
 
-    if (!model->m_aabbTree.Deserialize(in))
-        THROW(Result::COULD_NOT_DESERIALIZE_DOODAD).ErrorCode();
-
-    m_loadedDoodadModels[bvhFilename] = model;
-    return model;
+            return model;
+        });
 }
 
 std::shared_ptr<WmoModel> Map::EnsureWmoModelLoaded(const std::string& mpq_path)
 {
-    auto const bvhFilename = m_bvhLoader.GetBVHPath(mpq_path);
+    auto const bvhFilename = m_bvhLoader->GetBVHPath(mpq_path);
 
-    // if this model is currently loaded, return it
-    auto const i = m_loadedWmoModels.find(bvhFilename);
-    if (i != m_loadedWmoModels.end() && !i->second.expired())
-        return i->second.lock();
+    // if this model is currently loaded by any map, share it.  else, load it
+    return ModelCache::Instance().GetWmo(
+        bvhFilename, [this, &bvhFilename]() { return LoadWmoModel(bvhFilename); });
+}
 
-    // else, load it
+std::shared_ptr<WmoModel> Map::LoadWmoModel(const std::string& bvhFilename)
+{
     utility::BinaryStream in(bvhFilename);
 
     auto model = std::make_shared<pathfind::WmoModel>();
@@ -404,13 +388,10 @@ std::shared_ptr<WmoModel> Map::EnsureWmoModelLoaded(const std::string& mpq_path)
 
             // loaded doodads serve as reference counters for automatic unload
             model->m_loadedDoodadSets[set].push_back(doodadModel);
-            model->m_doodadSets[set][doodad].m_model =
-                m_loadedDoodadModels[doodadFileName] = doodadModel;
+            model->m_doodadSets[set][doodad].m_model = doodadModel;
         }
     }
 
-    m_loadedWmoModels[bvhFilename] = model;
-
     return model;
 }
 
@@ -424,6 +405,83 @@ bool Map::HasADT(int x, int y) const
     return m_hasADT[x][y];
 }
 
+NavFile Map::GetNavFile(std::uint32_t x, std::uint32_t y) const
+{
+    if (m_navArchive)
+        return {m_navArchive, m_navArchive->GetPath(), x, y};
+
+    if (x == MeshSettings::WMOcoordinate && y == MeshSettings::WMOcoordinate)
+        return {nullptr, m_dataPath / "Nav" / m_mapName / "Map.nav", x, y};
+
+    std::stringstream str;
+    str << std::setfill('0') << std::setw(2) << x << "_" << std::setfill('0')
+        << std::setw(2) << y << ".nav";
+
+    return {nullptr, m_dataPath / "Nav" / m_mapName / str.str(), x, y};
+}
+
+bool Map::ReadTiles(std::uint32_t x, std::uint32_t y,
+                    const std::function<bool(int, int)>& wanted,
+                    const std::function<void(std::unique_ptr<Tile>)>& added)
+{
+    auto navFile = GetNavFile(x, y);
+
+    if (!navFile.Exists())
+        return false;
+
+    if (m_navArchive)
+    {
+        auto const file = m_navArchive->FindFile(x, y);
+        auto const tiles = m_navArchive->GetTiles(*file);
+
+        for (auto i = 0u; i < file->m_tileCount; ++i)
+        {
+            if (!wanted(static_cast<int>(tiles[i].m_x),
+                        static_cast<int>(tiles[i].m_y)))
+                continue;
+
+            // the tile is then reloaded on its own, for its height field
+            navFile.m_tile = &tiles[i];
+
+            auto in = navFile.Read();
+            added(std::make_unique<Tile>(this, in, navFile));
+        }
+
+        return true;
+    }
+
+    auto in = navFile.Read();
+
+    NavFileHeader header;
+    in >> header;
+
+    auto const globalWmo = x == MeshSettings::WMOcoordinate &&
+                           y == MeshSettings::WMOcoordinate;
+
+    header.Verify(globalWmo);
+
+    if (header.x != x || header.y != y)
+        THROW(globalWmo ? Result::INCORRECT_WMO_COORDINATES
+                        : Result::INCORRECT_ADT_COORDINATES);
+
+    for (auto i = 0u; i < header.tileCount; ++i)
+    {
+        // each tile begins with its coordinates
+        auto const start = in.rpos();
+
+        std::uint32_t tileX, tileY;
+        in >> tileX >> tileY;
+        in.rpos(start);
+
+        if (wanted(static_cast<int>(tileX), static_cast<int>(tileY)))
+            added(std::make_unique<Tile>(this, in, navFile));
+        else
+            Tile::Skip(in);
+    }
+
+    return true;
+}
+
 bool Map::IsADTLoaded(int x, int y) const
 {
     return m_loadedADT[x][y];
@@ -431,62 +489,122 @@ bool Map::IsADTLoaded(int x, int y) const
 
 bool Map::LoadADT(int x, int y)
 {
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
     if (m_loadedADT[x][y])
         return true;
 
     if (!m_hasADT[x][y])
         return false;
 
-    std::stringstream str;
-    str << std::setfill('0') << std::setw(2) << x << "_" << std::setfill('0')
-        << std::setw(2) << y << ".nav";
+    auto const first = MeshSettings::TilesPerADT;
 
-    auto const nav_path = m_dataPath / "Nav" / m_mapName / str.str();
+    return LoadADTTiles(x, y, x * first, y * first, (x + 1) * first - 1,
+                        (y + 1) * first - 1) >= 0;
+}
 
-    if (!fs::exists(nav_path))
-        return false;
+void Map::UnloadADT(int x, int y)
+{
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
 
-    utility::BinaryStream stream(nav_path);
+    auto const first = MeshSettings::TilesPerADT;
 
-    stream.Decompress();
+    UnloadADTTiles(x, y, x * first, y * first, (x + 1) * first - 1,
+                   (y + 1) * first - 1);
+}
 
-    NavFileHeader header;
-    stream >> header;
+int Map::LoadADTTiles(int x, int y, int minX, int minY, int maxX, int maxY)
+{
+    auto const key = y * MeshSettings::Adts + x;
+    auto const tileIndex = [x, y](int tileX, int tileY)
+    {
+        return (tileY - y * MeshSettings::TilesPerADT) *
+                   MeshSettings::TilesPerADT +
+               tileX - x * MeshSettings::TilesPerADT;
+    };
 
-    header.Verify(false);
+    auto const existing = m_readTiles.find(key);
 
-    if (header.x != static_cast<std::uint32_t>(x) ||
-        header.y != static_cast<std::uint32_t>(y))
-        THROW(Result::INCORRECT_ADT_COORDINATES);
+    ADTTiles read;
+    if (existing != m_readTiles.end())
+        read = existing->second;
 
-    for (auto i = 0u; i < header.tileCount; ++i)
-    {
-        auto tile = std::make_unique<Tile>(this, stream, nav_path);
-        m_tiles[{tile->m_x, tile->m_y}] = std::move(tile);
-    }
+    ADTTiles requested;
+    for (auto tileY = minY; tileY <= maxY; ++tileY)
+        for (auto tileX = minX; tileX <= maxX; ++tileX)
+            requested.set(tileIndex(tileX, tileY));
 
-    m_loadedADT[x][y] = true;
+    requested &= ~read;
 
-    return true;
+    // every tile requested has been read already
+    if (requested.none())
+        return 0;
+
+    auto result = 0;
+
+    auto const found = ReadTiles(
+        x, y,
+        [&](int tileX, int tileY)
+        {
+            return tileX >= minX && tileX <= maxX && tileY >= minY &&
+                   tileY <= maxY && requested[tileIndex(tileX, tileY)];
+        },
+        [&](std::unique_ptr<Tile> tile)
+        {
+            if (m_zoneAreaRaster)
+                tile->BuildZoneAreaRaster();
+
+            // obstacle shapes outlive the tiles they are stamped onto, so a
+            // tile which is loaded again has those overlapping it restored
+            std::unordered_map<std::uint64_t, ObstacleShape> shapes;
+
+            for (auto const& shape : m_obstacleShapes)
+                if (tile->m_bounds.intersect2d(shape.second.Bounds()))
+                    shapes.insert(shape);
+
+            if (!shapes.empty())
+                tile->RestoreObstacleShapes(std::move(shapes));
+
+            m_tiles[{tile->m_x, tile->m_y}] = std::move(tile);
+            ++result;
+        });
+
+    if (!found)
+        return -1;
+
+    // this includes the tiles which were not in the file, having no mesh
+    read |= requested;
+    m_readTiles[key] = read;
+    m_loadedADT[x][y] = read.all();
+
+    return result;
 }
 
-void Map::UnloadADT(int x, int y)
+void Map::UnloadADTTiles(int x, int y, int minX, int minY, int maxX, int maxY)
 {
-    if (!m_loadedADT[x][y])
+    auto const existing = m_readTiles.find(y * MeshSettings::Adts + x);
+
+    if (existing == m_readTiles.end())
         return;
 
-    for (auto tileY = y * MeshSettings::TilesPerADT;
-         tileY < (y + 1) * MeshSettings::TilesPerADT; ++tileY)
-        for (auto tileX = x * MeshSettings::TilesPerADT;
-             tileX < (x + 1) * MeshSettings::TilesPerADT; ++tileX)
+    for (auto tileY = minY; tileY <= maxY; ++tileY)
+        for (auto tileX = minX; tileX <= maxX; ++tileX)
         {
             auto i = m_tiles.find({tileX, tileY});
 
             if (i != m_tiles.end())
                 m_tiles.erase(i);
+
+            existing->second.reset(
+                (tileY - y * MeshSettings::TilesPerADT) *
+                    MeshSettings::TilesPerADT +
+                tileX - x * MeshSettings::TilesPerADT);
         }
 
     m_loadedADT[x][y] = false;
+
+    if (existing->second.none())
+        m_readTiles.erase(existing);
 }
 
 int Map::LoadAllADTs()
@@ -501,10 +619,90 @@ int Map::LoadAllADTs()
     return result;
 }
 
+namespace
+{
+// clamps a rectangle of tile coordinates to the tiles of the map, returning
+// false if nothing is left of it
+bool ClampTiles(int& minX, int& minY, int& maxX, int& maxY)
+{
+    auto const last = MeshSettings::TileCount - 1;
+
+    minX = (std::max)(minX, 0);
+    minY = (std::max)(minY, 0);
+    maxX = (std::min)(maxX, last);
+    maxY = (std::min)(maxY, last);
+
+    return minX <= maxX && minY <= maxY;
+}
+} // namespace
+
+int Map::LoadTiles(int minX, int minY, int maxX, int maxY)
+{
+    if (!m_hasADTs || !ClampTiles(minX, minY, maxX, maxY))
+        return 0;
+
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const perADT = MeshSettings::TilesPerADT;
+    auto result = 0;
+
+    for (auto y = minY / perADT; y <= maxY / perADT; ++y)
+        for (auto x = minX / perADT; x <= maxX / perADT; ++x)
+        {
+            if (!m_hasADT[x][y] || m_loadedADT[x][y])
+                continue;
+
+            auto const loaded = LoadADTTiles(
+                x, y, (std::max)(minX, x * perADT), (std::max)(minY, y * perADT),
+                (std::min)(maxX, (x + 1) * perADT - 1),
+                (std::min)(maxY, (y + 1) * perADT - 1));
+
+            if (loaded > 0)
+                result += loaded;
+        }
+
+    return result;
+}
+
+void Map::UnloadTiles(int minX, int minY, int maxX, int maxY)
+{
+    if (!m_hasADTs || !ClampTiles(minX, minY, maxX, maxY))
+        return;
+
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const perADT = MeshSettings::TilesPerADT;
+
+    for (auto y = minY / perADT; y <= maxY / perADT; ++y)
+        for (auto x = minX / perADT; x <= maxX / perADT; ++x)
+            UnloadADTTiles(x, y, (std::max)(minX, x * perADT),
+                           (std::max)(minY, y * perADT),
+                           (std::min)(maxX, (x + 1) * perADT - 1),
+                           (std::min)(maxY, (y + 1) * perADT - 1));
+}
+
+int Map::LoadTilesAround(float x, float y, float radius)
+{
+    int firstX, firstY, secondX, secondY;
+    GetTileCoordinates(x - radius, y - radius, firstX, firstY);
+    GetTileCoordinates(x + radius, y + radius, secondX, secondY);
+
+    // tile coordinates run opposite to world coordinates
+    return LoadTiles((std::min)(firstX, secondX), (std::min)(firstY, secondY),
+                     (std::max)(firstX, secondX), (std::max)(firstY, secondY));
+}
+
+bool Map::IsTileLoaded(int x, int y) const
+{
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    return m_tiles.find({x, y}) != m_tiles.end();
+}
+
 std::shared_ptr<Model> Map::GetOrLoadModelByDisplayId(unsigned int displayId)
 {
     // Get the BVH file for this display ID
-    auto const bvh_path = m_bvhLoader.GetBVHPath(displayId);
+    auto const bvh_path = m_bvhLoader->GetBVHPath(displayId);
 
     // TODO: add logic based on mpq_path
     auto const doodad = false;
@@ -512,27 +710,87 @@ std::shared_ptr<Model> Map::GetOrLoadModelByDisplayId(unsigned int displayId)
 
     if (doodad)
     {
-        // auto const i = m_loadedDoodadModels.find(fileName);
-        // if (i != m_loadedDoodadModels.end() && !i->second.expired())
-        //    return i->second.lock();
-
         return EnsureDoodadModelLoaded(bvh_path);
     }
     else
     {
-        // auto const i = m_loadedWmoModels.find(fileName);
-        // if (i != m_loadedWmoModels.end() && !i->second.expired())
-        //    return i->second.lock();
-
         return EnsureWmoModelLoaded(bvh_path);
     }
 
     // return nullptr;
 }
 
+void Map::SetPathFilter(const std::string& name, const PathFilter& filter)
+{
+    dtQueryFilter queryFilter;
+
+    queryFilter.setIncludeFlags(filter.m_includeFlags);
+    queryFilter.setExcludeFlags(filter.m_excludeFlags);
+
+    // the area of each polygon holds its flags (see TileAdded), so every
+    // combination of flags gets its own area cost
+    for (auto area = 0; area < (1 << PathFilter::FlagCount); ++area)
+    {
+        auto cost = 1.f;
+
+        for (auto bit = 0; bit < PathFilter::FlagCount; ++bit)
+            if (!!(area & (1 << bit)))
+                cost *= filter.m_flagCosts[bit];
+
+        queryFilter.setAreaCost(area, cost);
+    }
+
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+    m_pathFilters[name] = queryFilter;
+}
+
+bool Map::HasPathFilter(const std::string& name) const
+{
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+    return m_pathFilters.find(name) != m_pathFilters.end();
+}
+
+dtQueryFilter Map::GetPathFilter(const std::string& name) const
+{
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const filter = m_pathFilters.find(name);
+
+    if (filter == m_pathFilters.end())
+        THROW(Result::UNKNOWN_PATH_FILTER);
+
+    return filter->second;
+}
+
 bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
                    std::vector<math::Vertex>& output, bool allowPartial) const
 {
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+    return FindFilteredPath(start, end, output, allowPartial, m_queryFilter);
+}
+
+bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
+                   std::vector<math::Vertex>& output, bool allowPartial,
+                   const std::string& filter) const
+{
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const queryFilter = m_pathFilters.find(filter);
+
+    if (queryFilter == m_pathFilters.end())
+        THROW(Result::UNKNOWN_PATH_FILTER);
+
+    return FindFilteredPath(start, end, output, allowPartial,
+                            queryFilter->second);
+}
+
+bool Map::FindFilteredPath(const math::Vertex& start, const math::Vertex& end,
+                           std::vector<math::Vertex>& output,
+                           bool allowPartial,
+                           const dtQueryFilter& filter) const
+{
+    std::lock_guard<std::mutex> search(m_queryMutex);
+
     constexpr float extents[] = {5.f, 5.f, 5.f};
 
     float recastStart[3];
@@ -542,7 +800,7 @@ bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
     math::Convert::VertexToRecast(end, recastEnd);
 
     dtPolyRef startPolyRef, endPolyRef;
-    if (!(m_navQuery.findNearestPoly(recastStart, extents, &m_queryFilter,
+    if (!(m_navQuery.findNearestPoly(recastStart, extents, &filter,
                                      &startPolyRef, nullptr) &
           DT_SUCCESS))
         return false;
@@ -550,7 +808,7 @@ bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
     if (!startPolyRef)
         return false;
 
-    if (!(m_navQuery.findNearestPoly(recastEnd, extents, &m_queryFilter,
+    if (!(m_navQuery.findNearestPoly(recastEnd, extents, &filter,
                                      &endPolyRef, nullptr) &
           DT_SUCCESS))
         return false;
@@ -558,11 +816,37 @@ bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
     if (!endPolyRef)
         return false;
 
+    // when the two polygons are on different islands, the search below could
+    // only fail after exhausting every polygon reachable from the start
+    if (!allowPartial &&
+        !m_connectivity.Connected(m_navMesh, startPolyRef, endPolyRef))
+        return false;
+
+    const dtMeshTile *startTile, *endTile;
+    const dtPoly* poly;
+    m_navMesh.getTileAndPolyByRefUnsafe(startPolyRef, &startTile, &poly);
+    m_navMesh.getTileAndPolyByRefUnsafe(endPolyRef, &endTile, &poly);
+
+    // a single search between distant polygons could exhaust the node pool or
+    // the path buffer, even when a path exists.  whenever the route through
+    // the portal graph fails, the single search below is still made, as it
+    // may find a path the coarse graph missed, or a partial one towards the
+    // polygon nearest the goal that it reaches.  the portal graph knows
+    // nothing of path filters, which may exclude or reweigh the polygons it
+    // routes through, so only the default filter uses it
+    if (&filter == &m_queryFilter &&
+        (std::max)(std::abs(startTile->header->x - endTile->header->x),
+                   std::abs(startTile->header->y - endTile->header->y)) >=
+            HierarchicalTileDistance &&
+        FindHierarchicalPath(startPolyRef, recastStart, endPolyRef, recastEnd,
+                             output, allowPartial))
+        return true;
+
     dtPolyRef polyRefBuffer[MaxPathHops];
 
     int pathLength;
     auto const findPathResult = m_navQuery.findPath(
-        startPolyRef, endPolyRef, recastStart, recastEnd, &m_queryFilter,
+        startPolyRef, endPolyRef, recastStart, recastEnd, &filter,
         polyRefBuffer, &pathLength, MaxPathHops);
     if (!(findPathResult & DT_SUCCESS) ||
         (!allowPartial && !!(findPathResult & DT_PARTIAL_RESULT)))
@@ -584,11 +868,111 @@ bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
     return true;
 }
 
-const Tile* Map::GetTile(float x, float y) const
+bool Map::FindHierarchicalPath(dtPolyRef startRef, const float* recastStart,
+                               dtPolyRef endRef, const float* recastEnd,
+                               std::vector<math::Vertex>& output,
+                               bool allowPartial) const
 {
-    // find the tile corresponding to this (x, y)
-    int tileX, tileY;
+    std::vector<PortalGraph::Waypoint> route;
+    if (!m_portalGraph.FindRoute(m_navMesh, startRef, recastStart, endRef,
+                                 recastEnd, route))
+        return false;
+
+    PortalGraph::Waypoint end;
+    end.m_ref = endRef;
+    dtVcopy(end.m_position, recastEnd);
+    route.push_back(end);
+
+    // search each leg of the route separately, joining their polygons into a
+    // single corridor so that the straight path is smoothed across the legs
+    std::vector<dtPolyRef> corridor {startRef};
+    dtPolyRef legBuffer[MaxPathHops];
+
+    auto from = recastStart;
+
+    for (auto const& waypoint : route)
+    {
+        int legLength;
+        auto const legResult = m_navQuery.findPath(
+            corridor.back(), waypoint.m_ref, from, waypoint.m_position,
+            &m_queryFilter, legBuffer, &legLength, MaxPathHops);
+
+        if (!(legResult & DT_SUCCESS) || legLength == 0)
+            return false;
+
+        corridor.insert(corridor.end(), legBuffer + 1, legBuffer + legLength);
+
+        if (legBuffer[legLength - 1] != waypoint.m_ref)
+        {
+            if (!allowPartial)
+                return false;
+
+            break;
+        }
+
+        from = waypoint.m_position;
+    }
+
+    auto const maxStraightPath = static_cast<int>(corridor.size()) + 1;
+    std::vector<float> pathBuffer(3 * maxStraightPath);
+
+    int pathLength;
+    auto const findStraightPathResult = m_navQuery.findStraightPath(
+        recastStart, recastEnd, &corridor[0], static_cast<int>(corridor.size()),
+        &pathBuffer[0], nullptr, nullptr, &pathLength, maxStraightPath);
+    if (!(findStraightPathResult & DT_SUCCESS) ||
+        (!allowPartial && !!(findStraightPathResult & DT_PARTIAL_RESULT)))
+        return false;
+
+    output.resize(pathLength);
+
+    for (auto i = 0; i < pathLength; ++i)
+        math::Convert::VertexToWow(&pathBuffer[i * 3], output[i]);
+
+    return true;
+}
+
+void Map::TileAdded(dtTileRef ref)
+{
+    auto const tile = m_navMesh.getTileByRef(ref);
+    auto const base = m_navMesh.getPolyRefBase(tile);
+
+    // polygon areas are not used by the mesh builder, so the flags of each
+    // polygon are copied into its area, where path filters can give each
+    // combination of them a cost
+    for (auto i = 0; i < tile->header->polyCount; ++i)
+        m_navMesh.setPolyArea(
+            base | static_cast<dtPolyRef>(i),
+            static_cast<unsigned char>(tile->polys[i].flags &
+                                       ((1 << PathFilter::FlagCount) - 1)));
+
+    m_connectivity.AddTile(m_navMesh, ref);
+    m_portalGraph.AddTile(m_navMesh, ref);
+}
+
+void Map::TileRemoved(dtTileRef ref)
+{
+    m_connectivity.RemoveTile(m_navMesh, ref);
+    m_portalGraph.RemoveTile(m_navMesh, ref);
+}
+
+std::vector<TileMemoryUsage> Map::GetTileMemoryUsage() const
+{
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    std::vector<TileMemoryUsage> result;
+    result.reserve(m_tiles.size());
 
+    for (auto const& tile : m_tiles)
+        result.push_back({tile.second->m_x, tile.second->m_y,
+                          tile.second->m_tileData.size(),
+                          tile.second->m_heightField->MemoryUsage()});
+
+    return result;
+}
+
+void Map::GetTileCoordinates(float x, float y, int& tileX, int& tileY) const
+{
     // maps based on a global WMO have their tiles positioned differently
     if (HasADTs())
         math::Convert::WorldToTile({x, y, 0.f}, tileX, tileY);
@@ -597,6 +981,13 @@ const Tile* Map::GetTile(float x, float y) const
         tileX = (m_globalWmoOriginY - y) / MeshSettings::TileSize;
         tileY = (m_globalWmoOriginX - x) / MeshSettings::TileSize;
     }
+}
+
+const Tile* Map::GetTile(float x, float y) const
+{
+    // find the tile corresponding to this (x, y)
+    int tileX, tileY;
+    GetTileCoordinates(x, y, tileX, tileY);
 
     auto const tile = m_tiles.find({tileX, tileY});
 
@@ -746,6 +1137,8 @@ bool Map::FindPointInBetweenVectors(const math::Vertex& start, const math::Verte
                                     const float distance,
                                     math::Vertex& inBetweenPoint) const
 {
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
     const float generalDistance = start.GetDistance(end);
     if (generalDistance < distance) {
         return false;
@@ -786,6 +1179,9 @@ bool Map::FindRandomPointAroundCircle(const math::Vertex& centerPosition,
                                       const float radius,
                                       math::Vertex& randomPoint) const
 {
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+    std::lock_guard<std::mutex> search(m_queryMutex);
+
     float recastCenter[3];
     math::Convert::VertexToRecast(centerPosition, recastCenter);
 
@@ -817,6 +1213,82 @@ bool Map::FindRandomPointAroundCircle(const math::Vertex& centerPosition,
 
 
 bool Map::FindHeight(const math::Vertex& source, float x, float y, float& z) const
+{
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const tile = GetTile(x, y);
+
+    if (!tile)
+        return false;
+
+    dtPolyRef hitPath[MaxHeightHitPath];
+    dtRaycastHit hit;
+    hit.path = hitPath;
+    hit.maxPath = MaxHeightHitPath;
+
+    return FindHeight(tile, source, x, y, hit, z);
+}
+
+std::size_t Map::FindHeight(const std::vector<math::Vertex>& sources,
+                            const std::vector<math::Vector2>& targets,
+                            std::vector<float>& heights,
+                            std::vector<bool>& found) const
+{
+    assert(sources.size() == targets.size());
+
+    heights.assign(sources.size(), 0.f);
+    found.assign(sources.size(), false);
+
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    dtPolyRef hitPath[MaxHeightHitPath];
+    dtRaycastHit hit;
+    hit.path = hitPath;
+    hit.maxPath = MaxHeightHitPath;
+
+    // queries usually come in groups over the same area, so the tile of the
+    // previous one is kept rather than looked up again
+    int lastX = 0, lastY = 0;
+    const Tile* tile = nullptr;
+    auto haveTile = false;
+
+    std::size_t result = 0;
+
+    for (auto i = 0u; i < sources.size(); ++i)
+    {
+        auto const x = targets[i].X;
+        auto const y = targets[i].Y;
+
+        int tileX, tileY;
+        GetTileCoordinates(x, y, tileX, tileY);
+
+        if (!haveTile || tileX != lastX || tileY != lastY)
+        {
+            auto const entry = m_tiles.find({tileX, tileY});
+            tile = entry == m_tiles.end() ? nullptr : entry->second.get();
+
+            lastX = tileX;
+            lastY = tileY;
+            haveTile = true;
+        }
+
+        if (!tile)
+            continue;
+
+        float z;
+        if (FindHeight(tile, sources[i], x, y, hit, z))
+        {
+            heights[i] = z;
+            found[i] = true;
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+bool Map::FindHeight(const Tile* tile, const math::Vertex& source, float x,
+                     float y, dtRaycastHit& hit, float& z) const
 {
     // ray cast along navmesh from source to target
     float recastSource[3];
@@ -833,11 +1305,6 @@ bool Map::FindHeight(const math::Vertex& source, float x, float y, float& z) con
     // use the source Z as an initial guess
     math::Convert::VertexToRecast({x, y, source.Z}, recastTarget);
 
-    dtPolyRef hit_path[100];
-    dtRaycastHit hit;
-    hit.path = hit_path;
-    hit.maxPath = sizeof(hit_path) / sizeof(hit_path[0]);
-
     if (m_navQuery.raycast(startRef, recastSource, recastTarget, &m_queryFilter,
                            0, &hit) != DT_SUCCESS)
         return false;
@@ -852,11 +1319,6 @@ bool Map::FindHeight(const math::Vertex& source, float x, float y, float& z) con
                                  &z) != DT_SUCCESS)
         return false;
 
-    auto const tile = GetTile(x, y);
-
-    if (!tile)
-        return false;
-
     // take the imprecise z value from the mesh, and return the precise value
     if (!FindNextZ(tile, x, y, z, true, z))
         return false;
@@ -866,38 +1328,64 @@ bool Map::FindHeight(const math::Vertex& source, float x, float y, float& z) con
 
 bool Map::FindHeights(float x, float y, std::vector<float>& output) const
 {
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
     auto const tile = GetTile(x, y);
 
     if (!tile)
         return false;
 
+    return FindHeights(tile, x, y, output);
+}
 
-    // FIXME: not sure what the use case for this search is.  should it be
-    // always precise, never, or user-defined?
+void Map::FindHeights(float x, float y, float step, int columns, int rows,
+                      std::vector<std::vector<float>>& output) const
+{
+    output.clear();
 
-    float current = tile->m_bounds.getMaximum().Z;
-    do
-    {
-        float next;
-        if (!FindNextZ(tile, x, y, current, false, next))
-            break;
+    if (columns <= 0 || rows <= 0)
+        return;
 
-        // if we just found the same z, nudge down slightly
-        if (next == current)
-        {
-            current = std::nextafter(next, next - 1.f);
+    output.resize(static_cast<std::size_t>(columns) * rows);
 
-            // if this nudge put us below the tile boundary, don't try another ray cast
-            // as this will cause the ray to go upward instead of downward.
-            if (current < tile->m_bounds.getMinimum().Z)
-                break;
-        }
-        else
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    auto column = output.begin();
+    for (auto row = 0; row < rows; ++row)
+        for (auto i = 0; i < columns; ++i, ++column)
         {
-            output.push_back(next);
-            current = next;
+            auto const columnX = x + step * i;
+            auto const columnY = y + step * row;
+
+            if (auto const tile = GetTile(columnX, columnY))
+                FindHeights(tile, columnX, columnY, *column);
         }
-    } while (true);
+}
+
+bool Map::FindHeights(const Tile* tile, float x, float y,
+                      std::vector<float>& output) const
+{
+    // FIXME: not sure what the use case for this search is.  should it be
+    // always precise, never, or user-defined?
+
+    auto const top = tile->m_bounds.getMaximum().Z;
+    auto const bottom = tile->m_bounds.getMinimum().Z;
+
+    // one ray through the whole tile finds every floor at once
+    math::Ray ray {{x, y, top}, {x, y, bottom}};
+
+    std::vector<float> distances;
+    RayCast(ray, {tile}, true, distances);
+
+    for (auto const distance : distances)
+    {
+        auto const z = top + (bottom - top) * distance;
+
+        // the same surface may be hit more than once, for example where two
+        // triangles or two instances meet
+        if (output.empty() || output.back() != z)
+            output.push_back(z);
+    }
 
     float adtHeight;
     if (GetADTHeight(tile, x, y, adtHeight))
@@ -909,12 +1397,87 @@ bool Map::FindHeights(float x, float y, std::vector<float>& output) const
 bool Map::ZoneAndArea(const math::Vertex& position, unsigned int& zone,
                       unsigned int& area) const
 {
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
     // find the tile corresponding to this (x, y)
     auto const tile = GetTile(position.X, position.Y);
 
     if (!tile)
         return false;
 
+    return ZoneAndArea(tile, position, zone, area);
+}
+
+std::size_t Map::ZoneAndArea(const std::vector<math::Vertex>& positions,
+                             std::vector<unsigned int>& zones,
+                             std::vector<unsigned int>& areas,
+                             std::vector<bool>& found) const
+{
+    zones.assign(positions.size(), 0);
+    areas.assign(positions.size(), 0);
+    found.assign(positions.size(), false);
+
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
+    std::size_t result = 0;
+
+    for (auto i = 0u; i < positions.size(); ++i)
+    {
+        auto const tile = GetTile(positions[i].X, positions[i].Y);
+
+        if (tile && ZoneAndArea(tile, positions[i], zones[i], areas[i]))
+        {
+            found[i] = true;
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+void Map::SetZoneAreaRaster(bool enabled)
+{
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
+    m_zoneAreaRaster = enabled;
+
+    for (auto& tile : m_tiles)
+    {
+        if (enabled)
+            tile.second->BuildZoneAreaRaster();
+        else
+            tile.second->m_terrainQuads = {};
+    }
+}
+
+bool Map::ZoneAndArea(const Tile* tile, const math::Vertex& position,
+                      unsigned int& zone, unsigned int& area) const
+{
+    // over plain terrain the answer is always that of the adt, so neither the
+    // ray cast nor the adt height is needed
+    if (!tile->m_terrainQuads.empty())
+    {
+        constexpr int quadCount = 8 / MeshSettings::TilesPerChunk;
+        constexpr float quadWidth = MeshSettings::AdtChunkSize / 8;
+
+        float northwestX, northwestY;
+        math::Convert::TileToWorldNorthwestCorner(tile->m_x, tile->m_y,
+                                                  northwestX, northwestY);
+
+        auto const quadX =
+            static_cast<int>((northwestY - position.Y) / quadWidth);
+        auto const quadY =
+            static_cast<int>((northwestX - position.X) / quadWidth);
+
+        if (quadX >= 0 && quadY >= 0 && quadX < quadCount &&
+            quadY < quadCount && tile->m_terrainQuads[quadX * quadCount + quadY])
+        {
+            zone = tile->m_zoneId;
+            area = tile->m_areaId;
+            return true;
+        }
+    }
+
     std::vector<const Tile*> tiles {tile};
 
     math::Ray ray {
@@ -947,6 +1510,8 @@ bool Map::ZoneAndArea(const math::Vertex& position, unsigned int& zone,
 
 bool Map::LineOfSight(const math::Vertex& start, const math::Vertex& stop, bool doodads) const
 {
+    std::shared_lock<std::shared_mutex> guard(m_mutex);
+
     math::Ray ray {start, stop};
     // RayCast() returns true when an obstacle is hit
     return !RayCast(ray, doodads);
@@ -986,9 +1551,11 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
         if (!ray.IntersectBoundingBox(tile->m_bounds))
             continue;
 
-        // measure intersection for all static wmos on the tile
-        for (auto const& id : tile->m_staticWmos)
+        // measure intersection for all static wmos on the tile.  their models
+        // are held by the tile, in the same order as their ids
+        for (auto i = 0u; i < tile->m_staticWmos.size(); ++i)
         {
+            auto const id = tile->m_staticWmos[i];
             // skip static wmos we have already seen (possibly from a previous
             // tile)
             if (staticWmos.find(id) != staticWmos.end())
@@ -997,7 +1564,7 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
             // record this static wmo as having been tested
             staticWmos.insert(id);
 
-            auto const& instance = m_staticWmos.at(id);
+            auto const& instance = *tile->m_staticWmoInstances[i];
 
             // skip this wmo if the bbox doesn't intersect, saves us from
             // calculating the inverse ray
@@ -1010,7 +1577,7 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
                                      end, instance.m_inverseTransformMatrix));
 
             // if this is a closer hit, update the original ray's distance
-            if (auto model = instance.m_model.lock())
+            if (auto const& model = tile->m_staticWmoModels[i])
             {
                 if (model->m_aabbTree.IntersectRay(rayInverse) &&
                     rayInverse.GetDistance() < ray.GetDistance())
@@ -1031,8 +1598,9 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
         // measure intersection for all static doodads on this tile
         if (doodads)
         {
-            for (auto const& id : tile->m_staticDoodads)
+            for (auto i = 0u; i < tile->m_staticDoodads.size(); ++i)
             {
+                auto const id = tile->m_staticDoodads[i];
                 // skip static doodads we have already seen (possibly from a
                 // previous tile)
                 if (staticDoodads.find(id) != staticDoodads.end())
@@ -1041,7 +1609,7 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
                 // record this static doodad as having been tested
                 staticDoodads.insert(id);
 
-                auto const& instance = m_staticDoodads.at(id);
+                auto const& instance = *tile->m_staticDoodadInstances[i];
 
                 // skip this doodad if the bbox doesn't intersect, saves us from
                 // calculating the inverse ray
@@ -1055,7 +1623,7 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
                         end, instance.m_inverseTransformMatrix));
 
                 // if this is a closer hit, update the original ray's distance
-                if (instance.m_model.lock()->m_aabbTree.IntersectRay(
+                if (tile->m_staticDoodadModels[i]->m_aabbTree.IntersectRay(
                         rayInverse) &&
                     rayInverse.GetDistance() < ray.GetDistance())
                 {
@@ -1155,4 +1723,68 @@ bool Map::RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
 
     return hit;
 }
+
+void Map::RayCast(const math::Ray& ray, const std::vector<const Tile*>& tiles,
+                  bool doodads, std::vector<float>& distances) const
+{
+    auto const& start = ray.GetStartPoint();
+    auto const& end = ray.GetEndPoint();
+
+    auto const first = distances.size();
+
+    // instances spanning several tiles are only tested once.  with a single
+    // tile, as for height queries, there is nothing to remember
+    auto const remember = tiles.size() > 1;
+    std::unordered_set<std::uint32_t> staticWmos, staticDoodads;
+    std::unordered_set<std::uint64_t> temporaryWmos, temporaryDoodads;
+
+    auto const intersect = [&](const auto& instance, const Model* model)
+    {
+        if (!model || !ray.IntersectBoundingBox(instance.m_bounds))
+            return;
+
+        math::Ray rayInverse(
+            math::Vector3::Transform(start, instance.m_inverseTransformMatrix),
+            math::Vector3::Transform(end, instance.m_inverseTransformMatrix));
+
+        model->m_aabbTree.IntersectRayAll(rayInverse, distances);
+    };
+
+    for (auto const tile : tiles)
+    {
+        if (!ray.IntersectBoundingBox(tile->m_bounds))
+            continue;
+
+        // the models of static instances are held by the tile, in the same
+        // order as their ids
+        for (auto i = 0u; i < tile->m_staticWmos.size(); ++i)
+        {
+            auto const id = tile->m_staticWmos[i];
+            if (!remember || staticWmos.insert(id).second)
+                intersect(*tile->m_staticWmoInstances[i],
+                          tile->m_staticWmoModels[i].get());
+        }
+
+        if (!doodads)
+            continue;
+
+        for (auto i = 0u; i < tile->m_staticDoodads.size(); ++i)
+        {
+            auto const id = tile->m_staticDoodads[i];
+            if (!remember || staticDoodads.insert(id).second)
+                intersect(*tile->m_staticDoodadInstances[i],
+                          tile->m_staticDoodadModels[i].get());
+        }
+
+        for (auto const& wmo : tile->m_temporaryWmos)
+            if (!remember || temporaryWmos.insert(wmo.first).second)
+                intersect(*wmo.second, wmo.second->m_model.lock().get());
+
+        for (auto const& doodad : tile->m_temporaryDoodads)
+            if (!remember || temporaryDoodads.insert(doodad.first).second)
+                intersect(*doodad.second, doodad.second->m_model.lock().get());
+    }
+
+    std::sort(distances.begin() + first, distances.end());
+}
 } // namespace pathfind
@@ -2,15 +2,26 @@
 
 #include "BVH.hpp"
 #include "Common.hpp"
+#include "Connectivity.hpp"
 #include "Model.hpp"
+#include "NavArchive.hpp"
+#include "PortalGraph.hpp"
+#include "StaticInstances.hpp"
+#include "Teardown.hpp"
 #include "Tile.hpp"
+#include "TileRebuilder.hpp"
 #include "recastnavigation/Detour/Include/DetourNavMesh.h"
 #include "recastnavigation/Detour/Include/DetourNavMeshQuery.h"
 #include "utility/Ray.hpp"
 #include "utility/Vector.hpp"
 
+#include <atomic>
+#include <bitset>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -29,17 +40,101 @@ struct hash<std::pair<int, int>>
 
 namespace pathfind
 {
+// invoked once all tiles affected by a game object have been rebuilt (or have
+// failed to rebuild).  this is called from a rebuild thread.  rebuilds which
+// are discarded because the map is destroyed never complete, so it is not
+// called for them: the map may be destroyed where the callback must not run,
+// such as while the erlang resource holding it is garbage collected
+using GameObjectCallback = std::function<void(std::uint64_t guid, bool success)>;
+
+// how the walkable area of a tile is divided into regions when it is rebuilt
+// for a temporary obstacle.  watershed matches the partitioning used by the
+// map builder and gives the best polygons, but it is also the most expensive
+// stage of a rebuild.  monotone and layers are much cheaper, at the cost of
+// longer, thinner polygons (monotone) or more of them (layers).
+enum class RegionPartition
+{
+    Watershed,
+    Monotone,
+    Layers,
+};
+
+// memory held by a single loaded tile
+struct TileMemoryUsage
+{
+    int m_x;
+    int m_y;
+    std::size_t m_navMesh;     // detour tile data
+    std::size_t m_heightField; // packed spans, if loaded for rebuilds
+};
+
+// which polygons paths may cross, and the cost of crossing them, by the
+// PolyFlags of each polygon
+struct PathFilter
+{
+    static constexpr int FlagCount = 5;
+
+    unsigned short m_includeFlags = 0xFFFF;
+    unsigned short m_excludeFlags = 0;
+
+    // cost multiplier of polygons with each PolyFlags bit, by bit index.  a
+    // polygon with several flags costs the product of their multipliers.
+    // multipliers below one may produce paths which are not the shortest
+    float m_flagCosts[FlagCount] = {1.f, 1.f, 1.f, 1.f, 1.f};
+};
+
+// tracks the tile rebuilds outstanding for a single game object
+struct PendingGameObject
+{
+    PendingGameObject(std::uint64_t guid, int tiles, GameObjectCallback callback)
+        : m_guid(guid), m_remaining(tiles), m_success(true),
+          m_callback(std::move(callback))
+    {
+    }
+
+    PendingGameObject(const PendingGameObject&) = delete;
+    PendingGameObject& operator=(const PendingGameObject&) = delete;
+
+    void Complete(bool success)
+    {
+        if (!success)
+            m_success = false;
+
+        if (--m_remaining == 0 && m_callback)
+            m_callback(m_guid, m_success);
+    }
+
+    const std::uint64_t m_guid;
+    std::atomic<int> m_remaining;
+    std::atomic<bool> m_success;
+    const GameObjectCallback m_callback;
+};
+
 // note that instances of this type are assumed to be thread-local, therefore
-// the type is not thread safe
+// the type is not thread safe.  the one exception is temporary obstacle
+// rebuilds, which run on background threads and swap their results into the
+// navmesh under an exclusive lock of m_mutex.  public methods which read the
+// navmesh or tiles hold a shared lock of it.
 class Map
 {
+    friend class Crowd;
+    friend class PathCorridor;
     friend class Tile;
 
 private:
     static constexpr int MaxStackedPolys = 128;
     static constexpr int MaxPathHops = 4096;
 
-    BVH m_bvhLoader;
+    // polygons crossed by the navmesh ray cast of a height query
+    static constexpr int MaxHeightHitPath = 100;
+
+    // paths between polygons this many tiles apart or more are routed through
+    // the portal graph before being searched for
+    static constexpr int HierarchicalTileDistance = 16;
+
+    // the bvh index, instance tables and models are never modified once the
+    // map is constructed, and are shared with any forks of it
+    std::shared_ptr<const BVH> m_bvhLoader;
 
     // this is false when the map is based on a global wmo
     bool m_hasADTs;
@@ -50,50 +145,161 @@ private:
     bool m_hasADT[MeshSettings::Adts][MeshSettings::Adts];
     bool m_loadedADT[MeshSettings::Adts][MeshSettings::Adts];
 
+    using ADTTiles =
+        std::bitset<MeshSettings::TilesPerADT * MeshSettings::TilesPerADT>;
+
+    // the tiles which have been read from each adt with any tiles loaded,
+    // keyed by y * Adts + x and indexed by y * TilesPerADT + x within the adt.
+    // tiles missing from the nav file count as read without being added to
+    // m_tiles.  an adt is loaded once all of its tiles have been read
+    std::unordered_map<int, ADTTiles> m_readTiles;
+
     const std::filesystem::path m_dataPath;
     const std::string m_mapName;
 
+    // the packed nav files of the map, when it has been converted to an
+    // archive.  otherwise, each adt is read from its own file
+    std::shared_ptr<const NavArchive> m_navArchive;
+
+    // the nav file of the given adt, or of the global wmo at the wmo
+    // coordinate
+    NavFile GetNavFile(std::uint32_t x, std::uint32_t y) const;
+
+    // reads those tiles of the nav file of the given adt, or of the global wmo
+    // at the wmo coordinate, for which wanted returns true, and passes them
+    // to added.  the tiles of an archive are read on their own, and those of
+    // a loose file are skipped over.  returns false if there is no such file
+    bool ReadTiles(std::uint32_t x, std::uint32_t y,
+                   const std::function<bool(int, int)>& wanted,
+                   const std::function<void(std::unique_ptr<Tile>)>& added);
+
+    // loads the tiles of the adt within the given rectangle of tile
+    // coordinates which have not been read yet.  returns the number of tiles
+    // added, or -1 if the adt has no nav file.  the caller must hold an
+    // exclusive lock of m_mutex
+    int LoadADTTiles(int x, int y, int minX, int minY, int maxX, int maxY);
+    void UnloadADTTiles(int x, int y, int minX, int minY, int maxX, int maxY);
+
     dtNavMesh m_navMesh;
     dtNavMeshQuery m_navQuery;
     dtQueryFilter m_queryFilter;
 
+    // named filters registered with SetPathFilter
+    std::unordered_map<std::string, dtQueryFilter> m_pathFilters;
+
+    // a copy of the named filter, which must exist
+    dtQueryFilter GetPathFilter(const std::string& name) const;
+
+    // islands and portal graph of m_navMesh, kept up to date by Tile as it
+    // adds and removes its mesh
+    Connectivity m_connectivity;
+    PortalGraph m_portalGraph;
+
+    // called by Tile after adding its mesh to, or removing it from, m_navMesh
+    void TileAdded(dtTileRef ref);
+    void TileRemoved(dtTileRef ref);
+
     // TODO: Does this need to be a pointer?
     std::unordered_map<std::pair<int, int>, std::unique_ptr<Tile>> m_tiles;
 
-    // indexed by unique instance id.  this data is always loaded.  whenever a
-    // tile using one of these instances is loaded, the corresponding model is
-    // loaded also.  whenever all tiles referencing a model (possibly through
-    // distinct instances) are unloaded, the model is unloaded.
-    std::unordered_map<std::uint32_t, WmoInstance> m_staticWmos;
-    std::unordered_map<std::uint32_t, DoodadInstance> m_staticDoodads;
+    // whether loaded tiles keep a raster of the adt quads whose zone and area
+    // are those of the terrain.  see SetZoneAreaRaster
+    bool m_zoneAreaRaster;
+
+    // see SetDeferredTeardown
+    bool m_deferredTeardown;
+
+    // what the destructor hands to the Teardown thread
+    struct Remains;
+
+    // the static instances, by unique instance id.  whenever a tile using one
+    // of these instances is loaded, the instance is materialized and its model
+    // is loaded also, and both are held by the tile alongside the instance id.
+    // whenever all tiles referencing a model (possibly through distinct
+    // instances) are unloaded, the model is unloaded.  shared with forks
+    std::shared_ptr<const StaticInstances> m_staticInstances;
 
-    // indexed by GUID
+    // indexed by GUID.  the tiles a game object overlaps hold it, so that it
+    // is released when the last of them is unloaded
     std::unordered_map<std::uint64_t, std::weak_ptr<WmoInstance>>
         m_temporaryWmos;
     std::unordered_map<std::uint64_t, std::weak_ptr<DoodadInstance>>
         m_temporaryDoodads;
 
-    // map, by filename, of loaded models
-    std::unordered_map<std::string, std::weak_ptr<WmoModel>> m_loadedWmoModels;
-    std::unordered_map<std::string, std::weak_ptr<DoodadModel>>
-        m_loadedDoodadModels;
+    // obstacle shapes by GUID, which share the GUIDs of game objects
+    std::unordered_map<std::uint64_t, ObstacleShape> m_obstacleShapes;
 
-    // ensures that the model for a particular WMO instance is loaded
-    std::shared_ptr<WmoModel> LoadModelForWmoInstance(unsigned int instanceId);
 
-    // ensures that the model for a particular doodad instance is loaded
-    std::shared_ptr<DoodadModel>
-    LoadModelForDoodadInstance(unsigned int instanceId);
+    // translated vertices of temporary doodads, keyed by model filename and
+    // transform, so that game objects placed identically share them
+    std::unordered_map<std::string, std::weak_ptr<const TranslatedVertices>>
+        m_translatedVertexCache;
+    std::size_t m_translatedVertexSweepSize;
 
-    // ensure that the given WMO model is loaded
+    // ensure that the given WMO model is loaded.  models are shared by all
+    // maps through the ModelCache
     std::shared_ptr<WmoModel> EnsureWmoModelLoaded(const std::string& mpq_path);
+    std::shared_ptr<WmoModel> LoadWmoModel(const std::string& bvhFilename);
 
     // ensure that the given doodad model is loaded
     std::shared_ptr<DoodadModel>
     EnsureDoodadModelLoaded(const std::string& mpq_path);
 
+    std::atomic<RegionPartition> m_rebuildPartition;
+
+    // guards m_navMesh and m_tiles against tile rebuilds completing on the
+    // rebuild threads
+    mutable std::shared_mutex m_mutex;
+
+    // m_navQuery keeps the node pools of its searches in itself, so however
+    // many threads share m_mutex, only one of them may use it for a search
+    // (findPath, moveAlongSurface and the like) at a time.  lookups which
+    // keep no state, such as findNearestPoly and raycast, need only m_mutex.
+    // always locked after m_mutex
+    mutable std::mutex m_queryMutex;
+
+    // this must be declared after every member a rebuild job may touch, so that
+    // it is destroyed (and its jobs finished) before any of them
+    TileRebuilder m_rebuilder;
+
+    // finds the coordinates of the tile containing the given (x, y).  the tile
+    // need not exist or be loaded
+    void GetTileCoordinates(float x, float y, int& tileX, int& tileY) const;
     const Tile* GetTile(float x, float y) const;
 
+    // whether a game object with the given guid is held by any loaded tile.
+    // drops the entry of one which no longer is
+    bool GameObjectExists(std::uint64_t guid);
+
+    // loaded tiles whose height fields overlap the given bounds
+    void GetOverlappingTiles(const math::BoundingBox& bounds,
+                             std::vector<Tile*>& tiles) const;
+
+    std::shared_ptr<const TranslatedVertices>
+    GetTranslatedVertices(const std::string& modelFilename,
+                          const DoodadModel& model,
+                          const math::Matrix& transform);
+
+    // called on a rebuild thread once a new mesh for a tile is ready.  the
+    // doodad, if any, is recorded as a temporary doodad of the tile
+    void SwapTileMesh(int x, int y,
+                      const std::shared_ptr<TileHeightField>& heightField,
+                      std::uint64_t guid,
+                      const std::shared_ptr<DoodadInstance>& doodad,
+                      std::vector<std::uint8_t>&& tileData);
+
+    // the caller must hold at least a shared lock on the map, but not
+    // m_queryMutex, which this takes
+    bool FindFilteredPath(const math::Vertex& start, const math::Vertex& end,
+                          std::vector<math::Vertex>& output, bool allowPartial,
+                          const dtQueryFilter& filter) const;
+    // routes through the portal graph, whose costs assume the default query
+    // filter, and so searches each leg with that filter
+    bool FindHierarchicalPath(dtPolyRef startRef, const float* recastStart,
+                              dtPolyRef endRef, const float* recastEnd,
+                              std::vector<math::Vertex>& output,
+                              bool allowPartial) const;
+
     bool GetADTHeight(const Tile* tile, float x, float y, float& height,
                       unsigned int* zone = nullptr,
                       unsigned int* area = nullptr) const;
@@ -107,14 +313,55 @@ private:
                  bool doodads, unsigned int* zone = nullptr,
                  unsigned int* area = nullptr) const;
 
+    // appends the distance along the ray of every surface it crosses, not
+    // only the nearest one, sorted from the start of the ray
+    void RayCast(const math::Ray& ray, const std::vector<const Tile*>& tiles,
+                 bool doodads, std::vector<float>& distances) const;
+
+    // the height of (x, y) on the navmesh reached from source.  the caller
+    // must hold a shared lock, and hit provides the buffer for the navmesh
+    // ray cast
+    bool FindHeight(const Tile* tile, const math::Vertex& source, float x,
+                    float y, dtRaycastHit& hit, float& z) const;
+
+    // the zone and area of a position on the given tile.  the caller must
+    // hold a shared lock
+    bool ZoneAndArea(const Tile* tile, const math::Vertex& position,
+                     unsigned int& zone, unsigned int& area) const;
+
+    // every floor z at (x, y) on the given tile, highest first, followed by
+    // the adt height.  the caller must hold a shared lock
+    bool FindHeights(const Tile* tile, float x, float y,
+                     std::vector<float>& output) const;
+
     // TODO: need mechanism to cleanup expired weak pointers saved in the
     // containers of this class
 
 public:
     Map() = delete;
+    // selects the forking constructor
+    struct Fork
+    {
+    };
+
     Map(const Map&) = delete;
     Map(const std::filesystem::path& dataPath, const std::string& mapName);
 
+    // a map with the same tiles loaded as parent, for example one per dungeon
+    // instance, each with its own temporary obstacles.  the bvh index,
+    // instance tables and models are shared with the parent rather than read
+    // again.  each tile's mesh is copied rather than read and inflated again,
+    // so the fork holds as much navmesh data as the parent, and the islands
+    // and portal graph are copied rather than built again.  the height field
+    // of a tile is only loaded once an obstacle is added to it.  the parent
+    // may not have any temporary obstacles, or rebuilds in progress, since
+    // they would be part of the copied meshes.
+    Map(const Map& parent, Fork);
+
+    // stops any tile rebuilds, waiting for those in progress.  see
+    // SetDeferredTeardown
+    ~Map();
+
     bool HasADT(int x, int y) const;
     bool HasADTs() const;
     bool IsADTLoaded(int x, int y) const;
@@ -122,23 +369,83 @@ public:
     void UnloadADT(int x, int y);
     int LoadAllADTs();
 
-    // rotation specified in radians rotated around Z axis
+    // loads or unloads the tiles within a rectangle of tile coordinates,
+    // inclusive, rather than whole adts.  an adt partly loaded this way is not
+    // reported as loaded, but LoadADT loads only the rest of it.  returns the
+    // number of tiles added, which excludes those missing from the nav files
+    // of their adts.  maps based on a global wmo load all of their tiles when
+    // they are constructed, and these do nothing for them
+    int LoadTiles(int minX, int minY, int maxX, int maxY);
+    void UnloadTiles(int minX, int minY, int maxX, int maxY);
+
+    // loads the tiles overlapping the square of the given half width around
+    // (x, y), in world coordinates
+    int LoadTilesAround(float x, float y, float radius);
+
+    bool IsTileLoaded(int x, int y) const;
+
+    // rotation specified in radians rotated around Z axis.  the affected tiles
+    // are rebuilt in the background, and their existing meshes remain in use
+    // until the rebuild completes.  the optional callback is invoked when all
+    // of them have been rebuilt.
     void AddGameObject(std::uint64_t guid, unsigned int displayId,
                        const math::Vertex& position, float orientation,
-                       int doodadSet = -1);
+                       int doodadSet = -1, GameObjectCallback callback = {});
     void AddGameObject(std::uint64_t guid, unsigned int displayId,
                        const math::Vertex& position,
-                       const math::Quaternion& rotation, int doodadSet = -1);
+                       const math::Quaternion& rotation, int doodadSet = -1,
+                       GameObjectCallback callback = {});
     void AddGameObject(std::uint64_t guid, unsigned int displayId,
                        const math::Vertex& position,
-                       const math::Matrix& rotation, int doodadSet = -1);
+                       const math::Matrix& rotation, int doodadSet = -1,
+                       GameObjectCallback callback = {});
+
+    // adds an obstacle given by its shape.  this shares its GUIDs with game
+    // objects, and the affected tiles are rebuilt in the background as for
+    // them, but far more cheaply
+    void AddObstacle(std::uint64_t guid, const ObstacleShape& shape,
+                     GameObjectCallback callback = {});
+
+    // removes an obstacle added with AddObstacle, rebuilding the affected
+    // tiles in the background.  returns false if there is no such obstacle,
+    // in which case the callback is not invoked
+    bool RemoveObstacle(std::uint64_t guid, GameObjectCallback callback = {});
+
+    // blocks until all queued tile rebuilds have been applied
+    void WaitForRebuilds();
+
+    // number of tile rebuilds which are queued or in progress
+    std::size_t PendingRebuilds() const;
+
+    // memory held by each loaded tile, in no particular order
+    std::vector<TileMemoryUsage> GetTileMemoryUsage() const;
+
+    // region partitioning used by tile rebuilds queued from now on
+    void SetRebuildPartition(RegionPartition partition);
+    RegionPartition GetRebuildPartition() const;
+
+    // when enabled, destroying the map only detaches its tiles, and their
+    // memory, islands, portal graph and instance tables are freed later by
+    // the Teardown thread.  for owners which must not block for as long as
+    // freeing a loaded continent takes.  forks inherit the setting
+    void SetDeferredTeardown(bool enabled);
 
     std::shared_ptr<Model> GetOrLoadModelByDisplayId(unsigned int displayId);
 
+    // registers a filter which paths may be found with, replacing any filter
+    // of the same name
+    void SetPathFilter(const std::string& name, const PathFilter& filter);
+    bool HasPathFilter(const std::string& name) const;
+
     bool FindPath(const math::Vertex& start, const math::Vertex& end,
                   std::vector<math::Vertex>& output,
                   bool allowPartial = false) const;
 
+    // as above, using a filter registered with SetPathFilter
+    bool FindPath(const math::Vertex& start, const math::Vertex& end,
+                  std::vector<math::Vertex>& output, bool allowPartial,
+                  const std::string& filter) const;
+
     // for finding height(s) at a given (x, y), there are two scenarios:
     // 1: we want to find exactly one z for a given path which has this (x, y)
     // as a hop.  in this case, there should only be one correct value,
@@ -150,12 +457,40 @@ public:
     // probably doing something wrong
     bool FindHeight(const math::Vertex& source, float x, float y,
                     float& z) const; // scenario one
+    // FindHeight for each source and target (x, y), answered under a single
+    // lock.  heights[i] is only meaningful where found[i] is true.  returns
+    // the number of heights found
+    std::size_t FindHeight(const std::vector<math::Vertex>& sources,
+                           const std::vector<math::Vector2>& targets,
+                           std::vector<float>& heights,
+                           std::vector<bool>& found) const;
     bool FindHeights(float x, float y,
                      std::vector<float>& output) const; // scenario two
 
+    // FindHeights for a grid of columns, starting at (x, y) and step apart,
+    // in rows of the given number of columns along the x axis.  output holds
+    // the heights of each column in the same order, and is empty for columns
+    // with none.  every column is answered under a single lock
+    void FindHeights(float x, float y, float step, int columns, int rows,
+                     std::vector<std::vector<float>>& output) const;
+
     bool ZoneAndArea(const math::Vertex& position, unsigned int& zone,
                      unsigned int& area) const;
 
+    // ZoneAndArea for each position, answered under a single lock.  zones[i]
+    // and areas[i] are only meaningful where found[i] is true.  returns the
+    // number of positions found
+    std::size_t ZoneAndArea(const std::vector<math::Vertex>& positions,
+                            std::vector<unsigned int>& zones,
+                            std::vector<unsigned int>& areas,
+                            std::vector<bool>& found) const;
+
+    // when enabled, each tile records which of its adt quads are plain
+    // terrain, with no static wmo over them, and ZoneAndArea answers
+    // positions over those from the tile's own ids without a ray cast.
+    // applies to loaded tiles immediately, and to tiles loaded later
+    void SetZoneAreaRaster(bool enabled);
+
     // Returns true when there is line of sight from the start position to
     // the stop position.  The intended use of this is for spells and NPC
     // aggro, so doodads and temporary obstacles will be ignored.
@@ -21,6 +21,15 @@ struct DoodadModel : Model
 {
 };
 
+// the vertices of a doodad model transformed into wow coordinate space.
+// indices are obtained from the model.  this is shared between all instances
+// of a model which have the same transform.
+struct TranslatedVertices
+{
+    std::vector<math::Vertex> m_vertices;
+    math::BoundingBox m_bounds;
+};
+
 // always loaded
 struct DoodadInstance
 {
@@ -28,9 +37,8 @@ struct DoodadInstance
     math::Matrix m_inverseTransformMatrix;
     math::BoundingBox m_bounds;
     std::string m_modelFilename;
-    std::vector<math::Vertex>
-        m_translatedVertices; // wow coordinate space.  indices are obtained
-                              // from model.
+    std::shared_ptr<const TranslatedVertices>
+        m_translatedVertices; // only present for temporary obstacles
     std::weak_ptr<DoodadModel> m_model;
 };
 
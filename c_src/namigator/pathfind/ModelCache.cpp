@@ -0,0 +1,93 @@
+#include "ModelCache.hpp"
+
+namespace pathfind
+{
+ModelCache& ModelCache::Instance()
+{
+    static ModelCache instance;
+    return instance;
+}
+
+std::shared_ptr<DoodadModel>
+ModelCache::GetDoodad(const std::string& bvhPath,
+                      const Loader<DoodadModel>& loader)
+{
+    return Get(m_doodads, bvhPath, loader);
+}
+
+std::shared_ptr<WmoModel> ModelCache::GetWmo(const std::string& bvhPath,
+                                             const Loader<WmoModel>& loader)
+{
+    return Get(m_wmos, bvhPath, loader);
+}
+
+void ModelCache::SetCompact(bool compact)
+{
+    m_compact = compact;
+}
+
+bool ModelCache::IsCompact() const
+{
+    return m_compact;
+}
+
+std::size_t ModelCache::DoodadCount() const
+{
+    return Count(m_doodads);
+}
+
+std::size_t ModelCache::WmoCount() const
+{
+    return Count(m_wmos);
+}
+
+template <typename T>
+std::shared_ptr<T>
+ModelCache::Get(std::unordered_map<std::string, std::weak_ptr<T>>& models,
+                const std::string& bvhPath, const Loader<T>& loader)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto const i = models.find(bvhPath);
+        if (i != models.end())
+        {
+            if (auto model = i->second.lock())
+                return model;
+
+            models.erase(i);
+        }
+    }
+
+    auto model = loader();
+
+    if (m_compact)
+        model->m_aabbTree.Compact();
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto& cached = models[bvhPath];
+
+    if (auto existing = cached.lock())
+        return existing;
+
+    cached = model;
+
+    return model;
+}
+
+template <typename T>
+std::size_t ModelCache::Count(
+    const std::unordered_map<std::string, std::weak_ptr<T>>& models) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    std::size_t result = 0;
+
+    for (auto const& model : models)
+        if (!model.second.expired())
+            ++result;
+
+    return result;
+}
+} // namespace pathfind
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace pathfind
+{
+// process-wide cache of loaded models, keyed by BVH file path, so that every
+// map referencing a model (including several maps over the same data) shares
+// a single copy of it.  the cache holds weak references only, so a model is
+// unloaded once the last map using it releases it.
+//
+// models are never modified once they have been loaded, so they may be used by
+// any number of maps on any number of threads.
+class ModelCache
+{
+public:
+    template <typename T>
+    using Loader = std::function<std::shared_ptr<T>()>;
+
+    static ModelCache& Instance();
+
+    ModelCache(const ModelCache&) = delete;
+    ModelCache& operator=(const ModelCache&) = delete;
+
+    // returns the model loaded from the given BVH file, calling the loader if
+    // it is not currently loaded.  the loader runs without the cache locked,
+    // so it may itself request other models.  if two threads load the same
+    // model at once, the first to finish wins and the other copy is dropped.
+    std::shared_ptr<DoodadModel> GetDoodad(const std::string& bvhPath,
+                                           const Loader<DoodadModel>& loader);
+    std::shared_ptr<WmoModel> GetWmo(const std::string& bvhPath,
+                                     const Loader<WmoModel>& loader);
+
+    // when enabled, models loaded from now on have their trees compacted (see
+    // math::AABBTree::Compact), which takes about 1.7 times less memory.
+    // models already loaded are not changed
+    void SetCompact(bool compact);
+    bool IsCompact() const;
+
+    // number of distinct models currently loaded
+    std::size_t DoodadCount() const;
+    std::size_t WmoCount() const;
+
+private:
+    ModelCache() = default;
+
+    template <typename T>
+    std::shared_ptr<T>
+    Get(std::unordered_map<std::string, std::weak_ptr<T>>& models,
+        const std::string& bvhPath, const Loader<T>& loader);
+
+    template <typename T>
+    std::size_t
+    Count(const std::unordered_map<std::string, std::weak_ptr<T>>& models) const;
+
+    mutable std::mutex m_mutex;
+
+    std::atomic<bool> m_compact{false};
+
+    std::unordered_map<std::string, std::weak_ptr<DoodadModel>> m_doodads;
+    std::unordered_map<std::string, std::weak_ptr<WmoModel>> m_wmos;
+};
+} // namespace pathfind
@@ -0,0 +1,222 @@
+#include "NavArchive.hpp"
+
+#include "Common.hpp"
+#include "utility/Exception.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace pathfind
+{
+namespace
+{
+// one file for each adt, and one for a global wmo
+constexpr std::uint32_t MaxFiles = MeshSettings::Adts * MeshSettings::Adts + 1;
+constexpr std::uint32_t MaxTiles =
+    MeshSettings::TileCount * MeshSettings::TileCount;
+} // namespace
+
+fs::path NavArchive::PathFor(const fs::path& dataPath,
+                             const std::string& mapName)
+{
+    return dataPath / "Nav" / (mapName + ".pack");
+}
+
+NavArchive::NavArchive(const fs::path& path)
+    : m_path(path),
+#ifdef _WIN32
+      m_stream(path, std::ifstream::binary),
+#else
+      m_fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+#endif
+      m_compression(utility::Compression::Deflate),
+      m_adtFiles(MeshSettings::Adts * MeshSettings::Adts, -1),
+      m_globalWmoFile(-1)
+{
+#ifdef _WIN32
+    if (m_stream.fail())
+        THROW(Result::FAILED_TO_OPEN_NAV_ARCHIVE);
+#else
+    if (m_fd < 0)
+        THROW(Result::FAILED_TO_OPEN_NAV_ARCHIVE);
+#endif
+
+    // the destructor does not run if the constructor throws
+    try
+    {
+        Header header;
+        ReadAt(0, &header, sizeof(header));
+
+        if (header.m_magic != Magic || header.m_version != Version)
+            THROW(Result::INVALID_NAV_ARCHIVE);
+
+        if (header.m_fileCount > MaxFiles || header.m_tileCount > MaxTiles)
+            THROW(Result::INVALID_NAV_ARCHIVE);
+
+        if (header.m_compression !=
+                static_cast<std::uint32_t>(utility::Compression::Deflate) &&
+            header.m_compression !=
+                static_cast<std::uint32_t>(utility::Compression::Lz4))
+            THROW(Result::INVALID_NAV_ARCHIVE);
+
+        m_compression = static_cast<utility::Compression>(header.m_compression);
+
+        m_files.resize(header.m_fileCount);
+        m_tiles.resize(header.m_tileCount);
+
+        ReadAt(sizeof(header), m_files.data(),
+               m_files.size() * sizeof(FileEntry));
+        ReadAt(sizeof(header) + m_files.size() * sizeof(FileEntry),
+               m_tiles.data(), m_tiles.size() * sizeof(TileEntry));
+
+        for (auto i = 0u; i < m_files.size(); ++i)
+        {
+            auto const& file = m_files[i];
+
+            if (static_cast<std::uint64_t>(file.m_firstTile) +
+                    file.m_tileCount >
+                m_tiles.size())
+                THROW(Result::INVALID_NAV_ARCHIVE);
+
+            if (file.m_x == MeshSettings::WMOcoordinate &&
+                file.m_y == MeshSettings::WMOcoordinate)
+                m_globalWmoFile = static_cast<std::int32_t>(i);
+            else if (file.m_x < MeshSettings::Adts &&
+                     file.m_y < MeshSettings::Adts)
+                m_adtFiles[file.m_y * MeshSettings::Adts + file.m_x] =
+                    static_cast<std::int32_t>(i);
+            else
+                THROW(Result::INVALID_NAV_ARCHIVE);
+        }
+    }
+    catch (...)
+    {
+#ifndef _WIN32
+        ::close(m_fd);
+#endif
+        throw;
+    }
+}
+
+NavArchive::~NavArchive()
+{
+#ifndef _WIN32
+    ::close(m_fd);
+#endif
+}
+
+const NavArchive::FileEntry* NavArchive::FindFile(std::uint32_t x,
+                                                  std::uint32_t y) const
+{
+    std::int32_t index;
+
+    if (x == MeshSettings::WMOcoordinate && y == MeshSettings::WMOcoordinate)
+        index = m_globalWmoFile;
+    else if (x < MeshSettings::Adts && y < MeshSettings::Adts)
+        index = m_adtFiles[y * MeshSettings::Adts + x];
+    else
+        return nullptr;
+
+    return index < 0 ? nullptr : &m_files[index];
+}
+
+const NavArchive::TileEntry* NavArchive::GetTiles(const FileEntry& file) const
+{
+    return m_tiles.data() + file.m_firstTile;
+}
+
+const NavArchive::TileEntry* NavArchive::FindTile(int tileX, int tileY) const
+{
+    if (tileX < 0 || tileY < 0)
+        return nullptr;
+
+    auto const file = FindFile(tileX / MeshSettings::TilesPerADT,
+                               tileY / MeshSettings::TilesPerADT);
+
+    if (!file)
+        return nullptr;
+
+    auto const tiles = GetTiles(*file);
+
+    for (auto i = 0u; i < file->m_tileCount; ++i)
+        if (tiles[i].m_x == static_cast<std::uint32_t>(tileX) &&
+            tiles[i].m_y == static_cast<std::uint32_t>(tileY))
+            return &tiles[i];
+
+    return nullptr;
+}
+
+utility::BinaryStream NavArchive::Read(const TileEntry& tile) const
+{
+    std::vector<std::uint8_t> buffer(tile.m_size);
+    ReadAt(tile.m_offset, buffer.data(), buffer.size());
+
+    utility::BinaryStream result(buffer);
+    result.Decompress(tile.m_uncompressedSize, m_compression);
+    return result;
+}
+
+void NavArchive::ReadAt(std::uint64_t offset, void* buffer,
+                        std::size_t size) const
+{
+#ifdef _WIN32
+    std::lock_guard<std::mutex> guard(m_streamMutex);
+
+    m_stream.clear();
+    m_stream.seekg(static_cast<std::streamoff>(offset));
+    m_stream.read(static_cast<char*>(buffer),
+                  static_cast<std::streamsize>(size));
+
+    if (m_stream.fail())
+        THROW(Result::NAV_ARCHIVE_READ_FAILED);
+#else
+    auto out = static_cast<char*>(buffer);
+
+    // pread may return less than was asked for, and is retried from there
+    while (size > 0)
+    {
+        auto const result =
+            ::pread(m_fd, out, size, static_cast<off_t>(offset));
+
+        if (result < 0 && errno == EINTR)
+            continue;
+
+        if (result <= 0)
+            THROW(Result::NAV_ARCHIVE_READ_FAILED);
+
+        out += result;
+        offset += static_cast<std::uint64_t>(result);
+        size -= static_cast<std::size_t>(result);
+    }
+#endif
+}
+
+bool NavFile::Exists() const
+{
+    if (m_archive)
+        return !!m_archive->FindFile(m_x, m_y);
+
+    return fs::exists(m_path);
+}
+
+utility::BinaryStream NavFile::Read() const
+{
+    if (!m_archive)
+    {
+        utility::BinaryStream result(m_path);
+        result.Decompress();
+        return result;
+    }
+
+    assert(!!m_tile);
+
+    return m_archive->Read(*m_tile);
+}
+} // namespace pathfind
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "utility/BinaryStream.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace pathfind
+{
+// every nav file of a map packed into one file, so that loading an adt costs
+// reads of one open file rather than a stat, an open and a read of its own
+// file.  the archive begins with a table of the files it holds, and of the
+// tiles within each file, which is read once when it is opened.  each tile is
+// compressed on its own, as it would appear in the decompressed nav file, so
+// that a single tile may be read and inflated without the rest of its adt.
+// they are read on demand with a positional read of the open archive.  the
+// size of each tile is recorded, so that it is decompressed in one pass into a
+// buffer of that size.  tiles are compressed with deflate, or with lz4 when
+// the header says so, which is larger but faster to decompress.
+//
+// the archive is laid out as:
+//
+//   Header
+//   FileEntry[fileCount]
+//   TileEntry[tileCount]
+//   the data of each tile, at the offsets given in the tile table
+//
+// the global wmo of a map without adts is stored at the wmo coordinate.
+//
+// any number of threads may read from an archive at once.
+class NavArchive
+{
+public:
+    static constexpr std::uint32_t Magic = 'NPAK';
+    static constexpr std::uint32_t Version = 3;
+
+#pragma pack(push, 1)
+    struct Header
+    {
+        std::uint32_t m_magic;
+        std::uint32_t m_version;
+        std::uint32_t m_fileCount;
+        std::uint32_t m_tileCount;
+
+        // the utility::Compression of every tile
+        std::uint32_t m_compression;
+    };
+
+    struct FileEntry
+    {
+        std::uint32_t m_x;
+        std::uint32_t m_y;
+
+        // the tiles of this file in the tile table
+        std::uint32_t m_firstTile;
+        std::uint32_t m_tileCount;
+    };
+
+    struct TileEntry
+    {
+        std::uint32_t m_x;
+        std::uint32_t m_y;
+
+        // where the compressed tile is in the archive
+        std::uint64_t m_offset;
+        std::uint32_t m_size;
+
+        std::uint32_t m_uncompressedSize;
+    };
+#pragma pack(pop)
+
+    // the archive of the given map, which need not exist
+    static fs::path PathFor(const fs::path& dataPath,
+                            const std::string& mapName);
+
+    // reads the file and tile tables.  throws if the file cannot be opened or
+    // is not a nav archive
+    explicit NavArchive(const fs::path& path);
+    ~NavArchive();
+
+    NavArchive(const NavArchive&) = delete;
+    NavArchive& operator=(const NavArchive&) = delete;
+
+    const FileEntry* FindFile(std::uint32_t x, std::uint32_t y) const;
+
+    // the tiles of the file, which are contiguous in the tile table
+    const TileEntry* GetTiles(const FileEntry& file) const;
+
+    // the tile of the given tile coordinates, within the file of its adt
+    const TileEntry* FindTile(int tileX, int tileY) const;
+
+    // the decompressed tile
+    utility::BinaryStream Read(const TileEntry& tile) const;
+
+    utility::Compression GetCompression() const { return m_compression; }
+
+    const fs::path& GetPath() const { return m_path; }
+
+private:
+    void ReadAt(std::uint64_t offset, void* buffer, std::size_t size) const;
+
+    const fs::path m_path;
+
+#ifdef _WIN32
+    // without a positional read, reads must seek the shared stream
+    mutable std::ifstream m_stream;
+    mutable std::mutex m_streamMutex;
+#else
+    int m_fd;
+#endif
+
+    utility::Compression m_compression;
+
+    std::vector<FileEntry> m_files;
+    std::vector<TileEntry> m_tiles;
+
+    // index of the file of each adt in m_files, or -1 when there is none
+    std::vector<std::int32_t> m_adtFiles;
+    std::int32_t m_globalWmoFile;
+};
+
+// where a nav file is read from: the map's archive when it has one, or else
+// the loose file.  within an archive, each tile is read on its own
+struct NavFile
+{
+    std::shared_ptr<const NavArchive> m_archive;
+    fs::path m_path;
+    std::uint32_t m_x = 0;
+    std::uint32_t m_y = 0;
+
+    // the tile within the archive, which is owned by it
+    const NavArchive::TileEntry* m_tile = nullptr;
+
+    bool Exists() const;
+
+    // the decompressed contents of the loose file, or of the tile within the
+    // archive
+    utility::BinaryStream Read() const;
+};
+} // namespace pathfind
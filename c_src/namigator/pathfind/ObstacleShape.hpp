@@ -0,0 +1,45 @@
+#pragma once
+
+#include "recastnavigation/Recast/Include/Recast.h"
+#include "utility/BoundingBox.hpp"
+#include "utility/Vector.hpp"
+
+#include <vector>
+
+namespace pathfind
+{
+// a temporary obstacle described by a simple shape rather than by a model.
+// shapes are stamped onto the cached compact height field of each tile they
+// overlap, which skips rasterization, filtering and compaction, and unlike
+// models they may be removed again.  coordinates are world coordinates.
+struct ObstacleShape
+{
+    enum class Type
+    {
+        // m_position is the center of the base, with m_radius and m_height
+        Cylinder,
+        // m_min and m_max are opposite corners of an axis aligned box
+        Box,
+        // m_footprint is the outline of a convex polygon in (x, y), in order,
+        // extruded from m_position.Z by m_height
+        Convex,
+    };
+
+    Type m_type = Type::Cylinder;
+
+    math::Vertex m_position;
+    float m_radius = 0.f;
+    float m_height = 0.f;
+
+    math::Vertex m_min;
+    math::Vertex m_max;
+
+    std::vector<math::Vertex> m_footprint;
+
+    math::BoundingBox Bounds() const;
+
+    // marks every span of the compact height field within the shape as
+    // unwalkable
+    void Stamp(rcContext& ctx, rcCompactHeightfield& chf) const;
+};
+} // namespace pathfind
@@ -0,0 +1,299 @@
+#include "PathCorridor.hpp"
+
+#include "Map.hpp"
+#include "recastnavigation/Detour/Include/DetourCommon.h"
+#include "utility/MathHelper.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+namespace
+{
+constexpr float Extents[] = {5.f, 5.f, 5.f};
+
+// squared distance within which a surface move is considered to have reached
+// the position it was asked to
+constexpr float ReachedDistanceSquared = 0.01f;
+
+// the start of the corridor has moved to the last of the visited polygons.
+// replace the part of the corridor before the furthest polygon visited with
+// the visited polygons leading to it
+void MergeStartMoved(std::vector<dtPolyRef>& path,
+                     const dtPolyRef* visited, int visitedCount)
+{
+    for (auto i = static_cast<int>(path.size()) - 1; i >= 0; --i)
+        for (auto j = visitedCount - 1; j >= 0; --j)
+        {
+            if (path[i] != visited[j])
+                continue;
+
+            std::vector<dtPolyRef> merged(visited + j, visited + visitedCount);
+            std::reverse(merged.begin(), merged.end());
+            merged.insert(merged.end(), path.begin() + i + 1, path.end());
+
+            path = std::move(merged);
+            return;
+        }
+}
+
+// the end of the corridor has moved to the last of the visited polygons.
+// replace the part of the corridor after the earliest polygon visited with
+// the visited polygons following it
+void MergeEndMoved(std::vector<dtPolyRef>& path, const dtPolyRef* visited,
+                   int visitedCount)
+{
+    for (auto i = 0u; i < path.size(); ++i)
+        for (auto j = 0; j < visitedCount; ++j)
+        {
+            if (path[i] != visited[j])
+                continue;
+
+            path.resize(i + 1);
+            path.insert(path.end(), visited + j + 1, visited + visitedCount);
+            return;
+        }
+}
+} // namespace
+
+namespace pathfind
+{
+PathCorridor::PathCorridor(const Map& map)
+    : m_map(map), m_filter(map.m_queryFilter), m_position(), m_target(),
+      m_goal(), m_partial(false)
+{
+}
+
+PathCorridor::PathCorridor(const Map& map, const std::string& filter)
+    : m_map(map), m_filter(map.GetPathFilter(filter)), m_position(),
+      m_target(), m_goal(), m_partial(false)
+{
+}
+
+bool PathCorridor::Reset(const math::Vertex& start, const math::Vertex& target)
+{
+    std::shared_lock<std::shared_mutex> guard(m_map.m_mutex);
+    std::lock_guard<std::mutex> search(m_map.m_queryMutex);
+
+    float recastStart[3], recastTarget[3];
+    math::Convert::VertexToRecast(start, recastStart);
+    math::Convert::VertexToRecast(target, recastTarget);
+
+    return Replan(recastStart, recastTarget);
+}
+
+bool PathCorridor::MovePosition(const math::Vertex& position)
+{
+    std::shared_lock<std::shared_mutex> guard(m_map.m_mutex);
+    std::lock_guard<std::mutex> search(m_map.m_queryMutex);
+
+    float recastPosition[3];
+    math::Convert::VertexToRecast(position, recastPosition);
+
+    if (m_path.empty())
+        return false;
+
+    if (!IsValid() && !Replan(m_position, m_goal))
+        return false;
+
+    auto const& query = m_map.m_navQuery;
+
+    float result[3];
+    dtPolyRef visited[MaxVisited];
+    int visitedCount;
+
+    if (dtStatusFailed(query.moveAlongSurface(
+            m_path.front(), m_position, recastPosition, &m_filter, result,
+            visited, &visitedCount, MaxVisited)))
+        return false;
+
+    MergeStartMoved(m_path, visited, visitedCount);
+
+    // the surface move does not follow the height of the mesh
+    float height;
+    if (dtStatusSucceed(query.getPolyHeight(m_path.front(), result, &height)))
+        result[1] = height;
+
+    dtVcopy(m_position, result);
+
+    return true;
+}
+
+bool PathCorridor::MoveTarget(const math::Vertex& target)
+{
+    std::shared_lock<std::shared_mutex> guard(m_map.m_mutex);
+    std::lock_guard<std::mutex> search(m_map.m_queryMutex);
+
+    math::Convert::VertexToRecast(target, m_goal);
+
+    if (m_path.empty() || !IsValid())
+        return Replan(m_position, m_goal);
+
+    auto const& query = m_map.m_navQuery;
+
+    // a target which has moved a short walk along the surface only extends or
+    // trims the end of the corridor
+    if (!m_partial)
+    {
+        float result[3];
+        dtPolyRef visited[MaxVisited];
+        int visitedCount;
+
+        if (dtStatusSucceed(query.moveAlongSurface(
+                m_path.back(), m_target, m_goal, &m_filter, result, visited,
+                &visitedCount, MaxVisited)) &&
+            dtVdist2DSqr(result, m_goal) < ReachedDistanceSquared)
+        {
+            MergeEndMoved(m_path, visited, visitedCount);
+
+            float height;
+            if (dtStatusSucceed(
+                    query.getPolyHeight(m_path.back(), result, &height)))
+                result[1] = height;
+
+            dtVcopy(m_target, result);
+            return true;
+        }
+    }
+
+    // otherwise search again from a little way back along the corridor
+    auto const splice =
+        m_path.size() > TailPolys ? m_path.size() - TailPolys : 0;
+
+    float spliceStart[3];
+    if (splice == 0)
+        dtVcopy(spliceStart, m_position);
+    else if (dtStatusFailed(query.closestPointOnPoly(m_path[splice], m_goal,
+                                                     spliceStart, nullptr)))
+        return Replan(m_position, m_goal);
+
+    std::vector<dtPolyRef> tail;
+    float end[3];
+    bool partial;
+
+    if (!Search(m_path[splice], spliceStart, m_goal, tail, end, partial))
+        return false;
+
+    // a partial tail may only mean that the splice was too close to the end
+    if (partial && splice > 0)
+        return Replan(m_position, m_goal);
+
+    m_path.resize(splice);
+    m_path.insert(m_path.end(), tail.begin(), tail.end());
+    dtVcopy(m_target, end);
+    m_partial = partial;
+
+    return true;
+}
+
+std::vector<math::Vertex> PathCorridor::Corners(int maxCorners) const
+{
+    std::shared_lock<std::shared_mutex> guard(m_map.m_mutex);
+
+    std::vector<math::Vertex> result;
+
+    if (m_path.empty() || maxCorners <= 0 || !IsValid())
+        return result;
+
+    // the straight path begins with the current position, which is skipped
+    std::vector<float> buffer(3 * (maxCorners + 1));
+    int count;
+
+    if (dtStatusFailed(m_map.m_navQuery.findStraightPath(
+            m_position, m_target, &m_path[0], static_cast<int>(m_path.size()),
+            &buffer[0], nullptr, nullptr, &count, maxCorners + 1)))
+        return result;
+
+    for (auto i = 1; i < count; ++i)
+    {
+        math::Vertex corner;
+        math::Convert::VertexToWow(&buffer[3 * i], corner);
+        result.push_back(corner);
+    }
+
+    return result;
+}
+
+math::Vertex PathCorridor::Position() const
+{
+    math::Vertex result;
+    math::Convert::VertexToWow(m_position, result);
+    return result;
+}
+
+math::Vertex PathCorridor::Target() const
+{
+    math::Vertex result;
+    math::Convert::VertexToWow(m_target, result);
+    return result;
+}
+
+bool PathCorridor::Replan(const float* start, const float* target)
+{
+    // copy first, as either may refer to a member
+    float recastStart[3], recastTarget[3];
+    dtVcopy(recastStart, start);
+    dtVcopy(recastTarget, target);
+
+    dtVcopy(m_goal, recastTarget);
+    m_path.clear();
+    m_partial = false;
+
+    dtPolyRef startRef;
+    if (dtStatusFailed(m_map.m_navQuery.findNearestPoly(
+            recastStart, Extents, &m_filter, &startRef, m_position)) ||
+        !startRef)
+        return false;
+
+    return Search(startRef, m_position, recastTarget, m_path, m_target,
+                  m_partial);
+}
+
+bool PathCorridor::Search(dtPolyRef startRef, const float* start,
+                          const float* target, std::vector<dtPolyRef>& path,
+                          float* end, bool& partial) const
+{
+    auto const& query = m_map.m_navQuery;
+
+    dtPolyRef endRef;
+    float nearest[3];
+    if (dtStatusFailed(query.findNearestPoly(target, Extents, &m_filter,
+                                             &endRef, nearest)) ||
+        !endRef)
+        return false;
+
+    // as for Map::FindPath, a target on another island would only be found
+    // to be unreachable after searching every polygon reachable from start
+    if (!m_map.m_connectivity.Connected(m_map.m_navMesh, startRef, endRef))
+        return false;
+
+    dtPolyRef buffer[Map::MaxPathHops];
+    int count;
+
+    if (dtStatusFailed(query.findPath(startRef, endRef, start, nearest,
+                                      &m_filter, buffer, &count,
+                                      Map::MaxPathHops)) ||
+        count == 0)
+        return false;
+
+    path.assign(buffer, buffer + count);
+    partial = buffer[count - 1] != endRef;
+
+    if (!partial)
+        dtVcopy(end, nearest);
+    else if (dtStatusFailed(
+                 query.closestPointOnPoly(path.back(), nearest, end, nullptr)))
+        return false;
+
+    return true;
+}
+
+bool PathCorridor::IsValid() const
+{
+    for (auto const ref : m_path)
+        if (!m_map.m_navMesh.isValidPolyRef(ref))
+            return false;
+
+    return true;
+}
+} // namespace pathfind
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
+#include "recastnavigation/Detour/Include/DetourNavMeshQuery.h"
+#include "utility/Vector.hpp"
+
+#include <string>
+#include <vector>
+
+namespace pathfind
+{
+class Map;
+
+// the polygons an agent must cross to reach its target, kept between updates
+// so that moving the agent or its target adjusts the corridor rather than
+// searching for a new path.  this is the same technique as detour's
+// dtPathCorridor, built on the queries of the owning map.
+//
+// a corridor is used under the same rules as the queries of its map, and the
+// map must outlive it.  if a tile the corridor crosses is unloaded or rebuilt,
+// the next update searches for the whole path again.
+class PathCorridor
+{
+public:
+    explicit PathCorridor(const Map& map);
+
+    // uses a filter registered with Map::SetPathFilter
+    PathCorridor(const Map& map, const std::string& filter);
+
+    // searches for a new corridor from start to target.  if the target cannot
+    // be reached, the corridor ends at the nearest reachable point and
+    // IsPartial() returns true.  returns false when there is no corridor.
+    bool Reset(const math::Vertex& start, const math::Vertex& target);
+
+    // moves the agent towards the given position, constrained to the surface
+    // of the navmesh, and trims or extends the start of the corridor to
+    // match.  returns false if the corridor had to be rebuilt and could not be
+    bool MovePosition(const math::Vertex& position);
+
+    // moves the target, extending the end of the corridor when it is a short
+    // walk away and otherwise searching again for the last part of the path
+    // only.  returns false when the new target cannot be reached at all
+    bool MoveTarget(const math::Vertex& target);
+
+    // the turns of the straight path from the current position to the
+    // target, at most maxCorners of them.  the last one is the target, if
+    // the corridor reaches it
+    std::vector<math::Vertex> Corners(int maxCorners) const;
+
+    math::Vertex Position() const;
+    math::Vertex Target() const;
+
+    bool IsPartial() const { return m_partial; }
+    bool IsEmpty() const { return m_path.empty(); }
+
+private:
+    // number of polygons at the end of the corridor searched again when the
+    // target moves out of reach of a surface move
+    static constexpr std::size_t TailPolys = 32;
+
+    // upper bound on the polygons visited by a single surface move
+    static constexpr int MaxVisited = 16;
+
+    // searches for the whole corridor again.  the caller must hold a shared
+    // lock on the map and its query mutex
+    bool Replan(const float* start, const float* target);
+
+    // searches for the polygons from startRef towards target, and the point
+    // at which they end.  the caller must hold a shared lock on the map and
+    // its query mutex
+    bool Search(dtPolyRef startRef, const float* start, const float* target,
+                std::vector<dtPolyRef>& path, float* end, bool& partial) const;
+
+    // true when every polygon of the corridor is still part of the navmesh
+    bool IsValid() const;
+
+    const Map& m_map;
+    const dtQueryFilter m_filter;
+
+    std::vector<dtPolyRef> m_path;
+
+    // recast coordinates.  the target is where the corridor ends, and the
+    // goal where it was asked to end, which differ when it is partial
+    float m_position[3];
+    float m_target[3];
+    float m_goal[3];
+
+    bool m_partial;
+};
+} // namespace pathfind
@@ -0,0 +1,438 @@
+#include "PortalGraph.hpp"
+
+#include "recastnavigation/Detour/Include/DetourCommon.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace
+{
+constexpr float Unreachable = -1.f;
+constexpr std::uint8_t InternalLink = 0xFF;
+
+void PolyCenters(const dtMeshTile* tile, std::vector<float>& centers)
+{
+    centers.assign(3 * tile->header->polyCount, 0.f);
+
+    for (auto i = 0; i < tile->header->polyCount; ++i)
+    {
+        auto const& poly = tile->polys[i];
+        auto const center = &centers[3 * i];
+
+        for (auto j = 0; j < poly.vertCount; ++j)
+            dtVadd(center, center, &tile->verts[3 * poly.verts[j]]);
+
+        if (poly.vertCount > 0)
+            dtVscale(center, center, 1.f / poly.vertCount);
+    }
+}
+
+// distance from the source polygon to every polygon of the tile, travelling
+// between polygon centers without leaving the tile
+void TileDistances(const dtNavMesh& navMesh, const dtMeshTile* tile,
+                   const std::vector<float>& centers, int source,
+                   std::vector<float>& distances)
+{
+    using Entry = std::pair<float, int>;
+
+    distances.assign(tile->header->polyCount,
+                     std::numeric_limits<float>::infinity());
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    distances[source] = 0.f;
+    open.push({0.f, source});
+
+    while (!open.empty())
+    {
+        auto const current = open.top();
+        open.pop();
+
+        if (current.first > distances[current.second])
+            continue;
+
+        auto const& poly = tile->polys[current.second];
+
+        for (auto link = poly.firstLink; link != DT_NULL_LINK;
+             link = tile->links[link].next)
+        {
+            if (tile->links[link].side != InternalLink ||
+                !tile->links[link].ref)
+                continue;
+
+            // internal links always refer to polygons of the same tile
+            auto const next = static_cast<int>(
+                navMesh.decodePolyIdPoly(tile->links[link].ref));
+            auto const cost =
+                current.first + dtVdist(&centers[3 * current.second],
+                                        &centers[3 * next]);
+
+            if (cost < distances[next])
+            {
+                distances[next] = cost;
+                open.push({cost, next});
+            }
+        }
+    }
+}
+
+// border edges which share a vertex belong to the same run
+int FindRun(std::vector<int>& parent, int vertex)
+{
+    while (parent[vertex] != vertex)
+    {
+        parent[vertex] = parent[parent[vertex]];
+        vertex = parent[vertex];
+    }
+
+    return vertex;
+}
+} // namespace
+
+namespace pathfind
+{
+void PortalGraph::AddTile(const dtNavMesh& navMesh, dtTileRef ref)
+{
+    auto const tile = navMesh.getTileByRef(ref);
+
+    if (!tile || !tile->header)
+        return;
+
+    auto& cluster = m_clusters[navMesh.decodePolyIdTile(ref)];
+    cluster = {};
+
+    struct BorderEdge
+    {
+        int m_poly;
+        int m_a;
+        int m_b;
+        int m_run;
+    };
+
+    std::vector<int> parent(tile->header->vertCount);
+    std::vector<BorderEdge> edges;
+
+    for (std::uint8_t side = 0; side < 8; ++side)
+    {
+        edges.clear();
+
+        for (auto i = 0; i < tile->header->polyCount; ++i)
+        {
+            auto const& poly = tile->polys[i];
+
+            if (poly.getType() != DT_POLYTYPE_GROUND)
+                continue;
+
+            for (auto j = 0; j < poly.vertCount; ++j)
+                if (poly.neis[j] == (DT_EXT_LINK | side))
+                    edges.push_back({i, poly.verts[j],
+                                     poly.verts[(j + 1) % poly.vertCount], 0});
+        }
+
+        if (edges.empty())
+            continue;
+
+        for (auto const& edge : edges)
+        {
+            parent[edge.m_a] = edge.m_a;
+            parent[edge.m_b] = edge.m_b;
+        }
+
+        for (auto const& edge : edges)
+            parent[FindRun(parent, edge.m_a)] = FindRun(parent, edge.m_b);
+
+        for (auto& edge : edges)
+            edge.m_run = FindRun(parent, edge.m_a);
+
+        // edges of the same run end up adjacent
+        std::sort(edges.begin(), edges.end(),
+                  [](const BorderEdge& a, const BorderEdge& b)
+                  { return a.m_run < b.m_run; });
+
+        for (auto run = edges.begin(); run != edges.end();)
+        {
+            auto const end =
+                std::find_if(run, edges.end(),
+                             [run](const BorderEdge& edge)
+                             { return edge.m_run != run->m_run; });
+
+            float midpoint[3];
+            float center[3] = {};
+
+            for (auto edge = run; edge != end; ++edge)
+            {
+                dtVlerp(midpoint, &tile->verts[3 * edge->m_a],
+                        &tile->verts[3 * edge->m_b], 0.5f);
+                dtVadd(center, center, midpoint);
+            }
+
+            dtVscale(center, center,
+                     1.f / static_cast<float>(std::distance(run, end)));
+
+            // routes pass through the edge nearest the middle of the run
+            Entrance entrance;
+            entrance.m_side = side;
+
+            auto best = std::numeric_limits<float>::infinity();
+            auto const entranceIndex =
+                static_cast<std::uint16_t>(cluster.m_entrances.size());
+
+            for (auto edge = run; edge != end; ++edge)
+            {
+                dtVlerp(midpoint, &tile->verts[3 * edge->m_a],
+                        &tile->verts[3 * edge->m_b], 0.5f);
+
+                auto const distance = dtVdistSqr(midpoint, center);
+
+                if (distance < best)
+                {
+                    best = distance;
+                    entrance.m_poly = static_cast<std::uint16_t>(edge->m_poly);
+                    dtVcopy(entrance.m_position, midpoint);
+                }
+
+                auto const key =
+                    static_cast<std::uint32_t>(edge->m_poly) << 3 | side;
+
+                if (cluster.m_portals.emplace(key, entranceIndex).second)
+                    entrance.m_polys.push_back(
+                        static_cast<std::uint16_t>(edge->m_poly));
+            }
+
+            cluster.m_entrances.push_back(std::move(entrance));
+            run = end;
+        }
+    }
+
+    auto const count = cluster.m_entrances.size();
+    cluster.m_costs.assign(count * count, Unreachable);
+
+    std::vector<float> centers, distances;
+    PolyCenters(tile, centers);
+
+    for (auto i = 0u; i < count; ++i)
+    {
+        auto const& from = cluster.m_entrances[i];
+
+        TileDistances(navMesh, tile, centers, from.m_poly, distances);
+
+        for (auto j = 0u; j < count; ++j)
+        {
+            auto const& to = cluster.m_entrances[j];
+
+            if (distances[to.m_poly] == std::numeric_limits<float>::infinity())
+                continue;
+
+            cluster.m_costs[i * count + j] =
+                dtVdist(from.m_position, &centers[3 * from.m_poly]) +
+                distances[to.m_poly] +
+                dtVdist(&centers[3 * to.m_poly], to.m_position);
+        }
+    }
+}
+
+void PortalGraph::RemoveTile(const dtNavMesh& navMesh, dtTileRef ref)
+{
+    m_clusters.erase(navMesh.decodePolyIdTile(ref));
+}
+
+void PortalGraph::EntranceCosts(const dtNavMesh& navMesh,
+                                const dtMeshTile* tile,
+                                const Cluster& cluster, int poly,
+                                const float* position,
+                                std::vector<float>& costs)
+{
+    std::vector<float> centers, distances;
+    PolyCenters(tile, centers);
+    TileDistances(navMesh, tile, centers, poly, distances);
+
+    costs.assign(cluster.m_entrances.size(), Unreachable);
+
+    for (auto i = 0u; i < cluster.m_entrances.size(); ++i)
+    {
+        auto const& entrance = cluster.m_entrances[i];
+
+        if (distances[entrance.m_poly] ==
+            std::numeric_limits<float>::infinity())
+            continue;
+
+        costs[i] = dtVdist(position, &centers[3 * poly]) +
+                   distances[entrance.m_poly] +
+                   dtVdist(&centers[3 * entrance.m_poly], entrance.m_position);
+    }
+}
+
+bool PortalGraph::FindRoute(const dtNavMesh& navMesh, dtPolyRef startRef,
+                            const float* startPos, dtPolyRef endRef,
+                            const float* endPos,
+                            std::vector<Waypoint>& route) const
+{
+    auto const startIndex = navMesh.decodePolyIdTile(startRef);
+    auto const endIndex = navMesh.decodePolyIdTile(endRef);
+
+    auto const startCluster = m_clusters.find(startIndex);
+    auto const endCluster = m_clusters.find(endIndex);
+
+    if (startCluster == m_clusters.end() || endCluster == m_clusters.end())
+        return false;
+
+    const dtMeshTile* startTile;
+    const dtMeshTile* endTile;
+    const dtPoly* poly;
+
+    navMesh.getTileAndPolyByRefUnsafe(startRef, &startTile, &poly);
+    navMesh.getTileAndPolyByRefUnsafe(endRef, &endTile, &poly);
+
+    std::vector<float> startCosts, endCosts;
+    EntranceCosts(navMesh, startTile, startCluster->second,
+                  navMesh.decodePolyIdPoly(startRef), startPos, startCosts);
+    EntranceCosts(navMesh, endTile, endCluster->second,
+                  navMesh.decodePolyIdPoly(endRef), endPos, endCosts);
+
+    // nodes are entrances, identified by tile index and entrance index
+    using Node = std::uint64_t;
+    constexpr Node Start = ~Node(0);
+    constexpr Node Goal = ~Node(0) - 1;
+
+    struct Visit
+    {
+        float m_cost = std::numeric_limits<float>::infinity();
+        Node m_parent = Start;
+        bool m_closed = false;
+    };
+
+    auto const entranceOf = [this](Node node) -> const Entrance&
+    {
+        // only entrances of tiles with a cluster are ever visited
+        return m_clusters.find(static_cast<unsigned int>(node >> 32))
+            ->second.m_entrances[node & 0xFFFFFFFF];
+    };
+
+    std::unordered_map<Node, Visit> visits;
+
+    using Entry = std::pair<float, Node>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    auto const relax = [&](Node node, float cost, Node parent)
+    {
+        auto& visit = visits[node];
+
+        if (visit.m_closed || cost >= visit.m_cost)
+            return;
+
+        visit.m_cost = cost;
+        visit.m_parent = parent;
+
+        auto const heuristic =
+            node == Goal ? 0.f : dtVdist(entranceOf(node).m_position, endPos);
+
+        open.push({cost + heuristic, node});
+    };
+
+    for (auto i = 0u; i < startCosts.size(); ++i)
+        if (startCosts[i] != Unreachable)
+            relax(Node(startIndex) << 32 | i, startCosts[i], Start);
+
+    while (!open.empty())
+    {
+        auto const node = open.top().second;
+        open.pop();
+
+        if (node == Goal)
+            break;
+
+        auto& visit = visits[node];
+
+        if (visit.m_closed)
+            continue;
+
+        visit.m_closed = true;
+
+        auto const cost = visit.m_cost;
+        auto const tileIndex = static_cast<unsigned int>(node >> 32);
+        auto const entranceIndex = static_cast<unsigned int>(node & 0xFFFFFFFF);
+        auto const& cluster = m_clusters.find(tileIndex)->second;
+        auto const& entrance = cluster.m_entrances[entranceIndex];
+        auto const count = cluster.m_entrances.size();
+
+        if (tileIndex == endIndex && endCosts[entranceIndex] != Unreachable)
+            relax(Goal, cost + endCosts[entranceIndex], node);
+
+        // other entrances of this tile
+        for (auto i = 0u; i < count; ++i)
+        {
+            auto const edgeCost = cluster.m_costs[entranceIndex * count + i];
+
+            if (i != entranceIndex && edgeCost != Unreachable)
+                relax(Node(tileIndex) << 32 | i, cost + edgeCost, node);
+        }
+
+        // entrances of the neighbouring tile, found through the current links
+        // so that tiles loaded or unloaded since this one need no updates
+        auto const tile = navMesh.getTile(static_cast<int>(tileIndex));
+        auto const opposite = static_cast<std::uint32_t>((entrance.m_side + 4) & 7);
+
+        for (auto const polyIndex : entrance.m_polys)
+        {
+            auto const& poly = tile->polys[polyIndex];
+
+            for (auto link = poly.firstLink; link != DT_NULL_LINK;
+                 link = tile->links[link].next)
+            {
+                if (tile->links[link].side != entrance.m_side)
+                    continue;
+
+                auto const ref = tile->links[link].ref;
+                auto const neighbourIndex = navMesh.decodePolyIdTile(ref);
+
+                auto const neighbourCluster = m_clusters.find(neighbourIndex);
+
+                if (neighbourCluster == m_clusters.end())
+                    continue;
+
+                auto const& neighbour = neighbourCluster->second;
+                auto const portal = neighbour.m_portals.find(
+                    navMesh.decodePolyIdPoly(ref) << 3 | opposite);
+
+                if (portal == neighbour.m_portals.end())
+                    continue;
+
+                auto const next = Node(neighbourIndex) << 32 | portal->second;
+
+                relax(next,
+                      cost + dtVdist(entrance.m_position,
+                                     entranceOf(next).m_position),
+                      node);
+            }
+        }
+    }
+
+    auto const goal = visits.find(Goal);
+
+    if (goal == visits.end())
+        return false;
+
+    route.clear();
+
+    for (auto node = goal->second.m_parent; node != Start;
+         node = visits[node].m_parent)
+    {
+        auto const& entrance = entranceOf(node);
+
+        Waypoint waypoint;
+        waypoint.m_ref =
+            navMesh.getPolyRefBase(navMesh.getTile(static_cast<int>(node >> 32))) |
+            entrance.m_poly;
+        dtVcopy(waypoint.m_position, entrance.m_position);
+
+        route.push_back(waypoint);
+    }
+
+    std::reverse(route.begin(), route.end());
+
+    return true;
+}
+} // namespace pathfind
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace pathfind
+{
+// a coarse graph over the navmesh for long distance paths.  each tile is a
+// cluster, and each contiguous run of polygon edges along one side of a tile is
+// an entrance to it.  the cost of travelling between every pair of entrances of
+// a tile is found when the tile is added, so a route between distant points is
+// found by searching the entrances only.  the route is then refined through
+// dtNavMeshQuery one short leg at a time, so that long paths are bounded by
+// neither the query node pool nor the polygon limit of a single search.
+//
+// the costs are distances between polygon centers, as the default query filter
+// sees them.  a filter which excludes or reweighs polygons would need routes
+// the graph cannot give, so it is only used with the default filter.  even
+// then a route may not be the shortest possible path, and may occasionally
+// require refinement to take a detour.
+//
+// like Connectivity, every modification must be made with the owning map
+// locked exclusively, while routes may be found concurrently.
+class PortalGraph
+{
+public:
+    struct Waypoint
+    {
+        dtPolyRef m_ref;
+        float m_position[3];
+    };
+
+    // must be called after the tile has been added to the navmesh
+    void AddTile(const dtNavMesh& navMesh, dtTileRef ref);
+
+    // must be called after the tile has been removed from the navmesh
+    void RemoveTile(const dtNavMesh& navMesh, dtTileRef ref);
+
+    // finds the entrances a path from start to end should pass through, in
+    // order.  the start and end are not included.  returns false when no
+    // route exists between the two polygons.
+    bool FindRoute(const dtNavMesh& navMesh, dtPolyRef startRef,
+                   const float* startPos, dtPolyRef endRef,
+                   const float* endPos, std::vector<Waypoint>& route) const;
+
+private:
+    struct Entrance
+    {
+        // the polygon at the middle of the run, and the midpoint of its edge on
+        // the border, through which routes pass
+        std::uint16_t m_poly;
+        float m_position[3];
+
+        // the side of the tile, as used by detour links
+        std::uint8_t m_side;
+
+        // every polygon with an edge in the run
+        std::vector<std::uint16_t> m_polys;
+    };
+
+    struct Cluster
+    {
+        std::vector<Entrance> m_entrances;
+
+        // entrance count squared, negative where there is no path between two
+        // entrances within the tile
+        std::vector<float> m_costs;
+
+        // entrance of each border polygon, keyed by poly << 3 | side
+        std::unordered_map<std::uint32_t, std::uint16_t> m_portals;
+    };
+
+    // cost from a polygon of the tile to each of its entrances
+    static void EntranceCosts(const dtNavMesh& navMesh, const dtMeshTile* tile,
+                              const Cluster& cluster, int poly,
+                              const float* position, std::vector<float>& costs);
+
+    // by tile index.  only loaded tiles have a cluster, as a navmesh may have
+    // room for far more tiles than are ever loaded
+    std::unordered_map<unsigned int, Cluster> m_clusters;
+};
+} // namespace pathfind
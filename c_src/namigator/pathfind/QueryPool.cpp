@@ -0,0 +1,222 @@
+#include "QueryPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace pathfind
+{
+QueryPool::QueryPool(std::size_t workers, std::size_t queueLimit)
+    : m_queueLimit(queueLimit)
+{
+    if (!workers)
+        workers = (std::max)(1u, std::thread::hardware_concurrency());
+
+    m_workers.reserve(workers);
+
+    for (auto i = 0u; i < workers; ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+}
+
+QueryPool::~QueryPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_shutdown = true;
+
+        // the queues of running keys are left in place for their workers to
+        // remove
+        for (auto& queue : m_queues)
+            queue.second.m_jobs.clear();
+
+        for (auto& worker : m_workers)
+        {
+            std::lock_guard<std::mutex> ready(worker->m_mutex);
+            m_readyKeys -= worker->m_ready.size();
+            worker->m_ready.clear();
+        }
+
+        m_queued = 0;
+    }
+
+    m_jobReady.notify_all();
+
+    for (auto& worker : m_workers)
+        if (worker->m_thread.joinable())
+            worker->m_thread.join();
+}
+
+bool QueryPool::Submit(Key key, Job&& job)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        assert(!m_shutdown);
+
+        auto& queue = m_queues[key];
+
+        if (m_queueLimit && queue.m_jobs.size() >= m_queueLimit)
+        {
+            ++m_rejected;
+            return false;
+        }
+
+        auto const ready = queue.m_jobs.empty() && !queue.m_running;
+
+        queue.m_jobs.push_back(std::move(job));
+        ++m_queued;
+
+        if (ready)
+        {
+            PushReady(*m_workers[m_nextWorker], key);
+            m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+        }
+
+        if (!m_started)
+        {
+            m_started = true;
+
+            for (auto i = 0u; i < m_workers.size(); ++i)
+                m_workers[i]->m_thread = std::thread(&QueryPool::Run, this, i);
+        }
+    }
+
+    m_jobReady.notify_one();
+
+    return true;
+}
+
+void QueryPool::Wait()
+{
+    std::unique_lock<std::mutex> guard(m_mutex);
+    m_idle.wait(guard, [this]() { return !m_queued && !m_running; });
+}
+
+QueryPool::Stats QueryPool::GetStats() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    Stats stats {};
+    stats.m_workers = m_workers.size();
+    stats.m_queueLimit = m_queueLimit;
+    stats.m_queued = m_queued;
+    stats.m_running = m_running;
+    stats.m_keys = m_queues.size();
+    stats.m_completed = m_completed;
+    stats.m_rejected = m_rejected;
+    stats.m_stolen = m_stolen;
+
+    for (auto const& queue : m_queues)
+        stats.m_deepestQueue =
+            (std::max)(stats.m_deepestQueue, queue.second.m_jobs.size());
+
+    return stats;
+}
+
+void QueryPool::PushReady(Worker& worker, Key key)
+{
+    std::lock_guard<std::mutex> ready(worker.m_mutex);
+    worker.m_ready.push_back(key);
+    ++m_readyKeys;
+}
+
+bool QueryPool::TakeReady(std::size_t index, Key& key)
+{
+    auto const count = m_workers.size();
+
+    // the worker's own deque first, then those of the workers after it, so
+    // that thieves do not all start with the same victim
+    for (auto i = 0u; i < count; ++i)
+    {
+        auto& worker = *m_workers[(index + i) % count];
+
+        std::lock_guard<std::mutex> ready(worker.m_mutex);
+
+        if (worker.m_ready.empty())
+            continue;
+
+        key = worker.m_ready.front();
+        worker.m_ready.pop_front();
+
+        --m_readyKeys;
+
+        if (i)
+            ++m_stolen;
+
+        return true;
+    }
+
+    return false;
+}
+
+void QueryPool::Run(std::size_t index)
+{
+    auto& self = *m_workers[index];
+
+    while (true)
+    {
+        Key key;
+
+        if (!TakeReady(index, key))
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+
+            ++m_idleWorkers;
+            m_jobReady.wait(guard,
+                            [this]() { return m_shutdown || m_readyKeys; });
+            --m_idleWorkers;
+
+            if (m_shutdown)
+                break;
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(m_mutex);
+
+        // the pool was shut down after the key was taken
+        if (m_shutdown)
+            break;
+
+        // the queue of a running key is never removed by another thread, so
+        // the reference remains valid while the query runs
+        auto& queue = m_queues[key];
+        auto job = std::move(queue.m_jobs.front());
+        queue.m_jobs.pop_front();
+        queue.m_running = true;
+
+        --m_queued;
+        ++m_running;
+
+        guard.unlock();
+        job();
+        job = nullptr;
+        guard.lock();
+
+        --m_running;
+        ++m_completed;
+
+        queue.m_running = false;
+
+        // the key takes its next turn behind the other keys of this worker,
+        // unless an idle worker steals it first
+        if (!queue.m_jobs.empty())
+        {
+            PushReady(self, key);
+
+            if (m_idleWorkers)
+                m_jobReady.notify_one();
+        }
+        else
+            m_queues.erase(key);
+
+        if (!m_queued && !m_running)
+            m_idle.notify_all();
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (!m_running)
+        m_idle.notify_all();
+}
+} // namespace pathfind
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace pathfind
+{
+// runs queries on a work-stealing pool of background threads, for callers
+// which would rather be told the result of a query than wait for it.  each
+// query is queued with a key identifying the map it uses.  queries sharing a
+// key are run one at a time in the order in which they were queued, so what
+// the workers schedule is keys, not queries: a key with queries queued and
+// none running is ready, and sits in the deque of one worker.
+//
+// newly ready keys are dealt out to the workers in turn.  a worker takes the
+// oldest key of its own deque, runs that key's next query, and if the key has
+// more queued, puts it at the back of its deque again, so the keys of a
+// worker take turns.  a worker whose deque is empty steals the oldest key of
+// another's, so no worker sits idle while another has keys waiting.
+class QueryPool
+{
+public:
+    using Job = std::function<void()>;
+    using Key = const void*;
+
+    struct Stats
+    {
+        std::size_t m_workers;
+        std::size_t m_queueLimit;
+
+        // queries waiting to run, and queries running
+        std::size_t m_queued;
+        std::size_t m_running;
+
+        // keys with queries queued or running, and the most queries queued
+        // for any one of them
+        std::size_t m_keys;
+        std::size_t m_deepestQueue;
+
+        std::uint64_t m_completed;
+        std::uint64_t m_rejected;
+
+        // keys taken from the deque of another worker
+        std::uint64_t m_stolen;
+    };
+
+    // a worker count of zero uses one worker per hardware thread.  a queue
+    // limit of zero lets any number of queries be queued per key
+    explicit QueryPool(std::size_t workers = 0, std::size_t queueLimit = 0);
+    QueryPool(const QueryPool&) = delete;
+    QueryPool& operator=(const QueryPool&) = delete;
+
+    // discards any queries which have not yet started, and waits for those in
+    // progress (if any) to finish
+    ~QueryPool();
+
+    // queues the query, unless the key already has as many queued as the
+    // queue limit, in which case it is dropped and false is returned.  the
+    // query must not throw
+    bool Submit(Key key, Job&& job);
+
+    // blocks until all queued queries have finished
+    void Wait();
+
+    Stats GetStats() const;
+
+private:
+    struct KeyQueue
+    {
+        std::deque<Job> m_jobs;
+        bool m_running = false;
+    };
+
+    struct Worker
+    {
+        std::mutex m_mutex;
+
+        // ready keys, oldest first
+        std::deque<Key> m_ready;
+
+        std::thread m_thread;
+    };
+
+    // places a key which has just become ready at the back of the worker's
+    // deque.  the caller must hold m_mutex
+    void PushReady(Worker& worker, Key key);
+
+    // takes the oldest key of the worker's own deque or, failing that, of
+    // another worker's
+    bool TakeReady(std::size_t index, Key& key);
+
+    void Run(std::size_t index);
+
+    const std::size_t m_queueLimit;
+
+    // guards the per key queues and the counts below.  the deques of ready
+    // keys have locks of their own, so that finding work takes no shared lock
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_idle;
+
+    // keys with queries queued or running
+    std::unordered_map<Key, KeyQueue> m_queues;
+
+    // keys in any worker's deque.  only raised with m_mutex held, so that a
+    // worker waiting for it to be non-zero is always woken
+    std::atomic<std::size_t> m_readyKeys {0};
+
+    std::size_t m_queued = 0;
+    std::size_t m_running = 0;
+    std::uint64_t m_completed = 0;
+    std::uint64_t m_rejected = 0;
+    std::atomic<std::uint64_t> m_stolen {0};
+
+    // the worker the next newly ready key is given to
+    std::size_t m_nextWorker = 0;
+
+    std::size_t m_idleWorkers = 0;
+    bool m_started = false;
+    bool m_shutdown = false;
+
+    // the threads are only started by the first query
+    std::vector<std::unique_ptr<Worker>> m_workers;
+};
+} // namespace pathfind
@@ -0,0 +1,156 @@
+#include "RecastArena.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+namespace
+{
+// the arena which recast allocations on this thread are directed to, if any
+thread_local pathfind::RecastArena* t_activeArena = nullptr;
+
+constexpr int Uncached = -1;
+
+// precedes every block handed to recast.  the header is padded to the
+// alignment malloc guarantees so that the block itself remains suitably
+// aligned for any recast structure.
+struct alignas(alignof(std::max_align_t)) BlockHeader
+{
+    std::int32_t bucket;
+};
+
+BlockHeader* HeaderOf(void* ptr)
+{
+    return reinterpret_cast<BlockHeader*>(ptr) - 1;
+}
+
+void* BlockOf(BlockHeader* header)
+{
+    return header + 1;
+}
+
+// installs the arena allocation functions before any recast allocation can
+// take place.  because the arena functions fall through to malloc on threads
+// without an active scope, this is safe for all recast users.
+struct Installer
+{
+    Installer()
+    {
+        rcAllocSetCustom(&pathfind::RecastArena::Allocate,
+                         &pathfind::RecastArena::Free);
+    }
+} s_installer;
+} // namespace
+
+namespace pathfind
+{
+RecastArena::Scope::Scope(RecastArena& arena) : m_previous(t_activeArena)
+{
+    t_activeArena = &arena;
+}
+
+RecastArena::Scope::~Scope()
+{
+    t_activeArena = m_previous;
+}
+
+RecastArena::~RecastArena()
+{
+    assert(t_activeArena != this);
+    Release();
+}
+
+RecastArena& RecastArena::ThreadLocal()
+{
+    thread_local RecastArena arena;
+    return arena;
+}
+
+void RecastArena::Release()
+{
+    for (auto& bucket : m_free)
+    {
+        for (auto block : bucket)
+            std::free(block);
+
+        bucket.clear();
+        bucket.shrink_to_fit();
+    }
+
+    m_cachedBytes = 0;
+}
+
+void* RecastArena::Allocate(std::size_t size, rcAllocHint)
+{
+    auto arena = t_activeArena;
+
+    int bucket = Uncached;
+    std::size_t capacity = size;
+
+    if (arena && size <= (std::size_t(1) << MaxBucketShift))
+    {
+        bucket = 0;
+        while ((std::size_t(1) << (bucket + MinBucketShift)) < size)
+            ++bucket;
+
+        if (auto block = arena->Take(bucket))
+            return block;
+
+        capacity = std::size_t(1) << (bucket + MinBucketShift);
+        ++arena->m_systemAllocations;
+    }
+
+    auto header = static_cast<BlockHeader*>(
+        std::malloc(sizeof(BlockHeader) + capacity));
+
+    if (!header)
+        return nullptr;
+
+    header->bucket = bucket;
+
+    return BlockOf(header);
+}
+
+void RecastArena::Free(void* ptr)
+{
+    auto header = HeaderOf(ptr);
+
+    // blocks may be returned to whichever arena is active on the freeing
+    // thread, since every cached block is a separate system allocation
+    if (header->bucket != Uncached && t_activeArena &&
+        t_activeArena->Give(header->bucket, ptr))
+        return;
+
+    std::free(header);
+}
+
+void* RecastArena::Take(int bucket)
+{
+    auto& blocks = m_free[bucket];
+
+    if (blocks.empty())
+        return nullptr;
+
+    auto const header = static_cast<BlockHeader*>(blocks.back());
+    blocks.pop_back();
+
+    m_cachedBytes -= std::size_t(1) << (bucket + MinBucketShift);
+
+    return BlockOf(header);
+}
+
+bool RecastArena::Give(int bucket, void* block)
+{
+    auto const capacity = std::size_t(1) << (bucket + MinBucketShift);
+
+    if (m_cachedBytes + capacity > MaxCachedBytes)
+        return false;
+
+    // the free lists store the system allocation rather than the block, so
+    // that Release() can hand them straight back to the system allocator
+    m_free[bucket].push_back(HeaderOf(block));
+    m_cachedBytes += capacity;
+
+    return true;
+}
+} // namespace pathfind
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "recastnavigation/Recast/Include/RecastAlloc.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace pathfind
+{
+// caches the memory which recast allocates while rebuilding a tile, so that
+// after the first few rebuilds on a thread, subsequent rebuilds are served
+// entirely from the cache rather than from the system allocator.
+//
+// the arena is installed into recast through rcAllocSetCustom when the library
+// is loaded, but it is only used by threads which have an active
+// RecastArena::Scope.  every other recast allocation (for example, loading a
+// tile height field) falls through to malloc.  each block carries a small
+// header so that it may be freed from any thread, whether or not that thread
+// has an arena of its own.
+class RecastArena
+{
+public:
+    // makes the arena the target of recast allocations on the current thread
+    // for the lifetime of the scope
+    class Scope
+    {
+    public:
+        explicit Scope(RecastArena& arena);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+    private:
+        RecastArena* const m_previous;
+    };
+
+    RecastArena() = default;
+    RecastArena(const RecastArena&) = delete;
+    RecastArena& operator=(const RecastArena&) = delete;
+
+    ~RecastArena();
+
+    // the arena belonging to the calling thread
+    static RecastArena& ThreadLocal();
+
+    // number of bytes currently held in the cache, available for reuse
+    std::size_t CachedBytes() const { return m_cachedBytes; }
+
+    // number of blocks this arena has had to request from the system
+    // allocator.  once the arena is warm, this should stop increasing.
+    std::size_t SystemAllocations() const { return m_systemAllocations; }
+
+    // returns all cached blocks to the system allocator
+    void Release();
+
+    // the allocation functions installed with rcAllocSetCustom
+    static void* Allocate(std::size_t size, rcAllocHint hint);
+    static void Free(void* ptr);
+
+private:
+    // blocks are rounded up to a power of two between 2^MinBucketShift and
+    // 2^MaxBucketShift.  larger requests are never cached.
+    static constexpr int MinBucketShift = 6;
+    static constexpr int MaxBucketShift = 24;
+    static constexpr int BucketCount = MaxBucketShift - MinBucketShift + 1;
+
+    // upper bound on the memory kept around for reuse by a single thread
+    static constexpr std::size_t MaxCachedBytes = 64 * 1024 * 1024;
+
+    void* Take(int bucket);
+    bool Give(int bucket, void* block);
+
+    std::array<std::vector<void*>, BucketCount> m_free;
+    std::size_t m_cachedBytes = 0;
+    std::size_t m_systemAllocations = 0;
+};
+} // namespace pathfind
@@ -0,0 +1,190 @@
+#include "StaticInstances.hpp"
+
+#include "utility/Exception.hpp"
+#include "utility/Matrix.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace pathfind
+{
+namespace
+{
+// records are read this many at a time, rather than all at once, so that a
+// continent's doodads are never all held in their much larger file form
+constexpr std::uint32_t ReadBatchSize = 1024;
+} // namespace
+
+StaticInstances::StaticInstances(utility::BinaryStream& in)
+{
+    std::unordered_map<std::string, std::uint32_t> names;
+
+    ReadRecords<WmoFileInstance>(in, m_wmoRecords, names);
+    ReadRecords<DoodadFileInstance>(in, m_doodadRecords, names);
+}
+
+StaticInstances::StaticInstances(std::uint32_t id,
+                                 const WmoFileInstance& globalWmo)
+{
+    std::unordered_map<std::string, std::uint32_t> names;
+
+    m_wmoRecords.push_back(MakeRecord(globalWmo, names));
+    m_wmoRecords.back().m_id = id;
+}
+
+template <typename FileInstance>
+void StaticInstances::ReadRecords(
+    utility::BinaryStream& in, std::vector<Record>& records,
+    std::unordered_map<std::string, std::uint32_t>& names)
+{
+    std::uint32_t count;
+    in >> count;
+
+    records.reserve(count);
+
+    std::vector<FileInstance> batch;
+
+    for (auto remaining = count; remaining > 0;)
+    {
+        batch.resize((std::min)(remaining, ReadBatchSize));
+        in.ReadBytes(&batch[0], batch.size() * sizeof(FileInstance));
+
+        for (auto const& instance : batch)
+            records.push_back(MakeRecord(instance, names));
+
+        remaining -= static_cast<std::uint32_t>(batch.size());
+    }
+
+    // an id which appears more than once refers to its first instance
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& a, const Record& b)
+                     { return a.m_id < b.m_id; });
+}
+
+template <typename FileInstance>
+StaticInstances::Record StaticInstances::MakeRecord(
+    const FileInstance& instance,
+    std::unordered_map<std::string, std::uint32_t>& names)
+{
+    Record record {};
+
+    record.m_id = instance.m_id;
+    std::memcpy(record.m_transformMatrix, instance.m_transformMatrix,
+                sizeof(record.m_transformMatrix));
+    record.m_bounds = instance.m_bounds;
+
+    if constexpr (std::is_same_v<FileInstance, WmoFileInstance>)
+    {
+        record.m_doodadSet = instance.m_doodadSet;
+        record.m_nameSet = instance.m_nameSet;
+    }
+
+    auto const end = std::find(std::begin(instance.m_fileName),
+                               std::end(instance.m_fileName), '\0');
+    std::string name(std::begin(instance.m_fileName), end);
+
+    auto const interned = names.insert(
+        {std::move(name), static_cast<std::uint32_t>(m_fileNames.size())});
+
+    if (interned.second)
+        m_fileNames.push_back(interned.first->first);
+
+    record.m_fileName = interned.first->second;
+
+    return record;
+}
+
+const StaticInstances::Record*
+StaticInstances::Find(const std::vector<Record>& records,
+                      std::uint32_t id) const
+{
+    auto const i = std::lower_bound(records.begin(), records.end(), id,
+                                    [](const Record& record, std::uint32_t id)
+                                    { return record.m_id < id; });
+
+    return i == records.end() || i->m_id != id ? nullptr : &*i;
+}
+
+std::shared_ptr<const WmoInstance>
+StaticInstances::GetWmo(std::uint32_t id) const
+{
+    return Get(m_wmoRecords, m_wmos, id,
+               Result::UNKNOWN_WMO_INSTANCE_REQUESTED);
+}
+
+std::shared_ptr<const DoodadInstance>
+StaticInstances::GetDoodad(std::uint32_t id) const
+{
+    return Get(m_doodadRecords, m_doodads, id,
+               Result::UNKNOWN_DOODAD_INSTANCE_REQUESTED);
+}
+
+std::size_t StaticInstances::MaterializedWmoCount() const
+{
+    return Count(m_wmos);
+}
+
+std::size_t StaticInstances::MaterializedDoodadCount() const
+{
+    return Count(m_doodads);
+}
+
+template <typename Instance>
+std::shared_ptr<const Instance> StaticInstances::Get(
+    const std::vector<Record>& records,
+    std::unordered_map<std::uint32_t, std::weak_ptr<const Instance>>&
+        materialized,
+    std::uint32_t id, Result unknown) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto& cached = materialized[id];
+
+    if (auto existing = cached.lock())
+        return existing;
+
+    auto const record = Find(records, id);
+
+    // ensure it exists.  this should never fail
+    if (!record)
+    {
+        materialized.erase(id);
+        THROW(unknown);
+    }
+
+    auto instance = std::make_shared<Instance>();
+
+    if constexpr (std::is_same_v<Instance, WmoInstance>)
+    {
+        instance->m_doodadSet = record->m_doodadSet;
+        instance->m_nameSet = record->m_nameSet;
+    }
+
+    instance->m_transformMatrix = math::Matrix::CreateFromArray(
+        record->m_transformMatrix,
+        sizeof(record->m_transformMatrix) /
+            sizeof(record->m_transformMatrix[0]));
+    instance->m_inverseTransformMatrix =
+        instance->m_transformMatrix.ComputeInverse();
+    instance->m_bounds = record->m_bounds;
+    instance->m_modelFilename = m_fileNames[record->m_fileName];
+
+    cached = instance;
+
+    return instance;
+}
+
+template <typename Instance>
+std::size_t StaticInstances::Count(
+    const std::unordered_map<std::uint32_t, std::weak_ptr<const Instance>>&
+        materialized) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    return std::count_if(materialized.begin(), materialized.end(),
+                         [](const auto& instance)
+                         { return !instance.second.expired(); });
+}
+} // namespace pathfind
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Common.hpp"
+#include "Model.hpp"
+#include "utility/BinaryStream.hpp"
+#include "utility/BoundingBox.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pathfind
+{
+#pragma pack(push, 1)
+// the instance records of a .map file
+struct WmoFileInstance
+{
+    std::uint32_t m_id;
+    std::uint16_t m_doodadSet;
+    std::uint16_t m_nameSet;
+    float m_transformMatrix[16];
+    math::BoundingBox m_bounds;
+    char m_fileName[MeshSettings::MaxMPQPathLength];
+};
+
+struct DoodadFileInstance
+{
+    std::uint32_t m_id;
+    float m_transformMatrix[16];
+    math::BoundingBox m_bounds;
+    char m_fileName[MeshSettings::MaxMPQPathLength];
+};
+#pragma pack(pop)
+
+// the static wmo and doodad instances of a map.  they are kept much as they
+// are stored in the .map file, with their model names interned, and an
+// instance is only turned into a WmoInstance or DoodadInstance, with its
+// transform inverted, when a tile referencing it is loaded.  most doodads of a
+// continent are never referenced by a loaded tile.  the instance is then
+// shared by every tile holding it, in this map and in its forks, and is freed
+// with the last of them.
+//
+// any number of threads may get instances at once.
+class StaticInstances
+{
+public:
+    // reads the instance tables which follow the adt bitmap of a .map file
+    explicit StaticInstances(utility::BinaryStream& in);
+
+    // the instances of a map without adts, which is its global wmo
+    StaticInstances(std::uint32_t id, const WmoFileInstance& globalWmo);
+
+    StaticInstances(const StaticInstances&) = delete;
+    StaticInstances& operator=(const StaticInstances&) = delete;
+
+    // throw if there is no instance with the given id
+    std::shared_ptr<const WmoInstance> GetWmo(std::uint32_t id) const;
+    std::shared_ptr<const DoodadInstance> GetDoodad(std::uint32_t id) const;
+
+    std::size_t WmoCount() const { return m_wmoRecords.size(); }
+    std::size_t DoodadCount() const { return m_doodadRecords.size(); }
+
+    // number of instances currently held by a tile
+    std::size_t MaterializedWmoCount() const;
+    std::size_t MaterializedDoodadCount() const;
+
+private:
+    struct Record
+    {
+        std::uint32_t m_id;
+        std::uint16_t m_doodadSet;
+        std::uint16_t m_nameSet;
+        float m_transformMatrix[16];
+        math::BoundingBox m_bounds;
+
+        // index in m_fileNames
+        std::uint32_t m_fileName;
+    };
+
+    template <typename FileInstance>
+    void ReadRecords(utility::BinaryStream& in, std::vector<Record>& records,
+                     std::unordered_map<std::string, std::uint32_t>& names);
+
+    template <typename FileInstance>
+    Record MakeRecord(const FileInstance& instance,
+                      std::unordered_map<std::string, std::uint32_t>& names);
+
+    const Record* Find(const std::vector<Record>& records,
+                       std::uint32_t id) const;
+
+    template <typename Instance>
+    std::shared_ptr<const Instance>
+    Get(const std::vector<Record>& records,
+        std::unordered_map<std::uint32_t, std::weak_ptr<const Instance>>&
+            materialized,
+        std::uint32_t id, Result unknown) const;
+
+    template <typename Instance>
+    std::size_t Count(const std::unordered_map<
+                      std::uint32_t, std::weak_ptr<const Instance>>& materialized)
+        const;
+
+    // sorted by id
+    std::vector<Record> m_wmoRecords;
+    std::vector<Record> m_doodadRecords;
+
+    std::vector<std::string> m_fileNames;
+
+    mutable std::mutex m_mutex;
+
+    mutable std::unordered_map<std::uint32_t, std::weak_ptr<const WmoInstance>>
+        m_wmos;
+    mutable std::unordered_map<std::uint32_t,
+                               std::weak_ptr<const DoodadInstance>>
+        m_doodads;
+};
+} // namespace pathfind
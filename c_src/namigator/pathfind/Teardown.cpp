@@ -0,0 +1,83 @@
+#include "Teardown.hpp"
+
+#include <utility>
+
+namespace pathfind
+{
+Teardown& Teardown::Instance()
+{
+    static Teardown instance;
+    return instance;
+}
+
+Teardown::~Teardown()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_shutdown = true;
+    }
+
+    m_queued.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void Teardown::Defer(std::shared_ptr<void> garbage)
+{
+    if (!garbage)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_garbage.push_back(std::move(garbage));
+
+        if (!m_thread.joinable())
+            m_thread = std::thread(&Teardown::Run, this);
+    }
+
+    m_queued.notify_one();
+}
+
+void Teardown::Wait()
+{
+    std::unique_lock<std::mutex> guard(m_mutex);
+    m_idle.wait(guard, [this]() { return m_garbage.empty() && !m_busy; });
+}
+
+std::size_t Teardown::Pending() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_garbage.size() + (m_busy ? 1 : 0);
+}
+
+void Teardown::Run()
+{
+    std::unique_lock<std::mutex> guard(m_mutex);
+
+    while (true)
+    {
+        m_queued.wait(guard, [this]()
+                      { return m_shutdown || !m_garbage.empty(); });
+
+        // anything still queued at shutdown is destroyed before the thread
+        // exits, rather than leaked
+        if (m_garbage.empty())
+            break;
+
+        auto garbage = std::move(m_garbage.front());
+        m_garbage.pop_front();
+        m_busy = true;
+
+        guard.unlock();
+        garbage.reset();
+        guard.lock();
+
+        m_busy = false;
+
+        if (m_garbage.empty())
+            m_idle.notify_all();
+    }
+}
+} // namespace pathfind
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace pathfind
+{
+// process-wide background thread which frees objects on behalf of callers that
+// must not wait for them, such as an erlang scheduler collecting a map.  a
+// fully loaded continent holds thousands of tiles, height fields and models,
+// and freeing them may take far longer than a scheduler should be blocked.
+// objects are freed one at a time in the order in which they were deferred.
+class Teardown
+{
+public:
+    static Teardown& Instance();
+
+    Teardown(const Teardown&) = delete;
+    Teardown& operator=(const Teardown&) = delete;
+
+    // takes ownership of the object, which is destroyed on the teardown
+    // thread once it is the last owner of it
+    void Defer(std::shared_ptr<void> garbage);
+
+    // blocks until every object deferred so far has been destroyed
+    void Wait();
+
+    // number of objects which are either queued or being destroyed
+    std::size_t Pending() const;
+
+private:
+    Teardown() = default;
+
+    // destroys whatever is still queued before returning
+    ~Teardown();
+
+    void Run();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_queued;
+    std::condition_variable m_idle;
+
+    std::deque<std::shared_ptr<void>> m_garbage;
+    bool m_busy = false;
+    bool m_shutdown = false;
+
+    // the thread is only started once something is deferred
+    std::thread m_thread;
+};
+} // namespace pathfind
@@ -1,4 +1,5 @@
 #include "Map.hpp"
+#include "RecastArena.hpp"
 #include "Tile.hpp"
 #include "recastnavigation/Detour/Include/DetourNavMeshBuilder.h"
 #include "recastnavigation/Recast/Include/Recast.h"
@@ -11,6 +12,8 @@
 #include <cassert>
 #include <cstdint>
 #include <iomanip>
+#include <iostream>
+#include <optional>
 #include <sstream>
 #include <thread>
 
@@ -90,9 +93,6 @@ void InitializeRecastConfig(rcConfig& config)
 
 using SmartHeightFieldPtr =
     std::unique_ptr<rcHeightfield, decltype(&rcFreeHeightField)>;
-using SmartHeightFieldLayerSetPtr =
-    std::unique_ptr<rcHeightfieldLayerSet,
-                    decltype(&rcFreeHeightfieldLayerSet)>;
 using SmartCompactHeightFieldPtr =
     std::unique_ptr<rcCompactHeightfield, decltype(&rcFreeCompactHeightfield)>;
 using SmartContourSetPtr =
@@ -101,24 +101,50 @@ using SmartPolyMeshPtr = std::unique_ptr<rcPolyMesh, decltype(&rcFreePolyMesh)>;
 using SmartPolyMeshDetailPtr =
     std::unique_ptr<rcPolyMeshDetail, decltype(&rcFreePolyMeshDetail)>;
 
-bool RebuildMeshTile(rcContext& ctx, const rcConfig& config, int tileX,
-                     int tileY, rcHeightfield& solid,
-                     std::vector<unsigned char>& out)
+bool BuildRegions(rcContext& ctx, const rcConfig& config,
+                  pathfind::RegionPartition partition,
+                  rcCompactHeightfield& chf)
+{
+    switch (partition)
+    {
+        case pathfind::RegionPartition::Monotone:
+            return rcBuildRegionsMonotone(&ctx, chf, config.borderSize,
+                                          config.minRegionArea,
+                                          config.mergeRegionArea);
+        case pathfind::RegionPartition::Layers:
+            return rcBuildLayerRegions(&ctx, chf, config.borderSize,
+                                       config.minRegionArea);
+        case pathfind::RegionPartition::Watershed:
+        default:
+            return rcBuildDistanceField(&ctx, chf) &&
+                   rcBuildRegions(&ctx, chf, config.borderSize,
+                                  config.minRegionArea,
+                                  config.mergeRegionArea);
+    }
+}
+
+SmartCompactHeightFieldPtr BuildCompact(rcContext& ctx, const rcConfig& config,
+                                        rcHeightfield& solid)
 {
-    // initialize compact height field
     SmartCompactHeightFieldPtr chf(rcAllocCompactHeightfield(),
                                    rcFreeCompactHeightfield);
 
     if (!rcBuildCompactHeightfield(&ctx, config.walkableHeight,
                                    (std::numeric_limits<int>::max)(), solid,
                                    *chf))
-        return false;
+        chf.reset();
 
-    if (!rcBuildDistanceField(&ctx, *chf))
-        return false;
+    return chf;
+}
 
-    if (!rcBuildRegions(&ctx, *chf, config.borderSize, config.minRegionArea,
-                        config.mergeRegionArea))
+// builds the mesh of a tile from its compact height field, which has had any
+// obstacle shapes stamped onto it
+bool RebuildMeshTile(rcContext& ctx, const rcConfig& config,
+                     pathfind::RegionPartition partition, int tileX,
+                     int tileY, SmartCompactHeightFieldPtr chf,
+                     std::vector<unsigned char>& out)
+{
+    if (!BuildRegions(ctx, config, partition, *chf))
         return false;
 
     SmartContourSetPtr cset(rcAllocContourSet(), rcFreeContourSet);
@@ -206,38 +232,254 @@ bool RebuildMeshTile(rcContext& ctx, const rcConfig& config, int tileX,
 
     return true;
 }
+
+// working buffers for rebuilding a tile which are kept between rebuilds on
+// the same thread, to go along with the recast arena
+struct RebuildScratch
+{
+    std::vector<rcSpan> m_spans;
+    std::vector<float> m_recastVertices;
+    std::vector<int> m_indices;
+    std::vector<unsigned char> m_areas;
+    std::vector<std::pair<rcSpan*, unsigned int>> m_groundSpanAreas;
+};
+
+// rasterizes the doodad into the height field and builds a new mesh for the
+// tile.  this runs on a rebuild thread.  rebuilds of the same tile are never
+// run concurrently, so this is the only thread touching the height field
+bool RebuildTileWithDoodad(pathfind::TileHeightField& tileHeightField,
+                           int tileX, int tileY,
+                           const pathfind::DoodadInstance& doodad,
+                           const pathfind::DoodadModel& model,
+                           pathfind::RegionPartition partition,
+                           std::vector<unsigned char>& out)
+{
+    thread_local RebuildScratch scratch;
+
+    // everything recast allocates during the rebuild, including the expanded
+    // height field, is discarded once the mesh is built, so it is all drawn
+    // from this thread's arena.  this must outlive the height field below.
+    pathfind::RecastArena::Scope arena(pathfind::RecastArena::ThreadLocal());
+
+    if (!tileHeightField.IsLoaded())
+        tileHeightField.Load();
+
+    rcHeightfield heightField;
+    tileHeightField.Expand(heightField, scratch.m_spans);
+
+    auto& recastVertices = scratch.m_recastVertices;
+    math::Convert::VerticesToRecast(doodad.m_translatedVertices->m_vertices,
+                                    recastVertices);
+
+    auto const& indices = model.m_aabbTree.Indices(scratch.m_indices);
+
+    auto& areas = scratch.m_areas;
+    areas.assign(indices.size(), 0);
+
+    RecastContext ctx(rcLogCategory::RC_LOG_ERROR);
+    rcClearUnwalkableTriangles(
+        &ctx, MeshSettings::WalkableSlope, &recastVertices[0],
+        static_cast<int>(recastVertices.size() / 3), &indices[0],
+        static_cast<int>(indices.size() / 3), &areas[0]);
+    rcRasterizeTriangles(
+        &ctx, &recastVertices[0], static_cast<int>(recastVertices.size() / 3),
+        &indices[0], &areas[0], static_cast<int>(indices.size() / 3),
+        heightField);
+
+    // we don't want to filter ledge spans from ADT terrain.  this will restore
+    // the area for these spans, which we are using for flags
+    {
+        auto& groundSpanAreas = scratch.m_groundSpanAreas;
+
+        groundSpanAreas.clear();
+        groundSpanAreas.reserve(heightField.width * heightField.height);
+
+        for (auto i = 0; i < heightField.width * heightField.height; ++i)
+            for (rcSpan* s = heightField.spans[i]; s; s = s->next)
+                if (!!(s->area & PolyFlags::Ground))
+                    groundSpanAreas.push_back(std::pair<rcSpan*, unsigned int>(
+                        s, static_cast<unsigned int>(s->area)));
+
+        rcFilterLedgeSpans(&ctx, MeshSettings::VoxelWalkableHeight,
+                           MeshSettings::VoxelWalkableClimb, heightField);
+
+        for (auto p : groundSpanAreas)
+            p.first->area = p.second;
+    }
+
+    rcFilterWalkableLowHeightSpans(&ctx, MeshSettings::VoxelWalkableHeight,
+                                   heightField);
+    rcFilterLowHangingWalkableObstacles(&ctx, MeshSettings::VoxelWalkableClimb,
+                                        heightField);
+
+    // keep the obstacle for future rebuilds of this tile
+    tileHeightField.Store(heightField);
+
+    rcConfig config;
+
+    InitializeRecastConfig(config);
+
+    auto chf = BuildCompact(ctx, config, heightField);
+
+    if (!chf)
+        return false;
+
+    for (auto const& shape : tileHeightField.m_shapes)
+        shape.second.Stamp(ctx, *chf);
+
+    // build the mesh into a secondary buffer, rather than overwriting the
+    // previous tile, so that the old tile remains in use until the swap
+    return RebuildMeshTile(ctx, config, partition, tileX, tileY,
+                           std::move(chf), out);
+}
+
+// rebuilds the whole tile with its obstacle shapes.  the packed spans already
+// hold any game objects and have been filtered, so they are only expanded and
+// compacted before every shape of the tile is stamped onto them.  like
+// RebuildTileWithDoodad, this runs on a rebuild thread
+bool RebuildTileWithShapes(pathfind::TileHeightField& tileHeightField,
+                           int tileX, int tileY,
+                           pathfind::RegionPartition partition,
+                           std::vector<unsigned char>& out)
+{
+    thread_local RebuildScratch scratch;
+
+    pathfind::RecastArena::Scope arena(pathfind::RecastArena::ThreadLocal());
+
+    if (!tileHeightField.IsLoaded())
+        tileHeightField.Load();
+
+    rcHeightfield heightField;
+    tileHeightField.Expand(heightField, scratch.m_spans);
+
+    RecastContext ctx(rcLogCategory::RC_LOG_ERROR);
+    rcConfig config;
+
+    InitializeRecastConfig(config);
+
+    auto chf = BuildCompact(ctx, config, heightField);
+
+    if (!chf)
+        return false;
+
+    for (auto const& shape : tileHeightField.m_shapes)
+        shape.second.Stamp(ctx, *chf);
+
+    return RebuildMeshTile(ctx, config, partition, tileX, tileY,
+                           std::move(chf), out);
+}
 } // namespace
 
 namespace pathfind
 {
+math::BoundingBox ObstacleShape::Bounds() const
+{
+    switch (m_type)
+    {
+        case Type::Box:
+            return {math::takeMinimum(m_min, m_max),
+                    math::takeMaximum(m_min, m_max)};
+        case Type::Convex:
+        {
+            math::BoundingBox bounds {m_position, m_position};
+
+            for (auto const& corner : m_footprint)
+                bounds.update({corner.X, corner.Y, m_position.Z});
+
+            bounds.MaxCorner.Z = m_position.Z + m_height;
+            return bounds;
+        }
+        case Type::Cylinder:
+        default:
+            return {{m_position.X - m_radius, m_position.Y - m_radius,
+                     m_position.Z},
+                    {m_position.X + m_radius, m_position.Y + m_radius,
+                     m_position.Z + m_height}};
+    }
+}
+
+void ObstacleShape::Stamp(rcContext& ctx, rcCompactHeightfield& chf) const
+{
+    // a shape resting on the ground may start a little above the floor of the
+    // spans it covers, so it reaches down by as much as an agent may climb
+    constexpr float reach = MeshSettings::WalkableClimb;
+
+    switch (m_type)
+    {
+        case Type::Box:
+        {
+            float a[3], b[3];
+            math::Convert::VertexToRecast(m_min, a);
+            math::Convert::VertexToRecast(m_max, b);
+
+            const float bmin[] = {(std::min)(a[0], b[0]),
+                                  (std::min)(a[1], b[1]) - reach,
+                                  (std::min)(a[2], b[2])};
+            const float bmax[] = {(std::max)(a[0], b[0]),
+                                  (std::max)(a[1], b[1]),
+                                  (std::max)(a[2], b[2])};
+
+            rcMarkBoxArea(&ctx, bmin, bmax, RC_NULL_AREA, chf);
+            break;
+        }
+        case Type::Convex:
+        {
+            std::vector<float> verts;
+            math::Convert::VerticesToRecast(m_footprint, verts);
+
+            rcMarkConvexPolyArea(&ctx, &verts[0],
+                                 static_cast<int>(m_footprint.size()),
+                                 m_position.Z - reach, m_position.Z + m_height,
+                                 RC_NULL_AREA, chf);
+            break;
+        }
+        case Type::Cylinder:
+        default:
+        {
+            float base[3];
+            math::Convert::VertexToRecast(m_position, base);
+            base[1] -= reach;
+
+            rcMarkCylinderArea(&ctx, base, m_radius, m_height + reach,
+                               RC_NULL_AREA, chf);
+            break;
+        }
+    }
+}
+
 void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
                         const math::Vector3& position, float orientation,
-                        int doodadSet)
+                        int doodadSet, GameObjectCallback callback)
 {
     auto const matrix = math::Matrix::CreateRotationZ(orientation);
-    AddGameObject(guid, displayId, position, matrix, doodadSet);
+    AddGameObject(guid, displayId, position, matrix, doodadSet,
+                  std::move(callback));
 }
 
 void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
                         const math::Vector3& position,
-                        const math::Quaternion& rotation, int doodadSet)
+                        const math::Quaternion& rotation, int doodadSet,
+                        GameObjectCallback callback)
 {
     auto const matrix = math::Matrix::CreateFromQuaternion(rotation);
-    AddGameObject(guid, displayId, position, matrix, doodadSet);
+    AddGameObject(guid, displayId, position, matrix, doodadSet,
+                  std::move(callback));
 }
 
 void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
                         const math::Vector3& position,
-                        const math::Matrix& rotation, int /*doodadSet*/)
+                        const math::Matrix& rotation, int /*doodadSet*/,
+                        GameObjectCallback callback)
 {
-    if (m_temporaryDoodads.find(guid) != m_temporaryDoodads.end() ||
-        m_temporaryWmos.find(guid) != m_temporaryWmos.end())
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
+    if (GameObjectExists(guid))
         THROW(Result::GAMEOBJECT_WITH_SPECIFIED_GUID_ALREADY_EXISTS);
 
     auto const matrix =
         math::Matrix::CreateTranslationMatrix(position) * rotation;
 
-    auto const bvh_path = m_bvhLoader.GetBVHPath(displayId);
+    auto const bvh_path = m_bvhLoader->GetBVHPath(displayId);
     // TODO: Add logic based on bvh_path
     auto const doodad = true;
     // auto const doodad = m_temporaryObstaclePaths[displayId][0] == 'd' ||
@@ -253,30 +495,33 @@ void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
         auto model = EnsureDoodadModelLoaded(bvh_path);
         instance->m_model = model;
 
-        instance->m_translatedVertices.reserve(
-            model->m_aabbTree.Vertices().size());
+        instance->m_translatedVertices =
+            GetTranslatedVertices(bvh_path, *model, matrix);
+        instance->m_bounds = instance->m_translatedVertices->m_bounds;
+        m_temporaryDoodads[guid] = instance;
 
-        for (auto const& v : model->m_aabbTree.Vertices())
-            instance->m_translatedVertices.emplace_back(
-                math::Vector3::Transform(v, matrix));
+        std::vector<Tile*> tiles;
+        GetOverlappingTiles(instance->m_bounds, tiles);
 
-        // models are guarunteed to have more than zero vertices
-        math::BoundingBox bounds {instance->m_translatedVertices[0],
-                                  instance->m_translatedVertices[0]};
+        // nothing to rebuild.  game objects are held only by the tiles they
+        // overlap, so this one is dropped, and is not applied to any of those
+        // tiles which are loaded later
+        if (tiles.empty())
+        {
+            m_temporaryDoodads.erase(guid);
+            guard.unlock();
 
-        for (auto i = 1u; i < instance->m_translatedVertices.size(); ++i)
-            bounds.update(instance->m_translatedVertices[i]);
+            if (callback)
+                callback(guid, true);
 
-        instance->m_bounds = bounds;
-        m_temporaryDoodads[guid] = instance;
+            return;
+        }
 
-        for (auto const& tile : m_tiles)
-        {
-            if (!tile.second->m_bounds.intersect2d(instance->m_bounds))
-                continue;
+        auto pending = std::make_shared<PendingGameObject>(
+            guid, static_cast<int>(tiles.size()), std::move(callback));
 
-            tile.second->AddTemporaryDoodad(guid, instance);
-        }
+        for (auto const tile : tiles)
+            tile->AddTemporaryDoodad(guid, instance, pending);
     }
     else
     {
@@ -297,82 +542,336 @@ void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
     }
 }
 
-void Tile::AddTemporaryDoodad(std::uint64_t guid,
-                              std::shared_ptr<DoodadInstance> doodad)
+void Map::AddObstacle(std::uint64_t guid, const ObstacleShape& shape,
+                      GameObjectCallback callback)
 {
-    if (!m_heightField.spans)
-        LoadHeightField();
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
 
-    auto const model = doodad->m_model.lock();
+    if (GameObjectExists(guid) ||
+        m_obstacleShapes.find(guid) != m_obstacleShapes.end())
+        THROW(Result::GAMEOBJECT_WITH_SPECIFIED_GUID_ALREADY_EXISTS);
 
-    std::vector<float> recastVertices;
-    math::Convert::VerticesToRecast(doodad->m_translatedVertices,
-                                    recastVertices);
+    m_obstacleShapes[guid] = shape;
 
-    std::vector<unsigned char> areas(model->m_aabbTree.Indices().size());
+    std::vector<Tile*> tiles;
+    GetOverlappingTiles(shape.Bounds(), tiles);
 
-    m_temporaryDoodads[guid] = std::move(doodad);
+    if (tiles.empty())
+    {
+        guard.unlock();
 
-    RecastContext ctx(rcLogCategory::RC_LOG_ERROR);
-    rcClearUnwalkableTriangles(
-        &ctx, MeshSettings::WalkableSlope, &recastVertices[0],
-        static_cast<int>(recastVertices.size() / 3),
-        &model->m_aabbTree.Indices()[0],
-        static_cast<int>(model->m_aabbTree.Indices().size() / 3), &areas[0]);
-    rcRasterizeTriangles(
-        &ctx, &recastVertices[0], static_cast<int>(recastVertices.size() / 3),
-        &model->m_aabbTree.Indices()[0], &areas[0],
-        static_cast<int>(model->m_aabbTree.Indices().size() / 3),
-        m_heightField);
+        if (callback)
+            callback(guid, true);
 
-    // we don't want to filter ledge spans from ADT terrain.  this will restore
-    // the area for these spans, which we are using for flags
+        return;
+    }
+
+    auto pending = std::make_shared<PendingGameObject>(
+        guid, static_cast<int>(tiles.size()), std::move(callback));
+
+    for (auto const tile : tiles)
+        tile->UpdateObstacleShape(guid, &shape, pending);
+}
+
+bool Map::RemoveObstacle(std::uint64_t guid, GameObjectCallback callback)
+{
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const shape = m_obstacleShapes.find(guid);
+
+    if (shape == m_obstacleShapes.end())
+        return false;
+
+    std::vector<Tile*> tiles;
+    GetOverlappingTiles(shape->second.Bounds(), tiles);
+
+    m_obstacleShapes.erase(shape);
+
+    if (tiles.empty())
     {
-        std::vector<std::pair<rcSpan*, unsigned int>> groundSpanAreas;
+        guard.unlock();
 
-        groundSpanAreas.reserve(m_heightField.width * m_heightField.height);
+        if (callback)
+            callback(guid, true);
 
-        for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
-            for (rcSpan* s = m_heightField.spans[i]; s; s = s->next)
-                if (!!(s->area & PolyFlags::Ground))
-                    groundSpanAreas.push_back(std::pair<rcSpan*, unsigned int>(
-                        s, static_cast<unsigned int>(s->area)));
+        return true;
+    }
 
-        rcFilterLedgeSpans(&ctx, MeshSettings::VoxelWalkableHeight,
-                           MeshSettings::VoxelWalkableClimb, m_heightField);
+    auto pending = std::make_shared<PendingGameObject>(
+        guid, static_cast<int>(tiles.size()), std::move(callback));
 
-        for (auto p : groundSpanAreas)
-            p.first->area = p.second;
+    for (auto const tile : tiles)
+        tile->UpdateObstacleShape(guid, nullptr, pending);
+
+    return true;
+}
+
+bool Map::GameObjectExists(std::uint64_t guid)
+{
+    // entries expire once every tile holding the game object is unloaded, and
+    // its guid may then be used again
+    auto const doodad = m_temporaryDoodads.find(guid);
+
+    if (doodad != m_temporaryDoodads.end())
+    {
+        if (!doodad->second.expired())
+            return true;
+
+        m_temporaryDoodads.erase(doodad);
     }
 
-    rcFilterWalkableLowHeightSpans(&ctx, MeshSettings::VoxelWalkableHeight,
-                                   m_heightField);
-    rcFilterLowHangingWalkableObstacles(&ctx, MeshSettings::VoxelWalkableClimb,
-                                        m_heightField);
+    auto const wmo = m_temporaryWmos.find(guid);
 
-    rcConfig config;
+    if (wmo != m_temporaryWmos.end())
+    {
+        if (!wmo->second.expired())
+            return true;
 
-    InitializeRecastConfig(config);
+        m_temporaryWmos.erase(wmo);
+    }
 
-    // build the mesh into a secondary buffer, rather than overwriting the
-    // previous tile, so that we can delay the old tile's removal
-    std::vector<std::uint8_t> newTileData;
-    auto const buildResult =
-        RebuildMeshTile(ctx, config, m_x, m_y, m_heightField, newTileData);
-    assert(buildResult);
+    return false;
+}
 
-    if (m_ref)
+void Map::GetOverlappingTiles(const math::BoundingBox& bounds,
+                              std::vector<Tile*>& tiles) const
+{
+    // a tile's bounds include the border of its height field, which the
+    // obstacle may overlap without entering the tile itself
+    constexpr float border =
+        (MeshSettings::VoxelWalkableRadius + 3) * MeshSettings::CellSize;
+
+    // tile coordinates increase as world coordinates decrease
+    int minTileX, minTileY, maxTileX, maxTileY;
+    GetTileCoordinates(bounds.MaxCorner.X + border,
+                       bounds.MaxCorner.Y + border, minTileX, minTileY);
+    GetTileCoordinates(bounds.MinCorner.X - border,
+                       bounds.MinCorner.Y - border, maxTileX, maxTileY);
+
+    tiles.clear();
+
+    for (auto tileY = minTileY; tileY <= maxTileY; ++tileY)
+        for (auto tileX = minTileX; tileX <= maxTileX; ++tileX)
+        {
+            auto const tile = m_tiles.find({tileX, tileY});
+
+            if (tile == m_tiles.end() ||
+                !tile->second->m_bounds.intersect2d(bounds))
+                continue;
+
+            tiles.push_back(tile->second.get());
+        }
+}
+
+std::shared_ptr<const TranslatedVertices>
+Map::GetTranslatedVertices(const std::string& modelFilename,
+                           const DoodadModel& model,
+                           const math::Matrix& transform)
+{
+    float matrix[16];
+    transform.PopulateArray(matrix);
+
+    auto key = modelFilename;
+    key.append(reinterpret_cast<const char*>(matrix), sizeof(matrix));
+
+    auto& cached = m_translatedVertexCache[key];
+
+    if (auto existing = cached.lock())
+        return existing;
+
+    auto result = std::make_shared<TranslatedVertices>();
+    auto const& vertices = model.m_aabbTree.Vertices();
+
+    result->m_vertices.reserve(vertices.size());
+
+    for (auto const& v : vertices)
+        result->m_vertices.emplace_back(math::Vector3::Transform(v, transform));
+
+    // models are guarunteed to have more than zero vertices
+    result->m_bounds = {result->m_vertices[0], result->m_vertices[0]};
+
+    for (auto i = 1u; i < result->m_vertices.size(); ++i)
+        result->m_bounds.update(result->m_vertices[i]);
+
+    cached = result;
+
+    // drop entries for game objects which no longer exist once enough have
+    // accumulated, so that the cost is amortized over insertions
+    if (m_translatedVertexCache.size() >= m_translatedVertexSweepSize)
     {
-        auto const removeResult =
-            m_map->m_navMesh.removeTile(m_ref, nullptr, nullptr);
-        assert(removeResult == DT_SUCCESS);
+        for (auto i = m_translatedVertexCache.begin();
+             i != m_translatedVertexCache.end();)
+        {
+            if (i->second.expired())
+                i = m_translatedVertexCache.erase(i);
+            else
+                ++i;
+        }
+
+        m_translatedVertexSweepSize =
+            (std::max)(m_translatedVertexSweepSize,
+                       2 * m_translatedVertexCache.size());
     }
 
-    m_tileData = std::move(newTileData);
+    return result;
+}
+
+void Map::WaitForRebuilds()
+{
+    m_rebuilder.Wait();
+}
 
-    auto const insertResult = m_map->m_navMesh.addTile(
-        &m_tileData[0], static_cast<int>(m_tileData.size()), 0, m_ref, &m_ref);
+std::size_t Map::PendingRebuilds() const
+{
+    return m_rebuilder.Pending();
+}
 
-    assert(insertResult == DT_SUCCESS);
+void Map::SetRebuildPartition(RegionPartition partition)
+{
+    m_rebuildPartition = partition;
+}
+
+RegionPartition Map::GetRebuildPartition() const
+{
+    return m_rebuildPartition;
+}
+
+void Map::SwapTileMesh(int x, int y,
+                       const std::shared_ptr<TileHeightField>& heightField,
+                       std::uint64_t guid,
+                       const std::shared_ptr<DoodadInstance>& doodad,
+                       std::vector<std::uint8_t>&& tileData)
+{
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+
+    auto const tile = m_tiles.find({x, y});
+
+    // if the tile was unloaded (and possibly reloaded) while the rebuild was in
+    // progress, the result no longer applies to it
+    if (tile == m_tiles.end() || tile->second->m_heightField != heightField)
+        return;
+
+    tile->second->ReplaceMesh(std::move(tileData));
+
+    if (doodad)
+        tile->second->m_temporaryDoodads[guid] = doodad;
+}
+
+void Tile::AddTemporaryDoodad(std::uint64_t guid,
+                              std::shared_ptr<DoodadInstance> doodad,
+                              std::shared_ptr<PendingGameObject> pending)
+{
+    auto model = doodad->m_model.lock();
+    assert(!!model);
+
+    // rebuilds are keyed by height field, so that those of different tiles run
+    // in parallel while those of this tile are applied one after another
+    m_map->m_rebuilder.Enqueue(
+        m_heightField.get(),
+        [map = m_map, heightField = m_heightField, x = m_x, y = m_y, guid,
+         doodad = std::move(doodad), model = std::move(model),
+         partition = m_map->GetRebuildPartition(),
+         pending = std::move(pending)]()
+        {
+            std::vector<std::uint8_t> tileData;
+            bool success;
+
+            try
+            {
+                success = RebuildTileWithDoodad(*heightField, x, y, *doodad,
+                                                *model, partition, tileData);
+
+                if (success)
+                    map->SwapTileMesh(x, y, heightField, guid, doodad,
+                                      std::move(tileData));
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Tile (" << x << ", " << y
+                          << ") rebuild failed: " << e.what() << std::endl;
+                success = false;
+            }
+
+            pending->Complete(success);
+        });
+}
+
+void Tile::UpdateObstacleShape(std::uint64_t guid, const ObstacleShape* shape,
+                               std::shared_ptr<PendingGameObject> pending)
+{
+    std::optional<ObstacleShape> added;
+
+    if (shape)
+        added = *shape;
+
+    // queued under the same key as doodad rebuilds, so that shapes and
+    // doodads are applied to the tile in the order they were added
+    m_map->m_rebuilder.Enqueue(
+        m_heightField.get(),
+        [map = m_map, heightField = m_heightField, x = m_x, y = m_y, guid,
+         added = std::move(added), partition = m_map->GetRebuildPartition(),
+         pending = std::move(pending)]()
+        {
+            std::vector<std::uint8_t> tileData;
+            bool success;
+
+            try
+            {
+                // a shape removed from a tile which was reloaded since it was
+                // added is not part of the tile's mesh
+                if (added)
+                    heightField->m_shapes[guid] = *added;
+                else if (!heightField->m_shapes.erase(guid))
+                {
+                    pending->Complete(true);
+                    return;
+                }
+
+                success = RebuildTileWithShapes(*heightField, x, y, partition,
+                                                tileData);
+
+                if (success)
+                    map->SwapTileMesh(x, y, heightField, guid, nullptr,
+                                      std::move(tileData));
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Tile (" << x << ", " << y
+                          << ") rebuild failed: " << e.what() << std::endl;
+                success = false;
+            }
+
+            pending->Complete(success);
+        });
+}
+
+void Tile::RestoreObstacleShapes(
+    std::unordered_map<std::uint64_t, ObstacleShape>&& shapes)
+{
+    m_map->m_rebuilder.Enqueue(
+        m_heightField.get(),
+        [map = m_map, heightField = m_heightField, x = m_x, y = m_y,
+         shapes = std::move(shapes),
+         partition = m_map->GetRebuildPartition()]()
+        {
+            try
+            {
+                // shapes added or removed since the tile was loaded are queued
+                // after this, and are applied over it
+                heightField->m_shapes.insert(shapes.begin(), shapes.end());
+
+                std::vector<std::uint8_t> tileData;
+
+                if (RebuildTileWithShapes(*heightField, x, y, partition,
+                                          tileData))
+                    map->SwapTileMesh(x, y, heightField, 0, nullptr,
+                                      std::move(tileData));
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Tile (" << x << ", " << y
+                          << ") rebuild failed: " << e.what() << std::endl;
+            }
+        });
 }
 } // namespace pathfind
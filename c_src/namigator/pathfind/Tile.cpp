@@ -11,14 +11,32 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <new>
 #include <vector>
 
 namespace pathfind
 {
-Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
+namespace
+{
+// moves the stream past the columns of a serialized height field
+void SkipSpans(utility::BinaryStream& in, int columns)
+{
+    for (auto i = 0; i < columns; ++i)
+    {
+        std::uint32_t columnSize;
+        in >> columnSize;
+
+        in.rpos(in.rpos() + 3 * columnSize * sizeof(std::uint32_t));
+    }
+}
+} // namespace
+
+Tile::Tile(Map* map, utility::BinaryStream& in, const NavFile& navFile,
            bool load_heightfield)
-    : m_map(map), m_navPath(navPath), m_ref(0), m_x(in.Read<std::uint32_t>()),
-      m_y(in.Read<std::uint32_t>()), m_areaId(0)
+    : m_map(map), m_heightField(std::make_shared<TileHeightField>(navFile)),
+      m_ref(0), m_x(in.Read<std::uint32_t>()), m_y(in.Read<std::uint32_t>()),
+      m_areaId(0)
 {
     std::uint32_t wmoCount;
     in >> wmoCount;
@@ -30,8 +48,12 @@ Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
                      m_staticWmos.size() * sizeof(std::uint32_t));
 
         for (auto const wmo : m_staticWmos)
+        {
+            auto instance = map->m_staticInstances->GetWmo(wmo);
             m_staticWmoModels.push_back(
-                map->LoadModelForWmoInstance(wmo));
+                map->EnsureWmoModelLoaded(instance->m_modelFilename));
+            m_staticWmoInstances.push_back(std::move(instance));
+        }
     }
 
     // for global WMOs, doodads are not referenced or loaded on a per-tile
@@ -46,8 +68,12 @@ Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
                      m_staticDoodads.size() * sizeof(std::uint32_t));
 
         for (auto const doodad : m_staticDoodads)
+        {
+            auto instance = map->m_staticInstances->GetDoodad(doodad);
             m_staticDoodadModels.push_back(
-                map->LoadModelForDoodadInstance(doodad));
+                map->EnsureDoodadModelLoaded(instance->m_modelFilename));
+            m_staticDoodadInstances.push_back(std::move(instance));
+        }
     }
 
     std::uint8_t quadHeight;
@@ -68,16 +94,17 @@ Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
     }
 
     // read height field
-    in >> m_heightField.width >> m_heightField.height >> m_heightField.bmin >>
-        m_heightField.bmax >> m_heightField.cs >> m_heightField.ch;
+    auto& heightField = *m_heightField;
+    in >> heightField.m_width >> heightField.m_height >> heightField.m_bmin >>
+        heightField.m_bmax >> heightField.m_cs >> heightField.m_ch;
 
     // for now, width and height must always be equal.  this check is here as a
     // way to make sure we are reading the file correctly so far
-    assert(m_heightField.width == m_heightField.height);
+    assert(heightField.m_width == heightField.m_height);
 
     math::Vector3 a, b;
-    math::Convert::VertexToWow(m_heightField.bmin, a);
-    math::Convert::VertexToWow(m_heightField.bmax, b);
+    math::Convert::VertexToWow(heightField.m_bmin, a);
+    math::Convert::VertexToWow(heightField.m_bmax, b);
 
     m_bounds.MinCorner.X = (std::min)(a.X, b.X);
     m_bounds.MaxCorner.X = (std::max)(a.X, b.X);
@@ -86,22 +113,12 @@ Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
     m_bounds.MinCorner.Z = (std::min)(a.Z, b.Z);
     m_bounds.MaxCorner.Z = (std::max)(a.Z, b.Z);
 
-    m_heightFieldSpanStart = in.rpos();
+    m_heightField->m_spanStart = in.rpos();
 
     if (load_heightfield)
-        LoadHeightField(in);
+        m_heightField->Load(in);
     else
-    {
-        m_heightField.spans = nullptr;
-
-        for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
-        {
-            std::uint32_t columnSize;
-            in >> columnSize;
-
-            in.rpos(in.rpos() + 3 * columnSize * sizeof(std::uint32_t));
-        }
-    }
+        SkipSpans(in, heightField.m_width * heightField.m_height);
 
     // read mesh
     std::uint32_t meshSize;
@@ -115,6 +132,77 @@ Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
         auto const result = m_map->m_navMesh.addTile(
             &m_tileData[0], static_cast<int>(m_tileData.size()), 0, 0, &m_ref);
         assert(result == DT_SUCCESS);
+
+        m_map->TileAdded(m_ref);
+    }
+}
+
+void Tile::Skip(utility::BinaryStream& in)
+{
+    // coordinates
+    in.rpos(in.rpos() + 2 * sizeof(std::uint32_t));
+
+    // static wmo and doodad instances
+    for (auto i = 0; i < 2; ++i)
+    {
+        std::uint32_t instanceCount;
+        in >> instanceCount;
+
+        in.rpos(in.rpos() + instanceCount * sizeof(std::uint32_t));
+    }
+
+    std::uint8_t quadHeight;
+    in >> quadHeight;
+
+    if (quadHeight)
+        in.rpos(in.rpos() + sizeof(m_zoneId) + sizeof(m_areaId) +
+                sizeof(m_quadHoles) +
+                MeshSettings::QuadValuesPerTile * sizeof(float));
+
+    int width, height;
+    in >> width >> height;
+
+    // bounds, cell size and cell height
+    in.rpos(in.rpos() + 8 * sizeof(float));
+
+    SkipSpans(in, width * height);
+
+    std::uint32_t meshSize;
+    in >> meshSize;
+
+    in.rpos(in.rpos() + meshSize);
+}
+
+Tile::Tile(Map* map, const Tile& source)
+    : m_map(map), m_tileData(source.m_tileData),
+      m_heightField(
+          std::make_shared<TileHeightField>(source.m_heightField->m_navFile)),
+      m_ref(0), m_bounds(source.m_bounds), m_x(source.m_x), m_y(source.m_y),
+      m_zoneId(source.m_zoneId), m_areaId(source.m_areaId),
+      m_quadHeights(source.m_quadHeights),
+      m_terrainQuads(source.m_terrainQuads),
+      m_staticWmos(source.m_staticWmos),
+      m_staticDoodads(source.m_staticDoodads),
+      m_staticWmoInstances(source.m_staticWmoInstances),
+      m_staticDoodadInstances(source.m_staticDoodadInstances),
+      m_staticWmoModels(source.m_staticWmoModels),
+      m_staticDoodadModels(source.m_staticDoodadModels)
+{
+    ::memcpy(m_quadHoles, source.m_quadHoles, sizeof(m_quadHoles));
+
+    m_heightField->CopyLayout(*source.m_heightField);
+
+    // detour writes the links between polygons into the tile data, so each
+    // navmesh needs its own copy of it.  the polygon areas were already set
+    // by the source's map.  the tile keeps its reference, so that the islands
+    // and portal graph of the source's map, which are keyed by it, hold for
+    // this one too
+    if (!m_tileData.empty())
+    {
+        auto const result = m_map->m_navMesh.addTile(
+            &m_tileData[0], static_cast<int>(m_tileData.size()), 0,
+            source.m_ref, &m_ref);
+        assert(result == DT_SUCCESS && m_ref == source.m_ref);
     }
 }
 
@@ -125,59 +213,240 @@ Tile::~Tile()
         auto const result =
             m_map->m_navMesh.removeTile(m_ref, nullptr, nullptr);
         assert(result == DT_SUCCESS);
+
+        m_map->TileRemoved(m_ref);
+    }
+}
+
+void Tile::ReplaceMesh(std::vector<std::uint8_t>&& tileData)
+{
+    if (m_ref)
+    {
+        auto const removeResult =
+            m_map->m_navMesh.removeTile(m_ref, nullptr, nullptr);
+        assert(removeResult == DT_SUCCESS);
+
+        m_map->TileRemoved(m_ref);
     }
 
-    if (!!m_heightField.spans)
+    m_tileData = std::move(tileData);
+
+    // it is possible for the rebuilt tile to have no navigable geometry
+    if (m_tileData.empty())
     {
-        for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
-            rcFree(m_heightField.spans[i]);
-        rcFree(m_heightField.spans);
-        m_heightField.spans = nullptr;
+        m_ref = 0;
+        return;
     }
+
+    auto const insertResult = m_map->m_navMesh.addTile(
+        &m_tileData[0], static_cast<int>(m_tileData.size()), 0, m_ref, &m_ref);
+
+    assert(insertResult == DT_SUCCESS);
+
+    m_map->TileAdded(m_ref);
 }
 
-void Tile::LoadHeightField()
+void TileHeightField::CopyLayout(const TileHeightField& other)
 {
-    utility::BinaryStream in(m_navPath);
-    in.rpos(m_heightFieldSpanStart);
-    LoadHeightField(in);
+    m_spanStart = other.m_spanStart;
+    m_width = other.m_width;
+    m_height = other.m_height;
+    ::memcpy(m_bmin, other.m_bmin, sizeof(m_bmin));
+    ::memcpy(m_bmax, other.m_bmax, sizeof(m_bmax));
+    m_cs = other.m_cs;
+    m_ch = other.m_ch;
 }
 
-void Tile::LoadHeightField(utility::BinaryStream& in)
+void TileHeightField::Load()
 {
-    assert(!m_heightField.spans);
+    // the span offset is relative to the decompressed nav file
+    auto in = m_navFile.Read();
+    in.rpos(m_spanStart);
+    Load(in);
+}
+
+namespace
+{
+constexpr std::uint32_t SpanHeightMask = (1u << RC_SPAN_HEIGHT_BITS) - 1;
+constexpr std::uint32_t SpanAreaMask = (1u << 6) - 1;
+
+std::uint32_t PackSpan(std::uint32_t smin, std::uint32_t smax,
+                       std::uint32_t area)
+{
+    return (smin & SpanHeightMask) |
+           ((smax & SpanHeightMask) << RC_SPAN_HEIGHT_BITS) |
+           ((area & SpanAreaMask) << (2 * RC_SPAN_HEIGHT_BITS));
+}
+} // namespace
+
+void TileHeightField::Load(utility::BinaryStream& in)
+{
+    assert(!IsLoaded());
 
-    m_heightField.spans = reinterpret_cast<rcSpan**>(
-        rcAlloc(m_heightField.width * m_heightField.height * sizeof(rcSpan*),
-                RC_ALLOC_PERM));
+    auto const columns = static_cast<size_t>(m_width * m_height);
 
-    for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
+    // count the spans first, so that they can be read into a single
+    // allocation of the exact size
+    auto const start = in.rpos();
+    size_t spanCount = 0;
+
+    for (auto i = 0u; i < columns; ++i)
     {
         std::uint32_t columnSize;
         in >> columnSize;
 
-        if (!columnSize)
-        {
-            m_heightField.spans[i] = nullptr;
-            continue;
-        }
+        in.rpos(in.rpos() + 3 * columnSize * sizeof(std::uint32_t));
+        spanCount += columnSize;
+    }
+
+    in.rpos(start);
+
+    m_spans.reserve(columns + 1 + spanCount);
+    m_spans.resize(columns + 1);
+
+    for (auto i = 0u; i < columns; ++i)
+    {
+        std::uint32_t columnSize;
+        in >> columnSize;
 
-        m_heightField.spans[i] = reinterpret_cast<rcSpan*>(
-            rcAlloc(columnSize * sizeof(rcSpan), RC_ALLOC_PERM));
+        m_spans[i] = static_cast<std::uint32_t>(m_spans.size());
 
         for (auto s = 0u; s < columnSize; ++s)
         {
             std::uint32_t smin, smax, area;
             in >> smin >> smax >> area;
 
-            m_heightField.spans[i][s].smin = smin;
-            m_heightField.spans[i][s].smax = smax;
-            m_heightField.spans[i][s].area = area;
-            m_heightField.spans[i][s].next = nullptr;
+            m_spans.push_back(PackSpan(smin, smax, area));
+        }
+    }
+
+    m_spans[columns] = static_cast<std::uint32_t>(m_spans.size());
+
+    UpdateMemoryUsage();
+}
+
+void TileHeightField::Expand(rcHeightfield& heightField,
+                             std::vector<rcSpan>& storage) const
+{
+    assert(IsLoaded() && !heightField.spans);
+
+    auto const columns = static_cast<size_t>(m_width * m_height);
+
+    heightField.width = m_width;
+    heightField.height = m_height;
+    memcpy(heightField.bmin, m_bmin, sizeof(m_bmin));
+    memcpy(heightField.bmax, m_bmax, sizeof(m_bmax));
+    heightField.cs = m_cs;
+    heightField.ch = m_ch;
+
+    // this is freed by the height field itself
+    heightField.spans = static_cast<rcSpan**>(
+        rcAlloc(columns * sizeof(rcSpan*), RC_ALLOC_PERM));
+
+    if (!heightField.spans)
+        throw std::bad_alloc();
+
+    storage.resize(m_spans.size() - (columns + 1));
 
-            if (s > 0)
-                m_heightField.spans[i][s - 1].next = &m_heightField.spans[i][s];
+    // span i of the packed data is placed at storage[i - first], so that each
+    // column remains contiguous
+    auto const first = columns + 1;
+
+    for (auto i = 0u; i < columns; ++i)
+    {
+        auto const begin = m_spans[i];
+        auto const end = m_spans[i + 1];
+
+        heightField.spans[i] = begin == end ? nullptr : &storage[begin - first];
+
+        for (auto s = begin; s < end; ++s)
+        {
+            auto const packed = m_spans[s];
+            auto& span = storage[s - first];
+
+            span.smin = packed & SpanHeightMask;
+            span.smax = (packed >> RC_SPAN_HEIGHT_BITS) & SpanHeightMask;
+            span.area = packed >> (2 * RC_SPAN_HEIGHT_BITS);
+            span.next = s + 1 < end ? &storage[s + 1 - first] : nullptr;
         }
     }
 }
+
+void TileHeightField::Store(const rcHeightfield& heightField)
+{
+    assert(heightField.width == m_width && heightField.height == m_height);
+
+    auto const columns = static_cast<size_t>(m_width * m_height);
+
+    size_t spanCount = 0;
+    for (auto i = 0u; i < columns; ++i)
+        for (auto s = heightField.spans[i]; s; s = s->next)
+            ++spanCount;
+
+    std::vector<std::uint32_t> spans;
+    spans.reserve(columns + 1 + spanCount);
+    spans.resize(columns + 1);
+
+    for (auto i = 0u; i < columns; ++i)
+    {
+        spans[i] = static_cast<std::uint32_t>(spans.size());
+
+        for (auto s = heightField.spans[i]; s; s = s->next)
+            spans.push_back(PackSpan(s->smin, s->smax, s->area));
+    }
+
+    spans[columns] = static_cast<std::uint32_t>(spans.size());
+
+    m_spans = std::move(spans);
+
+    UpdateMemoryUsage();
+}
+
+void Tile::BuildZoneAreaRaster()
+{
+    constexpr int quadCount = 8 / MeshSettings::TilesPerChunk;
+    constexpr float quadWidth = MeshSettings::AdtChunkSize / 8;
+
+    m_terrainQuads.clear();
+
+    if (m_quadHeights.empty())
+        return;
+
+    m_terrainQuads.resize(quadCount * quadCount);
+
+    float northwestX, northwestY;
+    math::Convert::TileToWorldNorthwestCorner(m_x, m_y, northwestX,
+                                              northwestY);
+
+    for (auto quadX = 0; quadX < quadCount; ++quadX)
+        for (auto quadY = 0; quadY < quadCount; ++quadY)
+        {
+            if (m_quadHoles[quadX][quadY])
+                continue;
+
+            // world bounds of the quad.  quadX runs along -y, quadY along -x
+            auto const maxX = northwestX - quadWidth * quadY;
+            auto const minX = maxX - quadWidth;
+            auto const maxY = northwestY - quadWidth * quadX;
+            auto const minY = maxY - quadWidth;
+
+            auto terrain = true;
+
+            for (auto const& instance : m_staticWmoInstances)
+            {
+                auto const& bounds = instance->m_bounds;
+
+                if (bounds.getMinimum().X <= maxX &&
+                    bounds.getMaximum().X >= minX &&
+                    bounds.getMinimum().Y <= maxY &&
+                    bounds.getMaximum().Y >= minY)
+                {
+                    terrain = false;
+                    break;
+                }
+            }
+
+            m_terrainQuads[quadX * quadCount + quadY] = terrain;
+        }
+}
 } // namespace pathfind
@@ -2,12 +2,15 @@
 
 #include "Common.hpp"
 #include "Model.hpp"
+#include "NavArchive.hpp"
+#include "ObstacleShape.hpp"
 #include "recastnavigation/Detour/Include/DetourNavMesh.h"
 #include "recastnavigation/Recast/Include/Recast.h"
 #include "utility/BinaryStream.hpp"
 #include "utility/BoundingBox.hpp"
 #include "utility/Ray.hpp"
 
+#include <atomic>
 #include <cstdint>
 #include <filesystem>
 #include <memory>
@@ -19,31 +22,122 @@ namespace fs = std::filesystem;
 namespace pathfind
 {
 class Map;
+struct PendingGameObject;
+
+// the height field of a tile, along with what is needed to load it on demand.
+// this is shared between a tile and any rebuilds of it which are in progress,
+// so that the tile may be unloaded while its mesh is being rebuilt.
+//
+// the spans are kept packed, rather than as a recast height field, because
+// they are only needed while the tile is being rebuilt.  a recast height
+// field is expanded from them for the duration of each rebuild.
+struct TileHeightField
+{
+    TileHeightField(const NavFile& navFile) : m_navFile(navFile) {}
+
+    TileHeightField(const TileHeightField&) = delete;
+    TileHeightField& operator=(const TileHeightField&) = delete;
+
+    const NavFile m_navFile;
+
+    // store this for possible delayed load of the data
+    size_t m_spanStart = 0;
+
+    int m_width = 0;
+    int m_height = 0;
+    float m_bmin[3] = {};
+    float m_bmax[3] = {};
+    float m_cs = 0.f;
+    float m_ch = 0.f;
+
+    // every span of the height field, in a single allocation.  the first
+    // width * height + 1 entries are the index of the first span of each
+    // column (and one past the last span of the last column).  they are
+    // followed by the spans of each column from the bottom up, packed as
+    // smin | smax << 13 | area << 26.
+    std::vector<std::uint32_t> m_spans;
+
+    bool IsLoaded() const { return !m_spans.empty(); }
+
+    void Load(utility::BinaryStream& in);
+    void Load();
+
+    // copies where the spans are to be loaded from, and the dimensions of the
+    // height field, but not the spans themselves
+    void CopyLayout(const TileHeightField& other);
+
+    // builds a recast height field from the packed spans.  the spans
+    // themselves are placed in the given storage, which must outlive the
+    // height field and may not be resized while it is in use.
+    void Expand(rcHeightfield& heightField, std::vector<rcSpan>& storage) const;
+
+    // replaces the packed spans with those of the given height field
+    void Store(const rcHeightfield& heightField);
+
+    // obstacle shapes stamped onto this tile, by guid.  like the spans, these
+    // are only touched by rebuilds of the tile
+    std::unordered_map<std::uint64_t, ObstacleShape> m_shapes;
+
+    // bytes used by the packed spans, or zero if they are not loaded.  this
+    // may be read while the tile is being rebuilt on another thread
+    std::size_t MemoryUsage() const { return m_memoryUsage; }
+
+private:
+    void UpdateMemoryUsage()
+    {
+        m_memoryUsage = m_spans.capacity() * sizeof(std::uint32_t);
+    }
+
+    std::atomic<std::size_t> m_memoryUsage {0};
+};
 
 class Tile
 {
 private:
     Map* const m_map;
-    const fs::path m_navPath;
 
     std::vector<std::uint8_t> m_tileData;
 
-    // store this for possible delayed load of the data
-    size_t m_heightFieldSpanStart;
-    rcHeightfield m_heightField;
+    std::shared_ptr<TileHeightField> m_heightField;
+
+    // replace the current mesh of this tile with the given data.  the caller
+    // must hold an exclusive lock on the map
+    void ReplaceMesh(std::vector<std::uint8_t>&& tileData);
 
-    void LoadHeightField(utility::BinaryStream& in);
-    void LoadHeightField();
+    friend class Map;
 
 public:
     // the height field should only be loaded for tiles that will have temporary
     // obstacles inserted frequently
-    Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
+    Tile(Map* map, utility::BinaryStream& in, const NavFile& navFile,
          bool load_heightfield = false);
+
+    // a copy of source, which belongs to another map, added to the navmesh of
+    // the given one under the same tile reference.  its models are shared,
+    // and its height field is left to be loaded when an obstacle is first
+    // added to it.  the islands and portal graph of the map are not updated,
+    // as the map copies them from the source's map once all tiles are added
+    Tile(Map* map, const Tile& source);
     ~Tile();
 
+    // moves the stream past a tile without loading it
+    static void Skip(utility::BinaryStream& in);
+
+    // queues a rebuild of this tile which includes the given doodad.  the
+    // current mesh remains in use until the rebuild completes
     void AddTemporaryDoodad(std::uint64_t guid,
-                            std::shared_ptr<DoodadInstance> doodad);
+                            std::shared_ptr<DoodadInstance> doodad,
+                            std::shared_ptr<PendingGameObject> pending);
+
+    // queues a rebuild of this tile with the given obstacle shape stamped
+    // onto it, or without it if shape is null
+    void UpdateObstacleShape(std::uint64_t guid, const ObstacleShape* shape,
+                             std::shared_ptr<PendingGameObject> pending);
+
+    // queues a single rebuild of this tile, which must have been loaded since
+    // the given obstacle shapes were added, with all of them stamped onto it
+    void RestoreObstacleShapes(
+        std::unordered_map<std::uint64_t, ObstacleShape>&& shapes);
 
     dtTileRef m_ref;
 
@@ -59,10 +153,24 @@ public:
                             [8 / MeshSettings::TilesPerChunk];
     std::vector<float> m_quadHeights;
 
+    // one entry per adt quad, in the same order as m_quadHoles, set where
+    // every position has the zone and area of the tile: the quad is not a
+    // hole and no static wmo overlaps it.  empty unless enabled with
+    // Map::SetZoneAreaRaster, or when the tile has no adt data
+    std::vector<bool> m_terrainQuads;
+
+    // fills m_terrainQuads.  the caller must hold an exclusive lock on the map
+    void BuildZoneAreaRaster();
+
     // static instance ids, loaded per map
     std::vector<std::uint32_t> m_staticWmos;
     std::vector<std::uint32_t> m_staticDoodads;
 
+    // the instances of those ids, in the same order, materialized when the
+    // tile was loaded
+    std::vector<std::shared_ptr<const WmoInstance>> m_staticWmoInstances;
+    std::vector<std::shared_ptr<const DoodadInstance>> m_staticDoodadInstances;
+
     // park the shared pointers here just to increment their reference counts
     std::vector<std::shared_ptr<WmoModel>> m_staticWmoModels;
     std::vector<std::shared_ptr<DoodadModel>> m_staticDoodadModels;
@@ -0,0 +1,207 @@
+#include "TileRebuilder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pathfind
+{
+namespace
+{
+// the threads shared by the rebuilders of every map.  tasks are run in the
+// order in which they were submitted
+class RebuildPool
+{
+public:
+    using Task = std::function<void()>;
+
+    static RebuildPool& Instance()
+    {
+        static RebuildPool instance;
+        return instance;
+    }
+
+    std::size_t Threads() const { return m_maxThreads; }
+
+    void Submit(Task&& task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            m_tasks.push_back(std::move(task));
+
+            // threads are only started as tasks are submitted, as most
+            // processes never insert a temporary obstacle
+            if (!m_idleThreads && m_threads.size() < m_maxThreads)
+                m_threads.emplace_back(&RebuildPool::Run, this);
+        }
+
+        m_taskReady.notify_one();
+    }
+
+private:
+    RebuildPool()
+        : m_maxThreads((std::max)(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    // tasks still queued only hold the state of their rebuilders, so they
+    // are dropped rather than run
+    ~RebuildPool()
+    {
+        std::deque<Task> discarded;
+
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_shutdown = true;
+            discarded.swap(m_tasks);
+        }
+
+        m_taskReady.notify_all();
+
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> guard(m_mutex);
+
+        while (true)
+        {
+            ++m_idleThreads;
+            m_taskReady.wait(guard, [this]()
+                             { return m_shutdown || !m_tasks.empty(); });
+            --m_idleThreads;
+
+            if (m_shutdown)
+                break;
+
+            auto task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+
+            guard.unlock();
+            task();
+            task = nullptr;
+            guard.lock();
+        }
+    }
+
+    const std::size_t m_maxThreads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_taskReady;
+
+    std::deque<Task> m_tasks;
+    std::size_t m_idleThreads = 0;
+    bool m_shutdown = false;
+
+    std::vector<std::thread> m_threads;
+};
+} // namespace
+
+TileRebuilder::TileRebuilder(std::size_t workers)
+    : m_maxWorkers(workers ? workers : RebuildPool::Instance().Threads()),
+      m_state(std::make_shared<State>())
+{
+}
+
+TileRebuilder::~TileRebuilder()
+{
+    Stop();
+}
+
+void TileRebuilder::Stop()
+{
+    std::deque<QueuedJob> discarded;
+
+    {
+        std::lock_guard<std::mutex> guard(m_state->m_mutex);
+        m_state->m_shutdown = true;
+        discarded.swap(m_state->m_jobs);
+    }
+
+    // jobs release what they captured outside of the lock, as that may free
+    // the height field of a tile
+    discarded.clear();
+
+    // tasks which have not started yet find the rebuilder stopped, and touch
+    // nothing but the state
+    std::unique_lock<std::mutex> guard(m_state->m_mutex);
+    m_state->m_idle.wait(guard,
+                         [this]() { return m_state->m_running.empty(); });
+}
+
+void TileRebuilder::Enqueue(Key key, Job&& job)
+{
+    std::lock_guard<std::mutex> guard(m_state->m_mutex);
+
+    assert(!m_state->m_shutdown);
+
+    m_state->m_jobs.push_back(QueuedJob {key, std::move(job)});
+
+    // a task only returns once it finds no job it can start, which it checks
+    // under the lock, so with the limit reached this job is always seen
+    if (m_state->m_tasks < m_maxWorkers)
+    {
+        ++m_state->m_tasks;
+        RebuildPool::Instance().Submit(
+            [state = m_state]() { Drain(state); });
+    }
+}
+
+void TileRebuilder::Wait()
+{
+    std::unique_lock<std::mutex> guard(m_state->m_mutex);
+    m_state->m_idle.wait(guard,
+                         [this]() {
+                             return m_state->m_jobs.empty() &&
+                                    m_state->m_running.empty();
+                         });
+}
+
+std::size_t TileRebuilder::Pending() const
+{
+    std::lock_guard<std::mutex> guard(m_state->m_mutex);
+    return m_state->m_jobs.size() + m_state->m_running.size();
+}
+
+void TileRebuilder::Drain(const std::shared_ptr<State>& state)
+{
+    std::unique_lock<std::mutex> guard(state->m_mutex);
+
+    while (!state->m_shutdown)
+    {
+        // the first queued job whose key is not in progress.  any earlier job
+        // with the same key would have been found first, so this preserves
+        // the queue order for each key
+        auto next = std::find_if(state->m_jobs.begin(), state->m_jobs.end(),
+                                 [&state](const QueuedJob& job) {
+                                     return !state->m_running.count(job.m_key);
+                                 });
+
+        // jobs waiting on a key in progress are left to the task running it
+        if (next == state->m_jobs.end())
+            break;
+
+        auto const key = next->m_key;
+        auto job = std::move(next->m_job);
+        state->m_jobs.erase(next);
+        state->m_running.insert(key);
+
+        guard.unlock();
+        job();
+        job = nullptr;
+        guard.lock();
+
+        state->m_running.erase(key);
+    }
+
+    --state->m_tasks;
+
+    if (state->m_running.empty())
+        state->m_idle.notify_all();
+}
+} // namespace pathfind
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace pathfind
+{
+// runs tile rebuilds in the background, so that inserting a temporary obstacle
+// does not stall the caller and the tiles it overlaps are rebuilt in parallel.
+// each job is queued with a key identifying the tile it modifies.  jobs with
+// different keys may run concurrently, while jobs sharing a key are run one at
+// a time in the order in which they were queued, which guarantees that
+// successive rebuilds of the same tile are applied in order.
+//
+// the jobs of every map run on one process-wide pool with a thread per
+// hardware thread, so that forking a map for each dungeon instance does not
+// add threads.  each rebuilder keeps its own queue, and hands the pool at most
+// as many tasks at once as its worker limit
+class TileRebuilder
+{
+public:
+    using Job = std::function<void()>;
+    using Key = const void*;
+
+    // a worker count of zero lets the map use every thread of the pool
+    explicit TileRebuilder(std::size_t workers = 0);
+    TileRebuilder(const TileRebuilder&) = delete;
+    TileRebuilder& operator=(const TileRebuilder&) = delete;
+
+    // discards any jobs which have not yet started, and waits for the jobs in
+    // progress (if any) to finish
+    ~TileRebuilder();
+
+    // as the destructor, for an owner which must stop the jobs before it
+    // releases what they use.  no jobs may be queued afterwards
+    void Stop();
+
+    void Enqueue(Key key, Job&& job);
+
+    // blocks until all queued jobs have finished
+    void Wait();
+
+    // number of jobs which are either queued or in progress
+    std::size_t Pending() const;
+
+    // the maximum number of jobs which may run at once
+    std::size_t Workers() const { return m_maxWorkers; }
+
+private:
+    struct QueuedJob
+    {
+        Key m_key;
+        Job m_job;
+    };
+
+    // shared with the tasks handed to the pool, which may only start after
+    // the rebuilder is gone, and then find it stopped
+    struct State
+    {
+        std::mutex m_mutex;
+        std::condition_variable m_idle;
+
+        std::deque<QueuedJob> m_jobs;
+
+        // keys of the jobs currently in progress
+        std::unordered_set<Key> m_running;
+
+        // tasks handed to the pool which have not yet returned
+        std::size_t m_tasks = 0;
+        bool m_shutdown = false;
+    };
+
+    // a task of the pool, which runs queued jobs until none can be started
+    static void Drain(const std::shared_ptr<State>& state);
+
+    const std::size_t m_maxWorkers;
+    const std::shared_ptr<State> m_state;
+};
+} // namespace pathfind
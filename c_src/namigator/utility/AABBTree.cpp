@@ -4,7 +4,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <limits>
+#include <type_traits>
 
 namespace math
 {
@@ -49,57 +52,238 @@ AABBTree::AABBTree(const std::vector<Vertex>& vertices,
 
 BoundingBox AABBTree::GetBoundingBox() const
 {
+    if (IsCompact())
+        return m_rootBounds;
     if (m_nodes.empty())
         return BoundingBox {};
     return m_nodes.front().bounds;
 }
 
-void AABBTree::Serialize(utility::BinaryStream& stream) const
+void AABBTree::Compact()
 {
-    auto const size =
-        sizeof(std::uint32_t) *
-            5 + // magic, Vector3 count, index count, node count, end magic
-        sizeof(Vertex) * m_vertices.size() +      // vertices
-        sizeof(std::int32_t) * m_indices.size() + // indices
-        (sizeof(std::uint8_t) + sizeof(std::uint32_t) + sizeof(BoundingBox)) *
-            m_nodes.size(); // nodes (numFaces + startFace/childen + bounds) *
-                            // count
+    if (IsCompact() || m_nodes.empty())
+        return;
 
-    auto ourStream = utility::BinaryStream(size);
+    m_rootBounds = m_nodes.front().bounds;
 
-    ourStream << StartMagic;
+    auto const& origin = m_rootBounds.MinCorner;
+    auto const& end = m_rootBounds.MaxCorner;
 
-    ourStream << static_cast<std::uint32_t>(m_vertices.size());
-    ourStream.Write(&m_vertices[0], m_vertices.size() * sizeof(Vector3));
+    auto largest = 0.f;
 
-    ourStream << static_cast<std::uint32_t>(m_indices.size());
-
-    for (const auto& index : m_indices)
+    for (auto axis = 0; axis < 3; ++axis)
     {
-        const std::int32_t idx = index;
-        ourStream << idx;
+        // the largest step must reach the far side of the root bounds
+        auto& step = m_quantizationStep[axis];
+        step = (end[axis] - origin[axis]) / MaxQuantizedStep;
+
+        while (origin[axis] + MaxQuantizedStep * step < end[axis])
+            step = std::nextafter(step, std::numeric_limits<float>::max());
+
+        largest = (std::max)(
+            largest, (std::max)(std::fabs(origin[axis]), std::fabs(end[axis])));
     }
 
-    ourStream << static_cast<std::uint32_t>(m_nodes.size());
+    // a few units in the last place of the largest coordinate, which is more
+    // than the error of decoding any bound
+    m_quantizationSlack =
+        4.f * (std::nextafter(largest, std::numeric_limits<float>::max()) -
+               largest);
+
+    m_compactNodes.resize(m_nodes.size());
 
-    for (const auto& node : m_nodes)
+    for (auto i = 0u; i < m_nodes.size(); ++i)
     {
-        assert(node.numFaces < 8);
+        auto const& node = m_nodes[i];
+        auto& compact = m_compactNodes[i];
 
-        ourStream << static_cast<std::uint8_t>(node.numFaces);
+        assert(node.numFaces < 8 && node.children <= CompactOffsetMask);
 
-        if (!!node.numFaces)
+        compact.m_data = node.numFaces << CompactFaceShift | node.children;
+
+        for (auto axis = 0; axis < 3; ++axis)
         {
-            // Write leaf node
-            ourStream << node.startFace << node.bounds;
+            auto const step = m_quantizationStep[axis];
+            auto const quantize = [&](float value, float (*round)(float))
+            {
+                if (step <= 0.f)
+                    return 0.f;
+
+                return (std::min)(
+                    (std::max)(round((value - origin[axis]) / step), 0.f),
+                    static_cast<float>(MaxQuantizedStep));
+            };
+
+            auto min = static_cast<std::uint16_t>(
+                quantize(node.bounds.MinCorner[axis], std::floor));
+            auto max = static_cast<std::uint16_t>(
+                quantize(node.bounds.MaxCorner[axis], std::ceil));
+
+            // make sure that the decoded bounds contain the original ones
+            while (min > 0 && Dequantize(min, axis) - m_quantizationSlack >
+                                  node.bounds.MinCorner[axis])
+                --min;
+
+            while (max < MaxQuantizedStep &&
+                   Dequantize(max, axis) + m_quantizationSlack <
+                       node.bounds.MaxCorner[axis])
+                ++max;
+
+            compact.m_min[axis] = min;
+            compact.m_max[axis] = max;
         }
-        else
+    }
+
+    std::vector<Node>().swap(m_nodes);
+
+    CompactIndices();
+}
+
+bool AABBTree::CompactIndices()
+{
+    constexpr auto unused = std::numeric_limits<std::uint32_t>::max();
+
+    // the new number of each vertex, by its old one
+    std::vector<std::uint32_t> numbers(m_vertices.size(), unused);
+    std::vector<Vertex> vertices;
+    vertices.reserve(m_vertices.size());
+
+    for (auto const index : m_indices)
+        if (numbers[index] == unused)
+        {
+            numbers[index] = static_cast<std::uint32_t>(vertices.size());
+            vertices.push_back(m_vertices[index]);
+        }
+
+    // vertices which no face uses are kept, after the others
+    for (auto i = 0u; i < m_vertices.size(); ++i)
+        if (numbers[i] == unused)
+        {
+            numbers[i] = static_cast<std::uint32_t>(vertices.size());
+            vertices.push_back(m_vertices[i]);
+        }
+
+    auto const faces = static_cast<std::uint32_t>(m_indices.size() / 3);
+
+    std::vector<std::uint32_t> bases((faces + IndexBlockFaces - 1) /
+                                     IndexBlockFaces);
+    std::vector<std::uint16_t> indices(m_indices.size());
+
+    for (auto block = 0u; block < bases.size(); ++block)
+    {
+        auto const begin = block * IndexBlockFaces * 3;
+        auto const end = (std::min)(begin + IndexBlockFaces * 3,
+                                    static_cast<std::uint32_t>(indices.size()));
+
+        auto base = unused;
+        auto last = 0u;
+
+        for (auto i = begin; i < end; ++i)
         {
-            // Write inner node
-            ourStream << node.children << node.bounds;
+            base = (std::min)(base, numbers[m_indices[i]]);
+            last = (std::max)(last, numbers[m_indices[i]]);
         }
+
+        if (last - base > std::numeric_limits<std::uint16_t>::max())
+            return false;
+
+        bases[block] = base;
+
+        for (auto i = begin; i < end; ++i)
+            indices[i] =
+                static_cast<std::uint16_t>(numbers[m_indices[i]] - base);
+    }
+
+    m_vertices.swap(vertices);
+    m_compactIndices.swap(indices);
+    m_indexBases.swap(bases);
+    std::vector<int>().swap(m_indices);
+
+    return true;
+}
+
+std::size_t AABBTree::MemoryUsage() const
+{
+    return m_vertices.capacity() * sizeof(Vertex) +
+           m_indices.capacity() * sizeof(int) +
+           m_compactIndices.capacity() * sizeof(std::uint16_t) +
+           m_indexBases.capacity() * sizeof(std::uint32_t) +
+           m_nodes.capacity() * sizeof(Node) +
+           m_compactNodes.capacity() * sizeof(CompactNode);
+}
+
+const std::vector<int>& AABBTree::Indices(std::vector<int>& buffer) const
+{
+    if (m_compactIndices.empty())
+        return m_indices;
+
+    buffer.resize(m_compactIndices.size());
+
+    for (auto i = 0u; i < buffer.size(); ++i)
+        buffer[i] = static_cast<int>(
+            FaceVertex(m_compactIndices.data(), i / 3, i % 3));
+
+    return buffer;
+}
+
+float AABBTree::Dequantize(std::uint16_t value, int axis) const
+{
+    return m_rootBounds.MinCorner[axis] + value * m_quantizationStep[axis];
+}
+
+BoundingBox AABBTree::DecodeBounds(const CompactNode& node) const
+{
+    BoundingBox result;
+
+    for (auto axis = 0; axis < 3; ++axis)
+    {
+        result.MinCorner[axis] =
+            Dequantize(node.m_min[axis], axis) - m_quantizationSlack;
+        result.MaxCorner[axis] =
+            Dequantize(node.m_max[axis], axis) + m_quantizationSlack;
     }
 
+    return result;
+}
+
+// BVH2 files are copied straight into these arrays
+static_assert(sizeof(Vertex) == 3 * sizeof(float),
+              "vertices must be stored as three packed floats");
+static_assert(sizeof(int) == sizeof(std::int32_t),
+              "indices must be stored as 32 bit integers");
+static_assert(sizeof(BoundingBox) == 6 * sizeof(float),
+              "bounds must be stored as six packed floats");
+static_assert(std::is_trivially_copyable<Vertex>::value &&
+                  std::is_trivially_copyable<BoundingBox>::value,
+              "tree arrays must be trivially copyable");
+
+void AABBTree::Serialize(utility::BinaryStream& stream) const
+{
+    static_assert(sizeof(Node) == 2 * sizeof(std::uint32_t) +
+                                      sizeof(BoundingBox),
+                  "nodes must not contain padding");
+
+    auto const size =
+        sizeof(std::uint32_t) *
+            5 + // magic, vertex count, index count, node count, end magic
+        sizeof(Vertex) * m_vertices.size() +      // vertices
+        sizeof(std::int32_t) * m_indices.size() + // indices
+        sizeof(Node) * m_nodes.size();            // nodes
+
+    assert(!IsCompact());
+
+    auto ourStream = utility::BinaryStream(size);
+
+    ourStream << StartMagic;
+
+    ourStream << static_cast<std::uint32_t>(m_vertices.size());
+    ourStream << static_cast<std::uint32_t>(m_indices.size());
+    ourStream << static_cast<std::uint32_t>(m_nodes.size());
+
+    ourStream.Write(m_vertices.data(), m_vertices.size() * sizeof(Vertex));
+    ourStream.Write(m_indices.data(), m_indices.size() * sizeof(std::int32_t));
+    ourStream.Write(m_nodes.data(), m_nodes.size() * sizeof(Node));
+
     ourStream << EndMagic;
 
     assert(ourStream.wpos() == size);
@@ -107,13 +291,55 @@ void AABBTree::Serialize(utility::BinaryStream& stream) const
     stream << ourStream;
 }
 
+bool AABBTree::IsLegacyFormat(utility::BinaryStream& stream)
+{
+    auto const start = stream.rpos();
+
+    std::uint32_t magic;
+    stream >> magic;
+    stream.rpos(start);
+
+    return magic == LegacyMagic;
+}
+
 bool AABBTree::Deserialize(utility::BinaryStream& stream)
 {
+    if (IsLegacyFormat(stream))
+        return DeserializeLegacy(stream);
+
     std::uint32_t magic;
     stream >> magic;
     if (magic != StartMagic)
         return false;
 
+    std::uint32_t vertexCount, indexCount, nodeCount;
+    stream >> vertexCount >> indexCount >> nodeCount;
+
+    assert(vertexCount > 0);
+    assert(indexCount > 0);
+
+    m_vertices.resize(vertexCount);
+    stream.ReadBytes(m_vertices.data(), vertexCount * sizeof(Vertex));
+
+    m_indices.resize(indexCount);
+    stream.ReadBytes(m_indices.data(), indexCount * sizeof(std::int32_t));
+
+    m_nodes.resize(nodeCount);
+    stream.ReadBytes(m_nodes.data(), nodeCount * sizeof(Node));
+
+    std::uint32_t endMagic;
+    stream >> endMagic;
+
+    return endMagic == EndMagic;
+}
+
+bool AABBTree::DeserializeLegacy(utility::BinaryStream& stream)
+{
+    std::uint32_t magic;
+    stream >> magic;
+    if (magic != LegacyMagic)
+        return false;
+
     std::uint32_t vertexCount;
     stream >> vertexCount;
 
@@ -127,13 +353,9 @@ bool AABBTree::Deserialize(utility::BinaryStream& stream)
 
     assert(indexCount > 0);
 
-    m_indices.reserve(indexCount);
-    for (auto i = 0u; i < indexCount; ++i)
-    {
-        std::int32_t index;
-        stream >> index;
-        m_indices.push_back(static_cast<int>(index));
-    }
+    // the indices were always written as packed 32 bit integers
+    m_indices.resize(indexCount);
+    stream.ReadBytes(m_indices.data(), indexCount * sizeof(std::int32_t));
 
     std::uint32_t nodeCount;
     stream >> nodeCount;
@@ -224,6 +446,10 @@ void AABBTree::Build(const std::vector<Vertex>& verts,
                    static_cast<unsigned int>(numFaces));
     m_faceBounds.clear();
 
+    // nodes are allocated in blocks, so drop those left over
+    m_nodes.resize(m_freeNode);
+    m_nodes.shrink_to_fit();
+
     // Reorder the model indices according to the face indices
     std::vector<int> sortedIndices(m_indices.size());
     for (size_t i = 0; i < numFaces; ++i)
@@ -351,10 +577,37 @@ void AABBTree::BuildRecursive(unsigned int nodeIndex, unsigned int* faces,
 bool AABBTree::IntersectRay(Ray& ray, unsigned int* faceIndex) const
 {
     float distance = ray.GetDistance();
-    TraceRecursive(0, ray, faceIndex);
+
+    if (!IsCompact())
+        TraceRecursive(0, ray, faceIndex);
+    else if (m_compactIndices.empty())
+        TraceCompactRecursive(m_indices.data(), 0, ray, faceIndex);
+    else
+        TraceCompactRecursive(m_compactIndices.data(), 0, ray, faceIndex);
+
     return ray.GetDistance() < distance;
 }
 
+void AABBTree::IntersectRayAll(const Ray& ray,
+                               std::vector<float>& distances) const
+{
+    if (IsCompact())
+    {
+        if (m_compactIndices.empty())
+            TraceAllCompactRecursive(m_indices.data(), 0, ray, distances);
+        else
+            TraceAllCompactRecursive(m_compactIndices.data(), 0, ray,
+                                     distances);
+
+        return;
+    }
+
+    if (m_nodes.empty())
+        return;
+
+    TraceAllRecursive(0, ray, distances);
+}
+
 void AABBTree::Trace(Ray& ray, unsigned int* faceIndex) const
 {
     struct StackEntry
@@ -425,11 +678,20 @@ void AABBTree::TraceRecursive(unsigned int nodeIndex, Ray& ray,
 void AABBTree::TraceLeafNode(const Node& node, Ray& ray,
                              unsigned int* faceIndex) const
 {
-    for (auto i = node.startFace; i < node.startFace + node.numFaces; ++i)
+    TraceFaces(m_indices.data(), node.startFace, node.numFaces, ray,
+               faceIndex);
+}
+
+template <typename Index>
+void AABBTree::TraceFaces(const Index* indices, std::uint32_t startFace,
+                          std::uint32_t numFaces, Ray& ray,
+                          unsigned int* faceIndex) const
+{
+    for (auto i = startFace; i < startFace + numFaces; ++i)
     {
-        auto& v0 = m_vertices[m_indices[i * 3 + 0]];
-        auto& v1 = m_vertices[m_indices[i * 3 + 1]];
-        auto& v2 = m_vertices[m_indices[i * 3 + 2]];
+        auto& v0 = m_vertices[FaceVertex(indices, i, 0)];
+        auto& v1 = m_vertices[FaceVertex(indices, i, 1)];
+        auto& v2 = m_vertices[FaceVertex(indices, i, 2)];
 
         float distance;
         if (!ray.IntersectTriangle(v0, v1, v2, &distance))
@@ -469,4 +731,108 @@ void AABBTree::TraceInnerNode(const Node& node, Ray& ray,
     if (distance[furthest] < ray.GetDistance())
         TraceRecursive(node.children + furthest, ray, faceIndex);
 }
+
+void AABBTree::TraceAllRecursive(unsigned int nodeIndex, const Ray& ray,
+                                 std::vector<float>& distances) const
+{
+    auto& node = m_nodes.at(nodeIndex);
+
+    if (!node.numFaces)
+    {
+        // no child can be skipped for being further than a hit, only for
+        // starting beyond the end of the ray
+        for (auto i = 0u; i < 2; ++i)
+        {
+            float distance;
+            if (ray.IntersectBoundingBox(m_nodes.at(node.children + i).bounds,
+                                         &distance) &&
+                distance < 1.f)
+                TraceAllRecursive(node.children + i, ray, distances);
+        }
+
+        return;
+    }
+
+    TraceAllFaces(m_indices.data(), node.startFace, node.numFaces, ray,
+                  distances);
+}
+
+template <typename Index>
+void AABBTree::TraceAllFaces(const Index* indices, std::uint32_t startFace,
+                             std::uint32_t numFaces, const Ray& ray,
+                             std::vector<float>& distances) const
+{
+    for (auto i = startFace; i < startFace + numFaces; ++i)
+    {
+        auto& v0 = m_vertices[FaceVertex(indices, i, 0)];
+        auto& v1 = m_vertices[FaceVertex(indices, i, 1)];
+        auto& v2 = m_vertices[FaceVertex(indices, i, 2)];
+
+        float distance;
+        if (ray.IntersectTriangle(v0, v1, v2, &distance) && distance < 1.f)
+            distances.push_back(distance);
+    }
+}
+
+template <typename Index>
+void AABBTree::TraceCompactRecursive(const Index* indices,
+                                     unsigned int nodeIndex, Ray& ray,
+                                     unsigned int* faceIndex) const
+{
+    auto const& node = m_compactNodes.at(nodeIndex);
+    auto const numFaces = node.m_data >> CompactFaceShift;
+    auto const offset = node.m_data & CompactOffsetMask;
+
+    if (!!numFaces)
+    {
+        TraceFaces(indices, offset, numFaces, ray, faceIndex);
+        return;
+    }
+
+    float max = std::numeric_limits<float>::max();
+    float distance[2] = {max, max};
+
+    ray.IntersectBoundingBox(DecodeBounds(m_compactNodes.at(offset + 0)),
+                             &distance[0]);
+    ray.IntersectBoundingBox(DecodeBounds(m_compactNodes.at(offset + 1)),
+                             &distance[1]);
+
+    unsigned int closest = 0;
+    unsigned int furthest = 1;
+
+    if (distance[1] < distance[0])
+        std::swap(closest, furthest);
+
+    if (distance[closest] < ray.GetDistance())
+        TraceCompactRecursive(indices, offset + closest, ray, faceIndex);
+
+    if (distance[furthest] < ray.GetDistance())
+        TraceCompactRecursive(indices, offset + furthest, ray, faceIndex);
+}
+
+template <typename Index>
+void AABBTree::TraceAllCompactRecursive(const Index* indices,
+                                        unsigned int nodeIndex,
+                                        const Ray& ray,
+                                        std::vector<float>& distances) const
+{
+    auto const& node = m_compactNodes.at(nodeIndex);
+    auto const numFaces = node.m_data >> CompactFaceShift;
+    auto const offset = node.m_data & CompactOffsetMask;
+
+    if (!!numFaces)
+    {
+        TraceAllFaces(indices, offset, numFaces, ray, distances);
+        return;
+    }
+
+    for (auto i = 0u; i < 2; ++i)
+    {
+        float distance;
+        if (ray.IntersectBoundingBox(
+                DecodeBounds(m_compactNodes.at(offset + i)), &distance) &&
+            distance < 1.f)
+            TraceAllCompactRecursive(indices, offset + i, ray, distances);
+    }
+}
 } // namespace math
\ No newline at end of file
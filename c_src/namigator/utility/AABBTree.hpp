@@ -5,6 +5,7 @@
 #include "Ray.hpp"
 #include "Vector.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -21,11 +22,35 @@ private:
             std::uint32_t startFace;
         };
 
-        unsigned int numFaces = 0;
+        std::uint32_t numFaces = 0;
         BoundingBox bounds;
     };
 
-    static constexpr std::uint32_t StartMagic = 'BVH1';
+    // a node of a compacted tree, half the size of a Node.  its bounds are in
+    // steps of m_quantizationStep from the minimum corner of the root bounds,
+    // rounded outwards.  the top bits of m_data hold the face count, which is
+    // zero for inner nodes, and the rest the children or startFace
+    struct CompactNode
+    {
+        std::uint16_t m_min[3];
+        std::uint16_t m_max[3];
+        std::uint32_t m_data;
+    };
+
+    static constexpr std::uint32_t CompactFaceShift = 29;
+    static constexpr std::uint32_t CompactOffsetMask =
+        (1u << CompactFaceShift) - 1;
+    static constexpr std::uint32_t MaxQuantizedStep = 0xFFFF;
+
+    // the faces of a compact tree sharing one base for their 16 bit indices
+    static constexpr std::uint32_t IndexBlockShift = 6;
+    static constexpr std::uint32_t IndexBlockFaces = 1u << IndexBlockShift;
+
+    // BVH1 stores every index and node field by field.  BVH2 stores the
+    // counts up front, followed by the vertex, index and node arrays exactly
+    // as they are laid out in memory, so that each is read with one copy
+    static constexpr std::uint32_t LegacyMagic = 'BVH1';
+    static constexpr std::uint32_t StartMagic = 'BVH2';
     static constexpr std::uint32_t EndMagic = 'FOOB';
 
 public:
@@ -42,13 +67,40 @@ public:
                const std::vector<int>& indices);
     bool IntersectRay(Ray& ray, unsigned int* faceIndex = nullptr) const;
 
+    // appends the distance of every intersection along the ray, rather than
+    // only the nearest, in no particular order.  the whole tree is traversed
+    // once, instead of once per hit
+    void IntersectRayAll(const Ray& ray, std::vector<float>& distances) const;
+
     BoundingBox GetBoundingBox() const;
 
+    // replaces the nodes with CompactNodes and, where it can, the indices
+    // with 16 bit offsets from a base per IndexBlockFaces faces (see
+    // CompactIndices).  the quantized bounds only ever grow and the triangles
+    // are unchanged, so ray casts never miss a hit which they found before.
+    // a compacted tree cannot be serialized
+    void Compact();
+    bool IsCompact() const { return !m_compactNodes.empty(); }
+
+    // bytes held by the vertex, index and node arrays
+    std::size_t MemoryUsage() const;
+
+    // always writes the current (BVH2) format
     void Serialize(utility::BinaryStream& stream) const;
+
+    // reads either format.  on success, the stream is left at the end of the
+    // tree, so that data following it in the same file may be read
     bool Deserialize(utility::BinaryStream& stream);
 
+    // true when the stream, at its current read position, holds a tree in
+    // the BVH1 format.  does not advance the stream
+    static bool IsLegacyFormat(utility::BinaryStream& stream);
+
     const std::vector<Vector3>& Vertices() const { return m_vertices; }
-    const std::vector<int>& Indices() const { return m_indices; }
+    // the indices of the tree.  for a tree with 16 bit indices, these are
+    // expanded into buffer, which is then returned.  compacting the tree may
+    // renumber its vertices, so the two are only meaningful together
+    const std::vector<int>& Indices(std::vector<int>& buffer) const;
 
 private:
     unsigned int PartitionMedian(Node& node, unsigned int* faces,
@@ -68,6 +120,49 @@ private:
                         unsigned int* faceIndex) const;
     void TraceLeafNode(const Node& node, Ray& ray,
                        unsigned int* faceIndex) const;
+    void TraceAllRecursive(unsigned int nodeIndex, const Ray& ray,
+                           std::vector<float>& distances) const;
+
+    template <typename Index>
+    void TraceFaces(const Index* indices, std::uint32_t startFace,
+                    std::uint32_t numFaces, Ray& ray,
+                    unsigned int* faceIndex) const;
+    template <typename Index>
+    void TraceAllFaces(const Index* indices, std::uint32_t startFace,
+                       std::uint32_t numFaces, const Ray& ray,
+                       std::vector<float>& distances) const;
+
+    template <typename Index>
+    void TraceCompactRecursive(const Index* indices, unsigned int nodeIndex,
+                               Ray& ray, unsigned int* faceIndex) const;
+    template <typename Index>
+    void TraceAllCompactRecursive(const Index* indices,
+                                  unsigned int nodeIndex, const Ray& ray,
+                                  std::vector<float>& distances) const;
+
+    // numbers the vertices in the order in which the faces first use them,
+    // so that the faces of a block mostly use neighbouring vertices, and
+    // replaces the indices with 16 bit ones.  does nothing and returns false
+    // if the vertices of some block are too far apart for 16 bits
+    bool CompactIndices();
+
+    // the vertex at a corner of a face, from either kind of indices
+    std::uint32_t FaceVertex(const int* indices, std::uint32_t face,
+                             int corner) const
+    {
+        return indices[face * 3 + corner];
+    }
+    std::uint32_t FaceVertex(const std::uint16_t* indices, std::uint32_t face,
+                             int corner) const
+    {
+        return m_indexBases[face >> IndexBlockShift] +
+               indices[face * 3 + corner];
+    }
+
+    float Dequantize(std::uint16_t value, int axis) const;
+    BoundingBox DecodeBounds(const CompactNode& node) const;
+
+    bool DeserializeLegacy(utility::BinaryStream& stream);
 
     static unsigned int GetLongestAxis(const Vector3& v);
 
@@ -79,6 +174,19 @@ private:
     std::vector<Vertex> m_vertices;
     std::vector<int> m_indices;
 
+    // only present once the tree has been compacted, replacing m_nodes and,
+    // when CompactIndices succeeds, m_indices.  each compact index is added to
+    // the base of its block of IndexBlockFaces faces
+    std::vector<CompactNode> m_compactNodes;
+    std::vector<std::uint16_t> m_compactIndices;
+    std::vector<std::uint32_t> m_indexBases;
+    BoundingBox m_rootBounds;
+    Vector3 m_quantizationStep;
+
+    // added to every side of the decoded bounds, to cover the rounding of the
+    // arithmetic decoding them
+    float m_quantizationSlack = 0.f;
+
     std::vector<BoundingBox> m_faceBounds;
     std::vector<unsigned int> m_faceIndices;
 };
@@ -1,6 +1,7 @@
 #include "utility/BinaryStream.hpp"
 
 #include "utility/Exception.hpp"
+#include "utility/Lz4.hpp"
 #include "utility/miniz.c"
 
 #include <algorithm>
@@ -12,6 +13,11 @@
 
 namespace utility
 {
+namespace
+{
+constexpr size_t maxDecompressedSize = 512 * 1024 * 1024;
+}
+
 BinaryStream::BinaryStream(
     std::shared_ptr<std::vector<std::uint8_t>> shared_buffer)
     : m_sharedBuffer(shared_buffer), m_rpos(0), m_wpos(m_sharedBuffer->size())
@@ -199,20 +205,30 @@ bool BinaryStream::IsEOF()
     return m_rpos == buff->size();
 }
 
-void BinaryStream::Compress()
+void BinaryStream::Compress(Compression compression)
 {
-    std::vector<std::uint8_t> buff(
-        compressBound(static_cast<mz_ulong>(m_wpos)));
-    auto newSize = static_cast<mz_ulong>(buff.size());
-    auto const result =
-        compress(&buff[0], &newSize,
-                 reinterpret_cast<const unsigned char*>(&m_buffer[0]),
-                 static_cast<mz_ulong>(m_wpos));
-
-    if (result != MZ_OK)
-        THROW(Result::BINARYSTREAM_COMPRESS_FAILED);
-
-    m_wpos = static_cast<size_t>(newSize);
+    std::vector<std::uint8_t> buff;
+
+    if (compression == Compression::Lz4)
+    {
+        buff.resize(lz4::CompressBound(m_wpos));
+        m_wpos = lz4::Compress(&m_buffer[0], m_wpos, &buff[0]);
+    }
+    else
+    {
+        buff.resize(compressBound(static_cast<mz_ulong>(m_wpos)));
+        auto newSize = static_cast<mz_ulong>(buff.size());
+        auto const result =
+            compress(&buff[0], &newSize,
+                     reinterpret_cast<const unsigned char*>(&m_buffer[0]),
+                     static_cast<mz_ulong>(m_wpos));
+
+        if (result != MZ_OK)
+            THROW(Result::BINARYSTREAM_COMPRESS_FAILED);
+
+        m_wpos = static_cast<size_t>(newSize);
+    }
+
     buff.resize(m_wpos);
 
     m_buffer = std::move(buff);
@@ -224,7 +240,6 @@ void BinaryStream::Decompress()
     if (m_wpos == 0)
         return;
 
-    constexpr size_t maxDecompressedSize = 512 * 1024 * 1024;
     std::vector<std::uint8_t> buffer(m_wpos);
     mz_stream stream;
     memset(&stream, 0, sizeof(stream));
@@ -280,6 +295,45 @@ void BinaryStream::Decompress()
     m_buffer.resize(m_wpos);
 }
 
+void BinaryStream::Decompress(size_t size, Compression compression)
+{
+    if (size > maxDecompressedSize)
+        THROW(Result::DECOMPRESS_OUTPUT_TOO_LARGE);
+
+    std::vector<std::uint8_t> buffer(size);
+
+    if (compression == Compression::Lz4)
+    {
+        if (!lz4::Decompress(m_buffer.data(), m_wpos, buffer.data(), size))
+            THROW(Result::LZ4_DECOMPRESS_FAILED);
+    }
+    else
+    {
+        mz_stream stream;
+        memset(&stream, 0, sizeof(stream));
+
+        stream.next_in = m_buffer.data();
+        stream.avail_in = static_cast<unsigned int>(m_wpos);
+        stream.next_out = buffer.data();
+        stream.avail_out = static_cast<unsigned int>(size);
+
+        if (mz_inflateInit(&stream) != MZ_OK)
+            THROW(Result::MZ_INFLATEINIT_FAILED);
+
+        // with the whole output available, a single call must finish
+        auto const status = mz_inflate(&stream, MZ_FINISH);
+        auto const written = stream.total_out;
+        mz_inflateEnd(&stream);
+
+        if (status != MZ_STREAM_END || written != size)
+            THROW(Result::MZ_INFLATE_FAILED);
+    }
+
+    m_rpos = 0;
+    m_wpos = size;
+    m_buffer = std::move(buffer);
+}
+
 BinaryStream& operator<<(BinaryStream& stream, const std::string& str)
 {
     stream.Write(str.c_str(), str.length());
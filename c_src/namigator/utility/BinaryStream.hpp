@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <map>
@@ -11,6 +12,12 @@
 
 namespace utility
 {
+enum class Compression : std::uint8_t
+{
+    Deflate = 0,
+    Lz4 = 1,
+};
+
 class BinaryStream
 {
 private:
@@ -104,8 +111,16 @@ public:
                           size_t& result) const;
     bool IsEOF();
 
-    void Compress();
+    void Compress(Compression compression = Compression::Deflate);
+
+    // decompresses a deflate stream of unknown size, growing the buffer as it
+    // goes
     void Decompress();
+
+    // decompresses in one pass into a buffer of the given size, which must be
+    // exactly the size of the output.  lz4 blocks may only be decompressed
+    // this way, as they do not record their size
+    void Decompress(size_t size, Compression compression);
 };
 
 template <typename T>
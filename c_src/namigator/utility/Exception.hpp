@@ -174,6 +174,18 @@ namespace {
                 return "Temporary WMO obstacles are not supported";
             case Result::NO_DOODAD_SET_SPECIFIED_FOR_WMO_GAME_OBJECT:
                 return "No doodad set specified for WMO game object";
+            case Result::UNKNOWN_PATH_FILTER:
+                return "Unknown path filter";
+            case Result::CANNOT_FORK_MAP_WITH_TEMPORARY_OBSTACLES:
+                return "Cannot fork a map with temporary obstacles";
+            case Result::FAILED_TO_OPEN_NAV_ARCHIVE:
+                return "Failed to open nav archive";
+            case Result::INVALID_NAV_ARCHIVE:
+                return "Invalid nav archive";
+            case Result::NAV_ARCHIVE_READ_FAILED:
+                return "Nav archive read failed";
+            case Result::LZ4_DECOMPRESS_FAILED:
+                return "LZ4 decompress failed";
 
             default:
                 return "Unknown error";
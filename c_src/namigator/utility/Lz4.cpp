@@ -0,0 +1,240 @@
+#include "utility/Lz4.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace utility
+{
+namespace lz4
+{
+namespace
+{
+constexpr std::size_t MinMatch = 4;
+
+// the format requires the last five bytes to be literals, and the last match
+// to begin at least twelve bytes before the end
+constexpr std::size_t LastLiterals = 5;
+constexpr std::size_t MatchLimit = 12;
+
+constexpr std::size_t MaxOffset = 65535;
+constexpr unsigned int HashBits = 14;
+
+constexpr std::ptrdiff_t FastCopy = 16;
+
+std::uint32_t Read32(const std::uint8_t* p)
+{
+    std::uint32_t result;
+    std::memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+std::uint32_t Hash(std::uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+// writes the part of a length which does not fit in the four bits of the token
+std::uint8_t* WriteLength(std::uint8_t* out, std::size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+
+    *out++ = static_cast<std::uint8_t>(length);
+    return out;
+}
+
+bool ReadLength(const std::uint8_t*& in, const std::uint8_t* end,
+                std::size_t& length)
+{
+    std::uint8_t next;
+
+    do
+    {
+        if (in == end)
+            return false;
+
+        next = *in++;
+        length += next;
+    } while (next == 255);
+
+    return true;
+}
+
+std::uint8_t* WriteLiterals(std::uint8_t* out, std::uint8_t* token,
+                            const std::uint8_t* literals, std::size_t length)
+{
+    if (length >= 15)
+    {
+        *token = 15 << 4;
+        out = WriteLength(out, length - 15);
+    }
+    else
+        *token = static_cast<std::uint8_t>(length << 4);
+
+    std::memcpy(out, literals, length);
+    return out + length;
+}
+} // namespace
+
+std::size_t CompressBound(std::size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+std::size_t Compress(const std::uint8_t* input, std::size_t size,
+                     std::uint8_t* output)
+{
+    auto out = output;
+    std::size_t anchor = 0;
+
+    if (size > MatchLimit)
+    {
+        std::vector<std::uint32_t> table(1u << HashBits, 0);
+
+        std::size_t pos = 1;
+        table[Hash(Read32(input))] = 0;
+
+        while (pos + MatchLimit <= size)
+        {
+            auto const sequence = Read32(input + pos);
+            auto& entry = table[Hash(sequence)];
+            std::size_t candidate = entry;
+            entry = static_cast<std::uint32_t>(pos);
+
+            if (candidate >= pos || pos - candidate > MaxOffset ||
+                Read32(input + candidate) != sequence)
+            {
+                // step faster through data which does not compress
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            // the match may begin before where it was found
+            while (pos > anchor && candidate > 0 &&
+                   input[pos - 1] == input[candidate - 1])
+            {
+                --pos;
+                --candidate;
+            }
+
+            auto length = MinMatch;
+            while (pos + length < size - LastLiterals &&
+                   input[candidate + length] == input[pos + length])
+                ++length;
+
+            auto const token = out++;
+            out = WriteLiterals(out, token, input + anchor, pos - anchor);
+
+            auto const offset = pos - candidate;
+            *out++ = static_cast<std::uint8_t>(offset);
+            *out++ = static_cast<std::uint8_t>(offset >> 8);
+
+            if (length - MinMatch >= 15)
+            {
+                *token |= 15;
+                out = WriteLength(out, length - MinMatch - 15);
+            }
+            else
+                *token |= static_cast<std::uint8_t>(length - MinMatch);
+
+            pos += length;
+            anchor = pos;
+
+            // let later matches begin within this one
+            if (pos + MatchLimit <= size)
+                table[Hash(Read32(input + pos - 2))] =
+                    static_cast<std::uint32_t>(pos - 2);
+        }
+    }
+
+    auto const token = out++;
+    return WriteLiterals(out, token, input + anchor, size - anchor) - output;
+}
+
+bool Decompress(const std::uint8_t* input, std::size_t inputSize,
+                std::uint8_t* output, std::size_t outputSize)
+{
+    auto in = input;
+    auto const inEnd = input + inputSize;
+    auto out = output;
+    auto const outEnd = output + outputSize;
+
+    while (in != inEnd)
+    {
+        auto const token = *in++;
+
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !ReadLength(in, inEnd, literals))
+            return false;
+
+        if (literals > static_cast<std::size_t>(inEnd - in) ||
+            literals > static_cast<std::size_t>(outEnd - out))
+            return false;
+
+        // most runs are short, and a fixed size copy is much cheaper than one
+        // of a variable size.  the bytes written past the run are overwritten
+        // by what follows it
+        if (literals <= static_cast<std::size_t>(FastCopy) &&
+            inEnd - in >= FastCopy &&
+            outEnd - out >= FastCopy)
+            std::memcpy(out, in, FastCopy);
+        else
+            std::memcpy(out, in, literals);
+
+        in += literals;
+        out += literals;
+
+        // the last sequence has no match
+        if (in == inEnd)
+            return out == outEnd;
+
+        if (inEnd - in < 2)
+            return false;
+
+        std::size_t const offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        if (offset == 0 || offset > static_cast<std::size_t>(out - output))
+            return false;
+
+        std::size_t length = token & 15;
+        if (length == 15 && !ReadLength(in, inEnd, length))
+            return false;
+
+        length += MinMatch;
+
+        if (length > static_cast<std::size_t>(outEnd - out))
+            return false;
+
+        auto const match = out - offset;
+
+        if (offset >= 8 &&
+            length + 8 <= static_cast<std::size_t>(outEnd - out))
+        {
+            // eight bytes at a time, which may run past the match but not
+            // past the output
+            for (std::size_t copied = 0; copied < length; copied += 8)
+                std::memcpy(out + copied, match + copied, 8);
+        }
+        else
+        {
+            // a match may overlap its own output, to repeat a short run.  the
+            // output then repeats every offset bytes, so it is copied from the
+            // start of the match in whole periods, doubling as it goes
+            for (std::size_t copied = 0; copied < length;)
+            {
+                auto const chunk =
+                    (std::min)(offset + copied, length - copied);
+                std::memcpy(out + copied, match, chunk);
+                copied += chunk;
+            }
+        }
+
+        out += length;
+    }
+
+    return false;
+}
+} // namespace lz4
+} // namespace utility
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utility
+{
+// the lz4 block format: a sequence of literal runs, each followed by a copy of
+// earlier output.  it compresses less than deflate but decompresses several
+// times faster, as there is no entropy coding to undo.  blocks carry neither
+// their own size nor a checksum, so the size of the output must be stored
+// beside them
+namespace lz4
+{
+// the most which compressing the given number of bytes may produce
+std::size_t CompressBound(std::size_t size);
+
+// compresses size bytes of input into output, which must have room for
+// CompressBound(size) bytes.  returns the size of the block
+std::size_t Compress(const std::uint8_t* input, std::size_t size,
+                     std::uint8_t* output);
+
+// decompresses the block into output, returning false unless it is well formed
+// and fills exactly outputSize bytes.  a malformed block is never read or
+// written past its bounds
+bool Decompress(const std::uint8_t* input, std::size_t inputSize,
+                std::uint8_t* output, std::size_t outputSize);
+} // namespace lz4
+} // namespace utility
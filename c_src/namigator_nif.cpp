@@ -1,9 +1,19 @@
 // c_src/namigator_nif.cpp
 #include <fine.hpp>
+#include "pathfind/Crowd.hpp"
 #include "pathfind/Map.hpp"
+#include "pathfind/ModelCache.hpp"
+#include "pathfind/PathCorridor.hpp"
+#include "pathfind/QueryPool.hpp"
+#include "pathfind/Teardown.hpp"
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 
 // Type aliases for coordinate tuples
 using Coord = std::tuple<double, double, double>;
@@ -12,6 +22,38 @@ using Path = std::vector<Coord>;
 // Register the Map resource type
 FINE_RESOURCE(pathfind::Map);
 
+// A path corridor, holding a reference to its map so that the map outlives it.
+// The mutex only keeps the corridor itself consistent. Its searches use the
+// map's query object, which is not reentrant, so the corridor must be used
+// only by the process which owns its map, as for any query of the map.
+struct Corridor {
+    Corridor(fine::ResourcePtr<pathfind::Map> map, const std::optional<std::string>& filter)
+        : map(map),
+          corridor(filter ? pathfind::PathCorridor(*map, *filter) : pathfind::PathCorridor(*map)) {}
+
+    fine::ResourcePtr<pathfind::Map> map;
+    std::mutex mutex;
+    pathfind::PathCorridor corridor;
+};
+
+// Register the Corridor resource type
+FINE_RESOURCE(Corridor);
+
+// A crowd of agents on a map, holding a reference to its map so that the map
+// outlives it. The mutex only keeps the crowd itself consistent. Its searches
+// use the map's query object, which is not reentrant, so the crowd must be
+// used only by the process which owns its map, as for any query of the map.
+struct Crowd {
+    explicit Crowd(fine::ResourcePtr<pathfind::Map> map) : map(map), crowd(*map) {}
+
+    fine::ResourcePtr<pathfind::Map> map;
+    std::mutex mutex;
+    pathfind::Crowd crowd;
+};
+
+// Register the Crowd resource type
+FINE_RESOURCE(Crowd);
+
 // Validate map_name to prevent path traversal attacks
 // Only allows alphanumeric characters, underscores, and hyphens
 static bool validate_map_name(const std::string& name) {
@@ -45,6 +87,25 @@ static bool validate_data_path(const std::string& path) {
 static constexpr int ADT_MIN = 0;
 static constexpr int ADT_MAX = 63;
 
+// Tile grid bounds (0-1023 for 1024x1024 grid)
+static constexpr int TILE_MIN = 0;
+static constexpr int TILE_MAX = MeshSettings::TileCount - 1;
+
+// Most columns a single height grid may sample, so that a bad call cannot
+// allocate without bound
+static constexpr int64_t MAX_GRID_COLUMNS = 1 << 20;
+
+// Convert an Elixir coordinate tuple into a namigator vertex
+static math::Vector3 to_vertex(const Coord& coord) {
+    auto [x, y, z] = coord;
+    return math::Vector3{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)};
+}
+
+// Convert a namigator vertex into an Elixir coordinate tuple
+static Coord to_coord(const math::Vector3& vertex) {
+    return Coord{static_cast<double>(vertex.X), static_cast<double>(vertex.Y), static_cast<double>(vertex.Z)};
+}
+
 // Create a new Map resource
 // Uses dirty CPU scheduler since it involves file I/O
 fine::ResourcePtr<pathfind::Map> map_new(ErlNifEnv* env, std::string data_path, std::string map_name) {
@@ -54,7 +115,30 @@ fine::ResourcePtr<pathfind::Map> map_new(ErlNifEnv* env, std::string data_path,
     if (!validate_map_name(map_name)) {
         throw std::runtime_error("invalid map name: must contain only alphanumeric characters, underscores, or hyphens");
     }
-    return fine::make_resource<pathfind::Map>(data_path, map_name);
+    auto map = fine::make_resource<pathfind::Map>(data_path, map_name);
+
+    // the map is destroyed on whichever scheduler collects it, which must not
+    // be held up freeing its tiles
+    map->SetDeferredTeardown(true);
+
+    return map;
+}
+
+// Fork a map for a dungeon instance, sharing its models and instance tables
+fine::ResourcePtr<pathfind::Map> map_fork(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> parent) {
+    return fine::make_resource<pathfind::Map>(*parent, pathfind::Map::Fork{});
+}
+
+// Number of collected maps whose memory has not been freed yet
+int64_t pending_teardowns(ErlNifEnv* env) {
+    return static_cast<int64_t>(pathfind::Teardown::Instance().Pending());
+}
+
+// Enable or disable compacting the trees of models loaded from now on, by any
+// map in the process
+fine::Atom set_compact_models(ErlNifEnv* env, bool enabled) {
+    pathfind::ModelCache::Instance().SetCompact(enabled);
+    return fine::Atom("ok");
 }
 
 // Load all ADTs for a map, return count loaded
@@ -94,6 +178,68 @@ bool map_is_adt_loaded_nif(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
     return map->IsADTLoaded(static_cast<int>(x), static_cast<int>(y));
 }
 
+// Validate tile coordinates are within bounds
+static void validate_tile_coords(int64_t x, int64_t y) {
+    if (x < TILE_MIN || x > TILE_MAX || y < TILE_MIN || y > TILE_MAX) {
+        throw std::invalid_argument("tile coordinates must be between 0 and 1023");
+    }
+}
+
+// Rectangles of tiles are clamped to the grid by the map, so only their
+// conversion to int needs guarding
+static int clamp_tile_coord(int64_t value) {
+    return static_cast<int>(std::clamp<int64_t>(value, TILE_MIN - 1, TILE_MAX + 1));
+}
+
+// Load the tiles within a rectangle of tile coordinates, return count added
+int64_t map_load_tiles(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                       int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y) {
+    return map->LoadTiles(clamp_tile_coord(min_x), clamp_tile_coord(min_y),
+                          clamp_tile_coord(max_x), clamp_tile_coord(max_y));
+}
+
+// Unload the tiles within a rectangle of tile coordinates
+fine::Atom map_unload_tiles(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                            int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y) {
+    map->UnloadTiles(clamp_tile_coord(min_x), clamp_tile_coord(min_y),
+                     clamp_tile_coord(max_x), clamp_tile_coord(max_y));
+    return fine::Atom("ok");
+}
+
+// Load the tiles around a world position, return count added
+int64_t map_load_tiles_around(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                              double x, double y, double radius) {
+    if (!(radius >= 0.0)) {
+        throw std::invalid_argument("radius must not be negative");
+    }
+    return map->LoadTilesAround(static_cast<float>(x), static_cast<float>(y),
+                                static_cast<float>(radius));
+}
+
+// Check if a tile is loaded (called from Elixir wrapper that validates coords)
+bool map_is_tile_loaded_nif(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map, int64_t x, int64_t y) {
+    validate_tile_coords(x, y);
+    return map->IsTileLoaded(static_cast<int>(x), static_cast<int>(y));
+}
+
+// Converts the outcome of a path search into {:ok, [{x, y, z}, ...]} or
+// {:error, :no_path}
+static std::variant<fine::Ok<Path>, fine::Error<fine::Atom>> path_result(
+    bool found,
+    const std::vector<math::Vector3>& output
+) {
+    if (!found) {
+        return fine::Error(fine::Atom("no_path"));
+    }
+
+    Path result;
+    result.reserve(output.size());
+    for (const auto& p : output) {
+        result.emplace_back(static_cast<double>(p.X), static_cast<double>(p.Y), static_cast<double>(p.Z));
+    }
+    return fine::Ok(result);
+}
+
 // Find path between two points
 // Returns {:ok, [{x, y, z}, ...]} on success, {:error, :no_path} on failure
 std::variant<fine::Ok<Path>, fine::Error<fine::Atom>> map_find_path(
@@ -111,16 +257,35 @@ std::variant<fine::Ok<Path>, fine::Error<fine::Atom>> map_find_path(
 
     std::vector<math::Vector3> output;
 
-    if (map->FindPath(start_pos, end_pos, output, allow_partial)) {
-        Path result;
-        result.reserve(output.size());
-        for (const auto& p : output) {
-            result.emplace_back(static_cast<double>(p.X), static_cast<double>(p.Y), static_cast<double>(p.Z));
-        }
-        return fine::Ok(result);
-    } else {
-        return fine::Error(fine::Atom("no_path"));
+    bool found = map->FindPath(start_pos, end_pos, output, allow_partial);
+    return path_result(found, output);
+}
+
+// Find path between two points using a filter registered with map_set_path_filter
+std::variant<fine::Ok<Path>, fine::Error<fine::Atom>> map_find_path_with_filter(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    Coord start,
+    Coord end,
+    bool allow_partial,
+    fine::Atom filter
+) {
+    auto const& name = filter.to_string();
+
+    if (!map->HasPathFilter(name)) {
+        throw std::invalid_argument("unknown path filter :" + name);
     }
+
+    auto [sx, sy, sz] = start;
+    auto [ex, ey, ez] = end;
+
+    math::Vector3 start_pos{static_cast<float>(sx), static_cast<float>(sy), static_cast<float>(sz)};
+    math::Vector3 end_pos{static_cast<float>(ex), static_cast<float>(ey), static_cast<float>(ez)};
+
+    std::vector<math::Vector3> output;
+
+    bool found = map->FindPath(start_pos, end_pos, output, allow_partial, name);
+    return path_result(found, output);
 }
 
 // Find height at position from a source point (scenario 1: walking to point)
@@ -162,6 +327,101 @@ std::variant<fine::Ok<std::vector<double>>, fine::Error<fine::Atom>> map_find_he
     }
 }
 
+// Find the height of many positions in one call (scenario 1 in bulk). sources
+// holds packed native 32-bit float (x, y, z) triples and targets packed (x, y)
+// pairs. Returns the heights as packed floats, and a bitmap with the bit of
+// each query set when its height was found, most significant bit first.
+std::tuple<fine::Term, fine::Term> map_find_heights_batch(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    ErlNifBinary sources,
+    ErlNifBinary targets
+) {
+    constexpr auto source_size = 3 * sizeof(float);
+    constexpr auto target_size = 2 * sizeof(float);
+
+    if (sources.size % source_size != 0 || targets.size % target_size != 0) {
+        throw std::invalid_argument("sources must hold 3 and targets 2 floats per query");
+    }
+
+    auto const count = sources.size / source_size;
+
+    if (targets.size / target_size != count) {
+        throw std::invalid_argument("sources and targets must hold the same number of queries");
+    }
+
+    // binaries are not necessarily aligned for floats
+    std::vector<math::Vertex> source_vertices(count);
+    if (count > 0) {
+        std::memcpy(source_vertices.data(), sources.data, sources.size);
+    }
+
+    std::vector<math::Vector2> target_points;
+    target_points.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        float xy[2];
+        std::memcpy(xy, targets.data + i * target_size, target_size);
+        target_points.emplace_back(xy[0], xy[1]);
+    }
+
+    std::vector<float> heights;
+    std::vector<bool> found;
+    map->FindHeight(source_vertices, target_points, heights, found);
+
+    ERL_NIF_TERM heights_term;
+    auto heights_data = enif_make_new_binary(env, count * sizeof(float), &heights_term);
+    ERL_NIF_TERM valid_term;
+    auto valid_data = enif_make_new_binary(env, (count + 7) / 8, &valid_term);
+
+    if (heights_data == nullptr || valid_data == nullptr) {
+        throw std::runtime_error("failed to allocate result binaries");
+    }
+
+    if (count > 0) {
+        std::memcpy(heights_data, heights.data(), count * sizeof(float));
+    }
+
+    std::memset(valid_data, 0, (count + 7) / 8);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (found[i]) {
+            valid_data[i / 8] |= static_cast<unsigned char>(0x80 >> (i % 8));
+        }
+    }
+
+    return std::make_tuple(fine::Term(heights_term), fine::Term(valid_term));
+}
+
+// Find all heights for a grid of (x, y) columns, starting at (x, y) and step
+// apart, row by row. Every column is answered in a single call.
+std::vector<std::vector<double>> map_find_heights_grid(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    double x,
+    double y,
+    double step,
+    int64_t columns,
+    int64_t rows
+) {
+    if (columns <= 0 || rows <= 0) {
+        throw std::invalid_argument("grid must have at least one column and one row");
+    }
+    // Each is checked on its own first, so that their product cannot overflow
+    if (columns > MAX_GRID_COLUMNS || rows > MAX_GRID_COLUMNS || columns * rows > MAX_GRID_COLUMNS) {
+        throw std::invalid_argument("grid must have at most 1048576 columns in all");
+    }
+
+    std::vector<std::vector<float>> heights;
+    map->FindHeights(static_cast<float>(x), static_cast<float>(y), static_cast<float>(step),
+                     static_cast<int>(columns), static_cast<int>(rows), heights);
+
+    std::vector<std::vector<double>> result;
+    result.reserve(heights.size());
+    for (auto& column : heights) {
+        result.emplace_back(column.begin(), column.end());
+    }
+    return result;
+}
+
 // Check line of sight between two points
 bool map_line_of_sight(
     ErlNifEnv* env,
@@ -196,6 +456,50 @@ std::variant<fine::Ok<uint64_t, uint64_t>, fine::Error<fine::Atom>> map_zone_and
     }
 }
 
+// Get the zone and area IDs of many positions in one call. positions holds
+// packed native 32-bit float (x, y, z) triples. Returns a list with
+// {zone_id, area_id} for each position, or nil where it is not found.
+std::vector<std::optional<std::tuple<uint64_t, uint64_t>>> map_zone_and_area_batch(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    ErlNifBinary positions
+) {
+    constexpr auto position_size = 3 * sizeof(float);
+
+    if (positions.size % position_size != 0) {
+        throw std::invalid_argument("positions must hold 3 floats per position");
+    }
+
+    // binaries are not necessarily aligned for floats
+    std::vector<math::Vertex> vertices(positions.size / position_size);
+    if (!vertices.empty()) {
+        std::memcpy(vertices.data(), positions.data, positions.size);
+    }
+
+    std::vector<unsigned int> zones, areas;
+    std::vector<bool> found;
+    map->ZoneAndArea(vertices, zones, areas, found);
+
+    std::vector<std::optional<std::tuple<uint64_t, uint64_t>>> result(vertices.size());
+    for (std::size_t i = 0; i < vertices.size(); ++i) {
+        if (found[i]) {
+            result[i] = std::make_tuple(static_cast<uint64_t>(zones[i]), static_cast<uint64_t>(areas[i]));
+        }
+    }
+    return result;
+}
+
+// Enable or disable the per-tile raster which answers zone and area lookups
+// over plain terrain without a ray cast
+fine::Atom map_set_zone_area_raster(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    bool enabled
+) {
+    map->SetZoneAreaRaster(enabled);
+    return fine::Atom("ok");
+}
+
 // Find a random point around a circle
 std::variant<fine::Ok<Coord>, fine::Error<fine::Atom>> map_find_random_point_around_circle(
     ErlNifEnv* env,
@@ -236,6 +540,516 @@ std::variant<fine::Ok<Coord>, fine::Error<fine::Atom>> map_find_point_in_between
     }
 }
 
+// Callback sending {tag, guid, :ok | :error} to `notify` once every tile
+// affected by an obstacle has been rebuilt
+static pathfind::GameObjectCallback notify_rebuilt(ErlNifPid notify, const char* tag) {
+    // Called from the rebuild thread, so the message is built in its own env
+    return [notify, tag](std::uint64_t guid, bool success) {
+        ErlNifEnv* msg_env = enif_alloc_env();
+        auto msg = fine::encode(msg_env, std::make_tuple(
+            fine::Atom(tag), static_cast<uint64_t>(guid),
+            fine::Atom(success ? "ok" : "error")));
+        enif_send(nullptr, &notify, msg_env, msg);
+        enif_free_env(msg_env);
+    };
+}
+
+// Add a temporary obstacle (door, gate, ...) for a game object.
+// Returns immediately; the affected tiles are rebuilt on a background thread
+// and their old meshes remain in use until then.  Once every tile is rebuilt,
+// {:namigator_game_object, guid, :ok | :error} is sent to `notify`.
+fine::Atom map_add_game_object(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    uint64_t guid,
+    uint64_t display_id,
+    Coord position,
+    double orientation,
+    ErlNifPid notify
+) {
+    auto [x, y, z] = position;
+    math::Vector3 pos{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)};
+
+    map->AddGameObject(guid, static_cast<unsigned int>(display_id), pos,
+                       static_cast<float>(orientation), -1,
+                       notify_rebuilt(notify, "namigator_game_object"));
+    return fine::Atom("ok");
+}
+
+// Obstacle shapes, as {:cylinder, base_center, radius, height},
+// {:box, corner, opposite_corner} or {:convex, [{x, y}, ...], base_z, height}
+using CylinderShape = std::tuple<fine::Atom, Coord, double, double>;
+using BoxShape = std::tuple<fine::Atom, Coord, Coord>;
+using ConvexShape = std::tuple<fine::Atom, std::vector<std::tuple<double, double>>, double, double>;
+using ShapeTerm = std::variant<CylinderShape, BoxShape, ConvexShape>;
+
+// Convert an obstacle shape term into a namigator obstacle shape
+static pathfind::ObstacleShape to_obstacle_shape(const ShapeTerm& term) {
+    pathfind::ObstacleShape shape;
+
+    if (auto cylinder = std::get_if<CylinderShape>(&term)) {
+        auto& [tag, base, radius, height] = *cylinder;
+        if (tag.to_string() != "cylinder") {
+            throw std::invalid_argument("unknown obstacle shape :" + tag.to_string());
+        }
+        if (radius <= 0.0 || height <= 0.0) {
+            throw std::invalid_argument("cylinder radius and height must be positive");
+        }
+        shape.m_type = pathfind::ObstacleShape::Type::Cylinder;
+        shape.m_position = to_vertex(base);
+        shape.m_radius = static_cast<float>(radius);
+        shape.m_height = static_cast<float>(height);
+    } else if (auto box = std::get_if<BoxShape>(&term)) {
+        auto& [tag, min, max] = *box;
+        if (tag.to_string() != "box") {
+            throw std::invalid_argument("unknown obstacle shape :" + tag.to_string());
+        }
+        shape.m_type = pathfind::ObstacleShape::Type::Box;
+        shape.m_min = to_vertex(min);
+        shape.m_max = to_vertex(max);
+    } else {
+        auto& [tag, footprint, base_z, height] = std::get<ConvexShape>(term);
+        if (tag.to_string() != "convex") {
+            throw std::invalid_argument("unknown obstacle shape :" + tag.to_string());
+        }
+        if (footprint.size() < 3 || footprint.size() > 64) {
+            throw std::invalid_argument("convex footprint must have between 3 and 64 corners");
+        }
+        if (height <= 0.0) {
+            throw std::invalid_argument("convex height must be positive");
+        }
+        shape.m_type = pathfind::ObstacleShape::Type::Convex;
+        shape.m_position = math::Vector3{0.f, 0.f, static_cast<float>(base_z)};
+        shape.m_height = static_cast<float>(height);
+        for (const auto& [x, y] : footprint) {
+            shape.m_footprint.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.f);
+        }
+    }
+
+    return shape;
+}
+
+// Add an obstacle given by its shape. As for game objects, the affected tiles
+// are rebuilt in the background, and {:namigator_obstacle, guid, :ok | :error}
+// is sent to `notify` once they all are
+fine::Atom map_add_obstacle(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    uint64_t guid,
+    ShapeTerm shape,
+    ErlNifPid notify
+) {
+    map->AddObstacle(guid, to_obstacle_shape(shape), notify_rebuilt(notify, "namigator_obstacle"));
+    return fine::Atom("ok");
+}
+
+// Remove an obstacle added with map_add_obstacle, rebuilding the affected
+// tiles in the background. Returns :ok or {:error, :not_found}
+std::variant<fine::Ok<>, fine::Error<fine::Atom>> map_remove_obstacle(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    uint64_t guid,
+    ErlNifPid notify
+) {
+    if (!map->RemoveObstacle(guid, notify_rebuilt(notify, "namigator_obstacle"))) {
+        return fine::Error(fine::Atom("not_found"));
+    }
+    return fine::Ok();
+}
+
+// Number of tile rebuilds queued or in progress for a map
+int64_t map_pending_rebuilds(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map) {
+    return static_cast<int64_t>(map->PendingRebuilds());
+}
+
+// Select the region partitioning used by subsequent tile rebuilds:
+// :watershed (default, best quality), :monotone or :layers (both cheaper)
+fine::Atom map_set_rebuild_partition(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    fine::Atom partition
+) {
+    auto const& name = partition.to_string();
+
+    if (name == "watershed") {
+        map->SetRebuildPartition(pathfind::RegionPartition::Watershed);
+    } else if (name == "monotone") {
+        map->SetRebuildPartition(pathfind::RegionPartition::Monotone);
+    } else if (name == "layers") {
+        map->SetRebuildPartition(pathfind::RegionPartition::Layers);
+    } else {
+        throw std::invalid_argument("partition must be :watershed, :monotone or :layers");
+    }
+
+    return fine::Atom("ok");
+}
+
+// Register a named path filter. The masks and costs are indexed by PolyFlags
+// bit (ground, steep, liquid, wmo, doodad), and each cost must be at least 1.0
+fine::Atom map_set_path_filter(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    fine::Atom name,
+    int64_t include_flags,
+    int64_t exclude_flags,
+    std::vector<double> flag_costs
+) {
+    if (include_flags < 0 || include_flags > 0xFFFF ||
+        exclude_flags < 0 || exclude_flags > 0xFFFF) {
+        throw std::invalid_argument("filter flags must be between 0 and 0xFFFF");
+    }
+
+    if (flag_costs.size() != pathfind::PathFilter::FlagCount) {
+        throw std::invalid_argument("a cost must be given for each of the 5 polygon flags");
+    }
+
+    pathfind::PathFilter filter;
+    filter.m_includeFlags = static_cast<unsigned short>(include_flags);
+    filter.m_excludeFlags = static_cast<unsigned short>(exclude_flags);
+
+    for (std::size_t i = 0; i < flag_costs.size(); ++i) {
+        if (!(flag_costs[i] >= 1.0)) {
+            throw std::invalid_argument("filter costs must be at least 1.0");
+        }
+        filter.m_flagCosts[i] = static_cast<float>(flag_costs[i]);
+    }
+
+    map->SetPathFilter(name.to_string(), filter);
+    return fine::Atom("ok");
+}
+
+// Create a path corridor from start to target, optionally using a registered
+// path filter. Returns {:ok, corridor} or {:error, :no_path}
+std::variant<fine::Ok<fine::ResourcePtr<Corridor>>, fine::Error<fine::Atom>> corridor_new(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map,
+    Coord start,
+    Coord target,
+    std::optional<fine::Atom> filter
+) {
+    std::optional<std::string> filter_name;
+
+    if (filter) {
+        filter_name = filter->to_string();
+        if (!map->HasPathFilter(*filter_name)) {
+            throw std::invalid_argument("unknown path filter :" + *filter_name);
+        }
+    }
+
+    auto corridor = fine::make_resource<Corridor>(map, filter_name);
+
+    if (!corridor->corridor.Reset(to_vertex(start), to_vertex(target))) {
+        return fine::Error(fine::Atom("no_path"));
+    }
+
+    return fine::Ok(corridor);
+}
+
+// Move the agent along the corridor towards position
+// Returns {:ok, {x, y, z}} with the position reached, or {:error, :no_path}
+std::variant<fine::Ok<Coord>, fine::Error<fine::Atom>> corridor_move_position(
+    ErlNifEnv* env,
+    fine::ResourcePtr<Corridor> corridor,
+    Coord position
+) {
+    std::lock_guard<std::mutex> guard(corridor->mutex);
+
+    if (!corridor->corridor.MovePosition(to_vertex(position))) {
+        return fine::Error(fine::Atom("no_path"));
+    }
+
+    return fine::Ok(to_coord(corridor->corridor.Position()));
+}
+
+// Move the target of the corridor, searching again for the end of it if needed
+// Returns {:ok, {x, y, z}} with the point the corridor ends at, or {:error, :no_path}
+std::variant<fine::Ok<Coord>, fine::Error<fine::Atom>> corridor_move_target(
+    ErlNifEnv* env,
+    fine::ResourcePtr<Corridor> corridor,
+    Coord target
+) {
+    std::lock_guard<std::mutex> guard(corridor->mutex);
+
+    if (!corridor->corridor.MoveTarget(to_vertex(target))) {
+        return fine::Error(fine::Atom("no_path"));
+    }
+
+    return fine::Ok(to_coord(corridor->corridor.Target()));
+}
+
+// The next turns of the path from the agent's position, at most max_corners
+Path corridor_corners(ErlNifEnv* env, fine::ResourcePtr<Corridor> corridor, int64_t max_corners) {
+    std::lock_guard<std::mutex> guard(corridor->mutex);
+
+    if (max_corners < 1 || max_corners > 256) {
+        throw std::invalid_argument("max_corners must be between 1 and 256");
+    }
+
+    Path result;
+    for (const auto& corner : corridor->corridor.Corners(static_cast<int>(max_corners))) {
+        result.push_back(to_coord(corner));
+    }
+    return result;
+}
+
+// Whether the corridor ends short of its target because the target is unreachable
+bool corridor_partial(ErlNifEnv* env, fine::ResourcePtr<Corridor> corridor) {
+    std::lock_guard<std::mutex> guard(corridor->mutex);
+    return corridor->corridor.IsPartial();
+}
+
+// Create an empty crowd on a map
+fine::ResourcePtr<Crowd> crowd_new(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map) {
+    return fine::make_resource<Crowd>(map);
+}
+
+// Add an idle agent at the nearest point of the navmesh, optionally using a
+// registered path filter. Returns {:ok, id} or {:error, :not_found}
+std::variant<fine::Ok<uint64_t>, fine::Error<fine::Atom>> crowd_add_agent(
+    ErlNifEnv* env,
+    fine::ResourcePtr<Crowd> crowd,
+    Coord position,
+    double radius,
+    double height,
+    double max_speed,
+    double max_acceleration,
+    std::optional<fine::Atom> filter
+) {
+    if (radius <= 0.0 || height <= 0.0 || max_speed <= 0.0 || max_acceleration <= 0.0) {
+        throw std::invalid_argument("radius, height, max_speed and max_acceleration must be positive");
+    }
+
+    pathfind::Crowd::AgentParams params;
+    params.m_radius = static_cast<float>(radius);
+    params.m_height = static_cast<float>(height);
+    params.m_maxSpeed = static_cast<float>(max_speed);
+    params.m_maxAcceleration = static_cast<float>(max_acceleration);
+
+    std::lock_guard<std::mutex> guard(crowd->mutex);
+
+    std::uint32_t id;
+    bool added;
+
+    if (filter) {
+        auto const filter_name = filter->to_string();
+        if (!crowd->map->HasPathFilter(filter_name)) {
+            throw std::invalid_argument("unknown path filter :" + filter_name);
+        }
+        added = crowd->crowd.AddAgent(to_vertex(position), params, filter_name, id);
+    } else {
+        added = crowd->crowd.AddAgent(to_vertex(position), params, id);
+    }
+
+    if (!added) {
+        return fine::Error(fine::Atom("not_found"));
+    }
+
+    return fine::Ok(static_cast<uint64_t>(id));
+}
+
+// Remove an agent. Returns :ok whether or not the agent existed
+fine::Atom crowd_remove_agent(ErlNifEnv* env, fine::ResourcePtr<Crowd> crowd, uint64_t id) {
+    std::lock_guard<std::mutex> guard(crowd->mutex);
+    crowd->crowd.RemoveAgent(static_cast<std::uint32_t>(id));
+    return fine::Atom("ok");
+}
+
+// Send an agent towards target, or stop it where it is when target is nil
+// Returns :ok, or {:error, :no_path} when the target cannot be reached, in
+// which case the agent stops
+std::variant<fine::Ok<>, fine::Error<fine::Atom>> crowd_set_target(
+    ErlNifEnv* env,
+    fine::ResourcePtr<Crowd> crowd,
+    uint64_t id,
+    std::optional<Coord> target
+) {
+    std::lock_guard<std::mutex> guard(crowd->mutex);
+
+    auto const agent = static_cast<std::uint32_t>(id);
+
+    if (id > UINT32_MAX || !crowd->crowd.HasAgent(agent)) {
+        throw std::invalid_argument("unknown agent " + std::to_string(id));
+    }
+
+    if (!target) {
+        crowd->crowd.Stop(agent);
+        return fine::Ok();
+    }
+
+    if (!crowd->crowd.SetTarget(agent, to_vertex(*target))) {
+        return fine::Error(fine::Atom("no_path"));
+    }
+
+    return fine::Ok();
+}
+
+// Advance every agent by dt seconds, and return all of them as
+// {id, {x, y, z}, {vx, vy, vz}, moving}. A dt of 0 only reads the agents
+std::vector<std::tuple<uint64_t, Coord, Coord, bool>> crowd_update(
+    ErlNifEnv* env,
+    fine::ResourcePtr<Crowd> crowd,
+    double dt
+) {
+    if (dt < 0.0 || dt > 10.0) {
+        throw std::invalid_argument("dt must be between 0 and 10 seconds");
+    }
+
+    std::vector<pathfind::Crowd::AgentState> agents;
+    {
+        std::lock_guard<std::mutex> guard(crowd->mutex);
+        crowd->crowd.Update(static_cast<float>(dt));
+        crowd->crowd.GetAgents(agents);
+    }
+
+    std::vector<std::tuple<uint64_t, Coord, Coord, bool>> result;
+    result.reserve(agents.size());
+    for (const auto& agent : agents) {
+        result.emplace_back(agent.m_id, to_coord(agent.m_position), to_coord(agent.m_velocity), agent.m_moving);
+    }
+    return result;
+}
+
+// Memory held by each loaded tile, as {x, y, navmesh_bytes, heightfield_bytes}
+std::vector<std::tuple<int64_t, int64_t, uint64_t, uint64_t>> map_tile_memory(
+    ErlNifEnv* env,
+    fine::ResourcePtr<pathfind::Map> map
+) {
+    std::vector<std::tuple<int64_t, int64_t, uint64_t, uint64_t>> result;
+
+    for (auto const& tile : map->GetTileMemoryUsage()) {
+        result.emplace_back(tile.m_x, tile.m_y, tile.m_navMesh, tile.m_heightField);
+    }
+
+    return result;
+}
+
+// Queries submitted by the *_async NIFs run on a namigator-owned thread pool
+// instead of a dirty scheduler, and reply to the caller with {ref, result}.
+// The pool is created with the defaults on first use, unless configured first
+static std::mutex query_pool_mutex;
+static std::unique_ptr<pathfind::QueryPool> query_pool;
+
+static pathfind::QueryPool& get_query_pool() {
+    std::lock_guard<std::mutex> guard(query_pool_mutex);
+    if (!query_pool) {
+        query_pool = std::make_unique<pathfind::QueryPool>();
+    }
+    return *query_pool;
+}
+
+// Configure the pool before its first use. A worker count or queue limit of
+// zero means one worker per CPU core, or no limit, respectively
+std::variant<fine::Ok<>, fine::Error<fine::Atom>> async_configure(
+    ErlNifEnv* env, uint64_t workers, uint64_t queue_limit
+) {
+    if (workers > 1024) {
+        throw std::invalid_argument("workers must be at most 1024");
+    }
+
+    std::lock_guard<std::mutex> guard(query_pool_mutex);
+    if (query_pool) {
+        return fine::Error(fine::Atom("already_started"));
+    }
+    query_pool = std::make_unique<pathfind::QueryPool>(workers, queue_limit);
+    return fine::Ok();
+}
+
+// Pool metrics, as {workers, queue_limit, queued, running, maps,
+// deepest_queue, completed, rejected, stolen}
+std::tuple<uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t>
+async_stats(ErlNifEnv* env) {
+    auto const stats = get_query_pool().GetStats();
+    return {stats.m_workers, stats.m_queueLimit, stats.m_queued, stats.m_running,
+            stats.m_keys, stats.m_deepestQueue, stats.m_completed, stats.m_rejected,
+            stats.m_stolen};
+}
+
+using Submitted = std::variant<fine::Ok<fine::Term>, fine::Error<fine::Atom>>;
+
+// Queue a query of the map, whose arguments have already been decoded on the
+// calling scheduler. Returns {:ok, ref}, and once the query has run sends
+// {ref, result} to the caller, or {ref, {:error, message}} if it raised.
+// Returns {:error, :queue_full} if the map already has as many queries queued
+// as the pool allows
+template <typename Query>
+static Submitted submit(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map, Query query) {
+    ErlNifPid caller;
+    enif_self(env, &caller);
+
+    // The reply is built in an env of its own, which is freed with the job
+    // whether or not it runs
+    std::shared_ptr<ErlNifEnv> msg_env(enif_alloc_env(), enif_free_env);
+    auto ref = enif_make_ref(env);
+    auto reply_ref = enif_make_copy(msg_env.get(), ref);
+
+    auto job = [map, query, caller, msg_env, reply_ref]() {
+        ERL_NIF_TERM result;
+        try {
+            result = fine::encode(msg_env.get(), query(msg_env.get()));
+        } catch (const std::exception& e) {
+            result = fine::encode(msg_env.get(), fine::Error(std::string(e.what())));
+        } catch (...) {
+            result = fine::encode(msg_env.get(), fine::Error(std::string("unknown exception thrown within NIF")));
+        }
+        enif_send(nullptr, &caller, msg_env.get(), enif_make_tuple2(msg_env.get(), reply_ref, result));
+    };
+
+    if (!get_query_pool().Submit(map.get(), std::move(job))) {
+        return fine::Error(fine::Atom("queue_full"));
+    }
+    return fine::Ok(fine::Term(ref));
+}
+
+Submitted map_load_all_adts_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map) {
+    return submit(env, map, [map](ErlNifEnv* env) { return fine::Ok(map_load_all_adts(env, map)); });
+}
+
+// Called from Elixir wrapper that validates coords
+Submitted map_load_adt_async_nif(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map, int64_t x, int64_t y) {
+    validate_adt_coords(x, y);
+    return submit(env, map, [=](ErlNifEnv* env) { return map_load_adt_nif(env, map, x, y); });
+}
+
+Submitted map_load_tiles_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                               int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y) {
+    return submit(env, map, [=](ErlNifEnv* env) {
+        return fine::Ok(map_load_tiles(env, map, min_x, min_y, max_x, max_y));
+    });
+}
+
+Submitted map_load_tiles_around_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                                      double x, double y, double radius) {
+    return submit(env, map, [=](ErlNifEnv* env) {
+        return fine::Ok(map_load_tiles_around(env, map, x, y, radius));
+    });
+}
+
+Submitted map_find_path_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                              Coord start, Coord end, bool allow_partial) {
+    return submit(env, map, [=](ErlNifEnv* env) { return map_find_path(env, map, start, end, allow_partial); });
+}
+
+Submitted map_find_path_with_filter_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                                          Coord start, Coord end, bool allow_partial, fine::Atom filter) {
+    return submit(env, map, [=](ErlNifEnv* env) {
+        return map_find_path_with_filter(env, map, start, end, allow_partial, filter);
+    });
+}
+
+Submitted map_find_height_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                                Coord source, double x, double y) {
+    return submit(env, map, [=](ErlNifEnv* env) { return map_find_height(env, map, source, x, y); });
+}
+
+Submitted map_find_heights_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map, double x, double y) {
+    return submit(env, map, [=](ErlNifEnv* env) { return map_find_heights(env, map, x, y); });
+}
+
+Submitted map_line_of_sight_async(ErlNifEnv* env, fine::ResourcePtr<pathfind::Map> map,
+                                  Coord start, Coord stop, bool include_doodads) {
+    return submit(env, map, [=](ErlNifEnv* env) { return map_line_of_sight(env, map, start, stop, include_doodads); });
+}
+
 // Test function
 int64_t test_add(ErlNifEnv* env, int64_t a, int64_t b) {
     return a + b;
@@ -246,6 +1060,9 @@ FINE_NIF(test_add, 0);
 
 // Map creation - involves file I/O, use dirty CPU scheduler
 FINE_NIF(map_new, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_fork, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(set_compact_models, 0);
+FINE_NIF(pending_teardowns, 0);
 
 // ADT loading/unloading - involves file I/O, use dirty CPU scheduler
 FINE_NIF(map_load_all_adts, ERL_NIF_DIRTY_JOB_CPU_BOUND);
@@ -256,17 +1073,81 @@ FINE_NIF(map_unload_adt_nif, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 FINE_NIF(map_has_adt_nif, 0);
 FINE_NIF(map_is_adt_loaded_nif, 0);
 
+// Tile loading/unloading - involves file I/O, use dirty CPU scheduler
+FINE_NIF(map_load_tiles, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_unload_tiles, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_load_tiles_around, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_is_tile_loaded_nif, 0);
+
 // Pathfinding - potentially expensive computation, use dirty CPU scheduler
 FINE_NIF(map_find_path, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_find_path_with_filter, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 FINE_NIF(map_find_height, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 FINE_NIF(map_find_heights, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_find_heights_grid, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_find_heights_batch, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 FINE_NIF(map_line_of_sight, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 // Zone/area lookup - fast hash lookup, use normal scheduler
 FINE_NIF(map_zone_and_area, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_zone_and_area_batch, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_set_zone_area_raster, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 // Spatial queries - can involve pathfinding, use dirty CPU scheduler
 FINE_NIF(map_find_random_point_around_circle, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 FINE_NIF(map_find_point_in_between, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
+// Temporary obstacles - game objects load their model on the caller, and
+// shapes and game objects both take the map's exclusive lock, which may wait
+// behind a query or ADT load, use dirty CPU scheduler; the tiles are rebuilt
+// in background
+FINE_NIF(map_add_game_object, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_add_obstacle, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_remove_obstacle, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(map_pending_rebuilds, 0);
+FINE_NIF(map_set_rebuild_partition, 0);
+
+// Path filters - builds a small cost table, but under the map's exclusive
+// lock, which may wait behind a query or ADT load, use dirty CPU scheduler
+FINE_NIF(map_set_path_filter, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// Path corridors - creating one or moving its target may search, and every
+// other call queries the navmesh under the map's lock, or waits on the
+// corridor's mutex held by a call which does, and so may wait behind a rebuild
+// swap or tile load, use dirty CPU scheduler
+FINE_NIF(corridor_new, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(corridor_move_position, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(corridor_move_target, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(corridor_corners, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(corridor_partial, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// Crowds - stepping moves every agent and may search, adding an agent
+// searches the navmesh under the map's lock, and removing one waits on the
+// crowd's mutex held by calls which do, so each may wait behind a rebuild
+// swap or tile load, use dirty CPU scheduler; an empty crowd is created
+// without either lock, use normal scheduler
+FINE_NIF(crowd_new, 0);
+FINE_NIF(crowd_add_agent, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(crowd_remove_agent, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(crowd_set_target, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(crowd_update, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// Memory reporting - walks every loaded tile under the map's lock, use dirty
+// CPU scheduler
+FINE_NIF(map_tile_memory, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// Pool queries - only queue the query, which runs on the pool, use normal
+// scheduler
+FINE_NIF(async_configure, 0);
+FINE_NIF(async_stats, 0);
+FINE_NIF(map_load_all_adts_async, 0);
+FINE_NIF(map_load_adt_async_nif, 0);
+FINE_NIF(map_load_tiles_async, 0);
+FINE_NIF(map_load_tiles_around_async, 0);
+FINE_NIF(map_find_path_async, 0);
+FINE_NIF(map_find_path_with_filter_async, 0);
+FINE_NIF(map_find_height_async, 0);
+FINE_NIF(map_find_heights_async, 0);
+FINE_NIF(map_line_of_sight_async, 0);
+
 FINE_INIT("Elixir.Namigator.NIF");
@@ -0,0 +1,186 @@
+defmodule Namigator.Async do
+  @moduledoc """
+  Map queries which run on a thread pool owned by namigator, and reply with a
+  message, instead of on a dirty scheduler.
+
+  The functions of `Namigator.Map` run on the VM's dirty CPU schedulers, which
+  every NIF in the VM shares. A slow `Namigator.Map.load_all_adts/1` or a long
+  path search holds one of them for as long as it takes. The functions of
+  this module only queue the query and return `{:ok, ref}` at once. The query
+  runs on namigator's own threads, and the caller is then sent
+  `{ref, result}`, where `result` is what the function of the same name in
+  `Namigator.Map` returns, or `{:error, message}` if the query raised.
+
+  Each map answers one query at a time, and its queries run in the order in
+  which they were submitted. The pool is work-stealing: a map with queries
+  waiting is given to one thread, and the maps of a thread take turns, so a
+  map with many queries queued does not hold up the queries of other maps. A
+  thread with no maps of its own takes the one which has waited longest from
+  another thread.
+
+  A map may be used through `Namigator.Map` while it has queries in flight.
+  Path searches on one map, from either module, take turns on its search
+  state, while lookups such as heights run alongside them. The queries keep
+  the map alive until they have run.
+
+  ## Example
+
+      {:ok, ref} = Namigator.Async.find_path(map, start, stop)
+      # ... do other work, then
+      {:ok, path} = Namigator.Async.await(ref)
+
+  Or, in a GenServer, match `{ref, result}` in `handle_info/2`.
+  """
+
+  alias Namigator.NIF
+
+  @type coord :: {float(), float(), float()}
+  @type submitted :: {:ok, reference()} | {:error, :queue_full}
+
+  @type stats :: %{
+          workers: non_neg_integer(),
+          queue_limit: non_neg_integer(),
+          queued: non_neg_integer(),
+          running: non_neg_integer(),
+          maps: non_neg_integer(),
+          deepest_queue: non_neg_integer(),
+          completed: non_neg_integer(),
+          rejected: non_neg_integer(),
+          stolen: non_neg_integer()
+        }
+
+  @doc """
+  Configure the thread pool, before it is first used.
+
+  The pool is otherwise started with the defaults by the first query.
+
+  ## Options
+
+    * `:workers` - Number of threads. Defaults to one per CPU core.
+    * `:queue_limit` - Most queries which may wait to run for a single map.
+      Queries submitted beyond it return `{:error, :queue_full}`, so that a
+      map which has fallen behind does not grow its queue without bound.
+      Defaults to no limit.
+
+  Returns `{:error, :already_started}` if the pool is already running.
+  """
+  @spec configure(keyword()) :: :ok | {:error, :already_started}
+  def configure(opts \\ []) do
+    workers = Keyword.get(opts, :workers, 0)
+    queue_limit = Keyword.get(opts, :queue_limit, 0)
+
+    unless is_integer(workers) and workers >= 0 do
+      raise ArgumentError, "workers must be a non-negative integer"
+    end
+
+    unless is_integer(queue_limit) and queue_limit >= 0 do
+      raise ArgumentError, "queue_limit must be a non-negative integer"
+    end
+
+    NIF.async_configure(workers, queue_limit)
+  end
+
+  @doc """
+  Report the state of the thread pool.
+
+    * `:queued` and `:running` - Queries waiting to run, and running
+    * `:maps` - Maps with queries queued or running
+    * `:deepest_queue` - Most queries waiting to run for a single map
+    * `:completed` and `:rejected` - Queries run, and queries refused
+      because their map's queue was full, since the pool was started
+    * `:stolen` - Turns of a map taken by a thread from another thread's
+      share of the waiting maps, since the pool was started
+
+  Starts the pool with the defaults if it has not been started.
+  """
+  @spec stats() :: stats()
+  def stats do
+    {workers, queue_limit, queued, running, maps, deepest_queue, completed, rejected, stolen} =
+      NIF.async_stats()
+
+    %{
+      workers: workers,
+      queue_limit: queue_limit,
+      queued: queued,
+      running: running,
+      maps: maps,
+      deepest_queue: deepest_queue,
+      completed: completed,
+      rejected: rejected,
+      stolen: stolen
+    }
+  end
+
+  @doc """
+  Wait for the reply to a query.
+
+  Returns the result of the query, or `{:error, :timeout}` if there is no
+  reply within `timeout` milliseconds. The reply may still arrive later.
+  """
+  @spec await(reference(), timeout()) :: term()
+  def await(ref, timeout \\ 5000) when is_reference(ref) do
+    receive do
+      {^ref, result} -> result
+    after
+      timeout -> {:error, :timeout}
+    end
+  end
+
+  @doc "As `Namigator.Map.load_all_adts/1`."
+  @spec load_all_adts(Namigator.Map.t()) :: submitted()
+  def load_all_adts(%Namigator.Map{ref: ref}) do
+    NIF.map_load_all_adts_async(ref)
+  end
+
+  @doc "As `Namigator.Map.load_adt/3`."
+  @spec load_adt(Namigator.Map.t(), integer(), integer()) :: submitted()
+  def load_adt(%Namigator.Map{ref: ref}, x, y) do
+    NIF.map_load_adt_async(ref, x, y)
+  end
+
+  @doc "As `Namigator.Map.load_tiles/5`."
+  @spec load_tiles(Namigator.Map.t(), integer(), integer(), integer(), integer()) ::
+          submitted()
+  def load_tiles(%Namigator.Map{ref: ref}, min_x, min_y, max_x, max_y)
+      when is_integer(min_x) and is_integer(min_y) and is_integer(max_x) and
+             is_integer(max_y) do
+    NIF.map_load_tiles_async(ref, min_x, min_y, max_x, max_y)
+  end
+
+  @doc "As `Namigator.Map.load_tiles_around/4`."
+  @spec load_tiles_around(Namigator.Map.t(), number(), number(), number()) :: submitted()
+  def load_tiles_around(%Namigator.Map{ref: ref}, x, y, radius)
+      when is_number(x) and is_number(y) and is_number(radius) do
+    NIF.map_load_tiles_around_async(ref, x * 1.0, y * 1.0, radius * 1.0)
+  end
+
+  @doc "As `Namigator.Map.find_path/4`, with the same options."
+  @spec find_path(Namigator.Map.t(), coord(), coord(), keyword()) :: submitted()
+  def find_path(%Namigator.Map{ref: ref}, start, stop, opts \\ []) do
+    allow_partial = Keyword.get(opts, :allow_partial, false)
+
+    case Keyword.get(opts, :filter) do
+      nil -> NIF.map_find_path_async(ref, start, stop, allow_partial)
+      filter -> NIF.map_find_path_with_filter_async(ref, start, stop, allow_partial, filter)
+    end
+  end
+
+  @doc "As `Namigator.Map.find_height/4`."
+  @spec find_height(Namigator.Map.t(), coord(), float(), float()) :: submitted()
+  def find_height(%Namigator.Map{ref: ref}, source, x, y) do
+    NIF.map_find_height_async(ref, source, x, y)
+  end
+
+  @doc "As `Namigator.Map.find_heights/3`."
+  @spec find_heights(Namigator.Map.t(), float(), float()) :: submitted()
+  def find_heights(%Namigator.Map{ref: ref}, x, y) do
+    NIF.map_find_heights_async(ref, x, y)
+  end
+
+  @doc "As `Namigator.Map.line_of_sight?/4`, with the same options."
+  @spec line_of_sight(Namigator.Map.t(), coord(), coord(), keyword()) :: submitted()
+  def line_of_sight(%Namigator.Map{ref: ref}, start, stop, opts \\ []) do
+    include_doodads = Keyword.get(opts, :include_doodads, true)
+    NIF.map_line_of_sight_async(ref, start, stop, include_doodads)
+  end
+end
@@ -0,0 +1,107 @@
+defmodule Namigator.Corridor do
+  @moduledoc """
+  A path corridor for an agent which moves, or chases a target which moves.
+
+  A corridor keeps the polygons of the path between an agent and its target,
+  so that updates adjust the existing path instead of searching for a new one
+  with `Namigator.Map.find_path/4`:
+
+    * `move_position/2` slides the agent along the surface of the navmesh and
+      trims the start of the corridor behind it
+    * `move_target/2` extends the end of the corridor when the target has only
+      moved a short walk, and otherwise searches again for the last part of
+      the path only
+    * `corners/2` returns the next few turns of the path, which is all an agent
+      needs to steer towards
+
+  If a tile the corridor crosses is unloaded or rebuilt around a temporary
+  obstacle, the next update searches for the whole path again.
+
+  The corridor keeps its map alive, and is subject to the same thread safety
+  rules as the map. Calls on a single corridor are serialized.
+
+  ## Example
+
+      {:ok, corridor} = Namigator.Corridor.new(map, npc_position, player_position)
+
+      # each tick
+      {:ok, _end} = Namigator.Corridor.move_target(corridor, player_position)
+      [next | _] = Namigator.Corridor.corners(corridor, 2)
+      # ... step the NPC towards next, then
+      {:ok, npc_position} = Namigator.Corridor.move_position(corridor, stepped_position)
+  """
+
+  alias Namigator.NIF
+
+  @type t :: %__MODULE__{ref: reference()}
+  @type coord :: {float(), float(), float()}
+
+  defstruct [:ref]
+
+  @doc """
+  Create a corridor from `start` to `target` on the given map.
+
+  ## Options
+
+    * `:filter` - Name of a filter registered with
+      `Namigator.Map.set_path_filter/3`. Raises `ArgumentError` if no such
+      filter is registered.
+
+  ## Returns
+
+    * `{:ok, corridor}` - The corridor. If the target cannot be reached, it
+      ends at the nearest reachable point (see `partial?/1`)
+    * `{:error, :no_path}` - Either point is off the navmesh, or they are not
+      connected at all
+  """
+  @spec new(Namigator.Map.t(), coord(), coord(), keyword()) :: {:ok, t()} | {:error, :no_path}
+  def new(%Namigator.Map{ref: map_ref}, start, target, opts \\ []) do
+    case NIF.corridor_new(map_ref, start, target, Keyword.get(opts, :filter)) do
+      {:ok, ref} -> {:ok, %__MODULE__{ref: ref}}
+      {:error, :no_path} -> {:error, :no_path}
+    end
+  end
+
+  @doc """
+  Move the agent towards `position`, constrained to the navmesh.
+
+  Returns `{:ok, position}` with the position actually reached, which should
+  be used as the agent's new position, or `{:error, :no_path}` if the
+  corridor had to be searched for again and no longer exists.
+  """
+  @spec move_position(t(), coord()) :: {:ok, coord()} | {:error, :no_path}
+  def move_position(%__MODULE__{ref: ref}, position) do
+    NIF.corridor_move_position(ref, position)
+  end
+
+  @doc """
+  Move the target of the corridor.
+
+  Returns `{:ok, point}` with the point the corridor now ends at, which is the
+  target unless it cannot be reached, or `{:error, :no_path}` if the target is
+  not reachable at all. The corridor is left unchanged in that case.
+  """
+  @spec move_target(t(), coord()) :: {:ok, coord()} | {:error, :no_path}
+  def move_target(%__MODULE__{ref: ref}, target) do
+    NIF.corridor_move_target(ref, target)
+  end
+
+  @doc """
+  The next turns of the straight path from the agent, at most `max_corners`
+  (1 to 256) of them. The last corner is the end of the corridor, once it is
+  among them.
+  """
+  @spec corners(t(), pos_integer()) :: [coord()]
+  def corners(%__MODULE__{ref: ref}, max_corners \\ 4) do
+    NIF.corridor_corners(ref, max_corners)
+  end
+
+  @doc """
+  Returns `true` if the corridor ends short of its target because the target
+  cannot be reached.
+  """
+  @spec partial?(t()) :: boolean()
+  def partial?(%__MODULE__{ref: ref}) do
+    NIF.corridor_partial(ref)
+  end
+end
@@ -0,0 +1,118 @@
+defmodule Namigator.Crowd do
+  @moduledoc """
+  Agents moving over the navmesh of a map, stepped together once per tick.
+
+  Each agent follows a path corridor towards its target, steers around the
+  other agents and the walls near it, and is kept on the surface of the
+  navmesh. The whole crowd is advanced by a single call to `update/2`, which
+  returns the position and velocity of every agent, so a server ticking
+  hundreds of creatures makes one native call per tick instead of one per
+  creature.
+
+  The crowd keeps its map alive, and is subject to the same thread safety
+  rules as the map. Calls on a single crowd are serialized.
+
+  ## Example
+
+      crowd = Namigator.Crowd.new(map)
+      {:ok, wolf} = Namigator.Crowd.add_agent(crowd, spawn_point, radius: 0.6, max_speed: 8.0)
+      :ok = Namigator.Crowd.set_target(crowd, wolf, player_position)
+
+      # each tick
+      for {id, position, _velocity, _moving} <- Namigator.Crowd.update(crowd, 0.1) do
+        # ... broadcast position of id
+      end
+  """
+
+  alias Namigator.NIF
+
+  @type t :: %__MODULE__{ref: reference()}
+  @type coord :: {float(), float(), float()}
+  @type agent_id :: non_neg_integer()
+  @type agent :: {agent_id(), position :: coord(), velocity :: coord(), moving :: boolean()}
+
+  defstruct [:ref]
+
+  @doc """
+  Create an empty crowd on the given map.
+  """
+  @spec new(Namigator.Map.t()) :: t()
+  def new(%Namigator.Map{ref: map_ref}) do
+    %__MODULE__{ref: NIF.crowd_new(map_ref)}
+  end
+
+  @doc """
+  Add an idle agent at the point of the navmesh nearest to `position`.
+
+  ## Options
+
+    * `:radius` - Radius of the agent (default: 0.5)
+    * `:height` - Height of the agent; agents whose heights do not overlap,
+      such as on different floors, ignore each other (default: 2.0)
+    * `:max_speed` - Speed in yards per second (default: 7.0)
+    * `:max_acceleration` - Acceleration in yards per second squared
+      (default: 20.0)
+    * `:filter` - Name of a filter registered with
+      `Namigator.Map.set_path_filter/3`. Raises `ArgumentError` if no such
+      filter is registered.
+
+  ## Returns
+
+    * `{:ok, id}` - The id of the new agent
+    * `{:error, :not_found}` - There is no navmesh near the position
+  """
+  @spec add_agent(t(), coord(), keyword()) :: {:ok, agent_id()} | {:error, :not_found}
+  def add_agent(%__MODULE__{ref: ref}, position, opts \\ []) do
+    NIF.crowd_add_agent(
+      ref,
+      position,
+      Keyword.get(opts, :radius, 0.5) / 1,
+      Keyword.get(opts, :height, 2.0) / 1,
+      Keyword.get(opts, :max_speed, 7.0) / 1,
+      Keyword.get(opts, :max_acceleration, 20.0) / 1,
+      Keyword.get(opts, :filter)
+    )
+  end
+
+  @doc """
+  Remove an agent from the crowd. Removing an agent which does not exist is
+  not an error.
+  """
+  @spec remove_agent(t(), agent_id()) :: :ok
+  def remove_agent(%__MODULE__{ref: ref}, id) do
+    NIF.crowd_remove_agent(ref, id)
+  end
+
+  @doc """
+  Send an agent towards `target`, from the next `update/2`.
+
+  Returns `:ok`, or `{:error, :no_path}` if the target cannot be reached at
+  all, in which case the agent stops. If only a point near the target can be
+  reached, the agent moves there. Raises `ArgumentError` for an unknown agent.
+  """
+  @spec set_target(t(), agent_id(), coord()) :: :ok | {:error, :no_path}
+  def set_target(%__MODULE__{ref: ref}, id, target) do
+    NIF.crowd_set_target(ref, id, target)
+  end
+
+  @doc """
+  Stop an agent where it is. A stopped agent still gives way to other agents.
+  Raises `ArgumentError` for an unknown agent.
+  """
+  @spec stop(t(), agent_id()) :: :ok
+  def stop(%__MODULE__{ref: ref}, id) do
+    NIF.crowd_set_target(ref, id, nil)
+  end
+
+  @doc """
+  Advance every agent by `dt` seconds (0 to 10) and return all of them, ordered
+  by id, as `{id, position, velocity, moving}`.
+
+  An agent stops moving once it arrives at its target. A `dt` of 0 returns the
+  agents without moving them.
+  """
+  @spec update(t(), number()) :: [agent()]
+  def update(%__MODULE__{ref: ref}, dt) do
+    NIF.crowd_update(ref, dt / 1)
+  end
+end
@@ -55,6 +55,15 @@ defmodule Namigator.Map do
   @type t :: %__MODULE__{ref: reference()}
   @type coord :: {float(), float(), float()}
   @type path :: [coord()]
+  @type partition :: :watershed | :monotone | :layers
+  @type poly_flag :: :ground | :steep | :liquid | :wmo | :doodad
+  @type obstacle_shape ::
+          {:cylinder, coord(), float(), float()}
+          | {:box, coord(), coord()}
+          | {:convex, [{float(), float()}], float(), float()}
+
+  # PolyFlags bits, in the order the NIF expects costs
+  @poly_flags [:ground, :steep, :liquid, :wmo, :doodad]
 
   defstruct [:ref]
 
@@ -86,6 +95,38 @@ defmodule Namigator.Map do
     exception -> {:error, normalize_error(exception)}
   end
 
+  @doc """
+  Create a copy of a map with its own temporary obstacles, such as one per
+  dungeon instance.
+
+  The fork has the same ADTs loaded as `map`. Instead of reading the map's
+  files again, it shares the model index, the static WMO and doodad instance
+  tables and the loaded models with `map`. The navigation mesh of every
+  loaded tile is copied, as the mesh of each map records the links between
+  its tiles: a fork takes as much memory again as the sum of `:navmesh_bytes`
+  in `tile_memory/1` for `map`, and the time to copy that much and link
+  the tiles to each other. The islands and long distance routing graph of
+  `map` are copied rather than found again. The height field of a tile is
+  only loaded once an obstacle is added to that tile of the fork. Path
+  filters and the zone and area raster setting are copied; later changes to
+  either map do not affect the other.
+
+  Fork a map which is used only as a template: `map` may not have any
+  temporary obstacles or rebuilds in progress.
+
+  ## Examples
+
+      {:ok, template} = Namigator.Map.new("/path/to/nav_data", "Deadmines")
+      {:ok, instance} = Namigator.Map.fork(template)
+
+  """
+  @spec fork(t()) :: {:ok, t()} | {:error, term()}
+  def fork(%__MODULE__{ref: ref}) do
+    {:ok, %__MODULE__{ref: NIF.map_fork(ref)}}
+  rescue
+    exception -> {:error, normalize_error(exception)}
+  end
+
   @doc """
   Load all ADTs (Area Data Tiles) for the map.
 
@@ -136,6 +177,60 @@ defmodule Namigator.Map do
     NIF.map_is_adt_loaded(ref, x, y)
   end
 
+  @doc """
+  Load the tiles within a rectangle of tile coordinates, inclusive.
+
+  Each ADT holds 16x16 tiles, so tile coordinates run from 0 to 1023. The
+  rectangle is clipped to the grid. Only the requested tiles are read from a
+  packed map archive, which makes this cheaper than `load_adt/3` when only
+  part of an ADT is needed. An ADT loaded this way in part is not reported as
+  loaded by `adt_loaded?/3` until all of its tiles are.
+
+  Returns the number of tiles added.
+  """
+  @spec load_tiles(t(), integer(), integer(), integer(), integer()) ::
+          {:ok, integer()} | {:error, term()}
+  def load_tiles(%__MODULE__{ref: ref}, min_x, min_y, max_x, max_y)
+      when is_integer(min_x) and is_integer(min_y) and is_integer(max_x) and
+             is_integer(max_y) do
+    {:ok, NIF.map_load_tiles(ref, min_x, min_y, max_x, max_y)}
+  rescue
+    exception -> {:error, normalize_error(exception)}
+  end
+
+  @doc """
+  Unload the tiles within a rectangle of tile coordinates, inclusive.
+  """
+  @spec unload_tiles(t(), integer(), integer(), integer(), integer()) :: :ok
+  def unload_tiles(%__MODULE__{ref: ref}, min_x, min_y, max_x, max_y)
+      when is_integer(min_x) and is_integer(min_y) and is_integer(max_x) and
+             is_integer(max_y) do
+    NIF.map_unload_tiles(ref, min_x, min_y, max_x, max_y)
+  end
+
+  @doc """
+  Load the tiles overlapping the square of half width `radius` centred on the
+  world position (x, y).
+
+  Returns the number of tiles added.
+  """
+  @spec load_tiles_around(t(), number(), number(), number()) ::
+          {:ok, integer()} | {:error, term()}
+  def load_tiles_around(%__MODULE__{ref: ref}, x, y, radius)
+      when is_number(x) and is_number(y) and is_number(radius) do
+    {:ok, NIF.map_load_tiles_around(ref, x * 1.0, y * 1.0, radius * 1.0)}
+  rescue
+    exception -> {:error, normalize_error(exception)}
+  end
+
+  @doc """
+  Check if the tile at tile coordinates (x, y) is currently loaded.
+  """
+  @spec tile_loaded?(t(), integer(), integer()) :: boolean()
+  def tile_loaded?(%__MODULE__{ref: ref}, x, y) do
+    NIF.map_is_tile_loaded(ref, x, y)
+  end
+
   @doc """
   Find a path between two coordinates.
 
@@ -143,12 +238,25 @@ defmodule Namigator.Map do
 
     * `:allow_partial` - If `true`, returns a partial path when the full path
       cannot be found. Defaults to `false`.
+    * `:filter` - Name of a filter registered with `set_path_filter/3`, which
+      decides which polygons the path may cross and what they cost. Raises
+      `ArgumentError` if no such filter is registered.
 
   ## Returns
 
     * `{:ok, path}` - A list of coordinate tuples `{x, y, z}` representing the path
     * `{:error, :no_path}` - No path could be found between the points
 
+  Without `:allow_partial`, points on parts of the mesh which are not connected
+  to each other are rejected without searching for a path.
+
+  Paths between distant points are first routed across tile borders and then
+  searched for one leg at a time, so their length is not limited by the
+  number of polygons a single search may visit. When there is no such route,
+  or a leg of it cannot be searched, a single search is made as for nearby
+  points. The route ignores path filters, so paths found with `:filter` always
+  use a single search.
+
   ## Examples
 
       iex> Namigator.Map.find_path(map, {100.0, 200.0, 50.0}, {150.0, 250.0, 55.0})
@@ -158,7 +266,75 @@ defmodule Namigator.Map do
   @spec find_path(t(), coord(), coord(), keyword()) :: {:ok, path()} | {:error, :no_path}
   def find_path(%__MODULE__{ref: ref}, start, stop, opts \\ []) do
     allow_partial = Keyword.get(opts, :allow_partial, false)
-    NIF.map_find_path(ref, start, stop, allow_partial)
+
+    case Keyword.get(opts, :filter) do
+      nil -> NIF.map_find_path(ref, start, stop, allow_partial)
+      filter -> NIF.map_find_path_with_filter(ref, start, stop, allow_partial, filter)
+    end
+  end
+
+  @doc """
+  Register a named path filter, replacing any filter of the same name.
+
+  Polygons are classified by the flags the map builder gives them: `:ground`,
+  `:steep`, `:liquid`, `:wmo` and `:doodad`. A filter selects the polygons a
+  path may cross, and how much crossing each costs relative to its length.
+
+  ## Options
+
+    * `:include` - Flags of which a polygon must have at least one. Defaults
+      to all flags.
+    * `:exclude` - Flags which a polygon must not have. Defaults to none.
+    * `:costs` - Keyword list of flag cost multipliers, each at least `1.0`.
+      A polygon with several flags costs the product of their multipliers.
+      Flags which are not listed cost `1.0`.
+
+  ## Examples
+
+      iex> Namigator.Map.set_path_filter(map, :avoid_water, costs: [liquid: 10.0])
+      :ok
+
+      iex> Namigator.Map.set_path_filter(map, :land_only, exclude: [:liquid, :steep])
+      :ok
+
+      iex> Namigator.Map.find_path(map, start, stop, filter: :land_only)
+
+  """
+  @spec set_path_filter(t(), atom(), keyword()) :: :ok
+  def set_path_filter(%__MODULE__{ref: ref}, name, opts \\ []) when is_atom(name) do
+    include =
+      case Keyword.fetch(opts, :include) do
+        {:ok, flags} -> flags_to_mask(flags)
+        :error -> 0xFFFF
+      end
+
+    exclude = flags_to_mask(Keyword.get(opts, :exclude, []))
+    costs = Keyword.get(opts, :costs, [])
+
+    Enum.each(Keyword.keys(costs), &flag_bit/1)
+
+    flag_costs = Enum.map(@poly_flags, &(Keyword.get(costs, &1, 1.0) * 1.0))
+
+    NIF.map_set_path_filter(ref, name, include, exclude, flag_costs)
+  end
+
+  defp pack_floats(packed) when is_binary(packed), do: packed
+
+  defp pack_floats(tuples) when is_list(tuples) do
+    for tuple <- tuples, value <- Tuple.to_list(tuple), into: <<>> do
+      <<value::float-32-native>>
+    end
+  end
+
+  defp flags_to_mask(flags) do
+    Enum.reduce(flags, 0, fn flag, mask -> Bitwise.bor(mask, flag_bit(flag)) end)
+  end
+
+  defp flag_bit(flag) do
+    case Enum.find_index(@poly_flags, &(&1 == flag)) do
+      nil -> raise ArgumentError, "unknown polygon flag: #{inspect(flag)}"
+      index -> Bitwise.bsl(1, index)
+    end
   end
 
   @doc """
@@ -195,6 +371,67 @@ defmodule Namigator.Map do
     NIF.map_find_heights(ref, x, y)
   end
 
+  @doc """
+  Find the heights of many positions in one call, as `find_height/4` would
+  for each of them, such as when snapping spawns or loot drops to the ground.
+
+  `sources` and `targets` are either lists of `{x, y, z}` sources and
+  `{x, y}` targets, or binaries packing them as native 32-bit floats, which
+  avoids building lists for large batches. All queries are answered in one
+  call which shares the map lock, tile lookups and query buffers.
+
+  ## Returns
+
+  `{heights, valid}`, where `heights` packs one native 32-bit float per query
+  and `valid` is a bitmap with the bit of each query set when its height was
+  found, most significant bit first. `heights_to_list/2` turns them into a
+  list of `float() | nil`.
+
+  Raises `ArgumentError` unless there are as many sources as targets.
+  """
+  @spec find_heights_batch(t(), [coord()] | binary(), [{float(), float()}] | binary()) ::
+          {binary(), binary()}
+  def find_heights_batch(%__MODULE__{ref: ref}, sources, targets) do
+    NIF.map_find_heights_batch(ref, pack_floats(sources), pack_floats(targets))
+  end
+
+  @doc """
+  Unpack the result of `find_heights_batch/3` into a list with the height of
+  each query, or `nil` where none was found.
+  """
+  @spec heights_to_list(binary(), binary()) :: [float() | nil]
+  def heights_to_list(heights, valid) do
+    found = for <<bit::1 <- valid>>, do: bit == 1
+
+    Enum.zip_with(for(<<z::float-32-native <- heights>>, do: z), found, fn
+      z, true -> z
+      _z, false -> nil
+    end)
+  end
+
+  @doc """
+  Find all possible heights for a grid of (x, y) columns, such as when
+  placing spawns over an area.
+
+  The grid starts at `{x, y}` with columns `step` apart. It is sampled row by
+  row, with `columns` samples along the x axis in each of `rows` rows. Every
+  column is answered in one call, and each is found with a single ray through
+  the tile rather than one per floor.
+
+  ## Returns
+
+  A list with the heights of each column, in the same order as
+  `find_heights/3` returns them, or an empty list where none were found.
+
+  Raises `ArgumentError` unless `columns` and `rows` are positive and the
+  grid has at most 1,048,576 columns in all.
+  """
+  @spec find_heights_grid(t(), {float(), float()}, float(), pos_integer(), pos_integer()) ::
+          [[float()]]
+  def find_heights_grid(%__MODULE__{ref: ref}, {x, y}, step, columns, rows) do
+    NIF.map_find_heights_grid(ref, x / 1, y / 1, step / 1, columns, rows)
+  end
+
   @doc """
   Check if there is a clear line of sight between two points.
 
@@ -230,6 +467,38 @@ defmodule Namigator.Map do
     NIF.map_zone_and_area(ref, position)
   end
 
+  @doc """
+  Get the zone and area IDs of many positions in one call, such as for every
+  player on each tick.
+
+  `positions` is a list of `{x, y, z}` positions, or a binary packing them as
+  native 32-bit floats.
+
+  ## Returns
+
+  A list with `{zone_id, area_id}` for each position, or `nil` where
+  `zone_and_area/2` would return `{:error, :not_found}`.
+  """
+  @spec zone_and_area_batch(t(), [coord()] | binary()) ::
+          [{non_neg_integer(), non_neg_integer()} | nil]
+  def zone_and_area_batch(%__MODULE__{ref: ref}, positions) do
+    NIF.map_zone_and_area_batch(ref, pack_floats(positions))
+  end
+
+  @doc """
+  Enable or disable the zone and area raster.
+
+  When enabled, each loaded tile records which of its terrain quads (about
+  4 yards across) have no static WMO over them. `zone_and_area/2` and
+  `zone_and_area_batch/2` answer positions over those quads from the tile's
+  own IDs, and only cast a ray through the tile's WMOs elsewhere. Applies to
+  tiles already loaded and to tiles loaded later. Disabled by default.
+  """
+  @spec set_zone_area_raster(t(), boolean()) :: :ok
+  def set_zone_area_raster(%__MODULE__{ref: ref}, enabled) do
+    NIF.map_set_zone_area_raster(ref, enabled)
+  end
+
   @doc """
   Find a random navigable point within a circle around the center.
 
@@ -260,6 +529,173 @@ defmodule Namigator.Map do
     NIF.map_find_point_in_between(ref, start, stop, distance)
   end
 
+  @doc """
+  Add a temporary obstacle (such as a door or gate) for a game object.
+
+  The tiles covered by the obstacle are rebuilt in parallel on a pool of
+  background threads shared by every map, so this returns as soon as the
+  model is loaded. Until the rebuild
+  finishes, queries keep using the previous navigation mesh. Once every
+  affected tile has been swapped in, the process given by `:notify` receives:
+
+      {:namigator_game_object, guid, :ok | :error}
+
+  If the map is garbage collected before every rebuild has run, no message is
+  sent.
+
+  A game object is held by the loaded tiles it overlaps. One which overlaps no
+  loaded tile is not kept, and is not applied to tiles loaded later. Once the
+  tiles holding a game object are unloaded, its GUID may be used again.
+
+  ## Options
+
+    * `:notify` - The process to notify on completion. Defaults to `self()`.
+
+  ## Returns
+
+    * `:ok` - The rebuild has been queued
+    * `{:error, reason}` - The GUID is already in use, or the display ID is unknown
+
+  """
+  @spec add_game_object(t(), non_neg_integer(), non_neg_integer(), coord(), float(), keyword()) ::
+          :ok | {:error, term()}
+  def add_game_object(%__MODULE__{ref: ref}, guid, display_id, position, orientation, opts \\ []) do
+    notify = Keyword.get(opts, :notify, self())
+    NIF.map_add_game_object(ref, guid, display_id, position, orientation, notify)
+  rescue
+    exception -> {:error, normalize_error(exception)}
+  end
+
+  @doc """
+  Add a temporary obstacle described by a simple shape rather than a model.
+
+  Each affected tile is rebuilt whole: its height field is expanded and
+  compacted, every shape on the tile is stamped onto it, and it is
+  partitioned and meshed again, so a rebuild costs about as much as one for
+  a game object. Unlike game objects, shapes can be removed again with
+  `remove_obstacle/3`. Once every affected tile has been swapped
+  in, the process given by `:notify` receives:
+
+      {:namigator_obstacle, guid, :ok | :error}
+
+  If the map is garbage collected before every rebuild has run, no message is
+  sent.
+
+  Unlike game objects, shapes are kept by the map rather than by its tiles. A
+  shape overlapping tiles which are not loaded, or which are unloaded, is
+  stamped onto them whenever they are loaded, without a message being sent.
+
+  Shapes are given in world coordinates:
+
+    * `{:cylinder, base_center, radius, height}`
+    * `{:box, corner, opposite_corner}` - An axis aligned box
+    * `{:convex, [{x, y}, ...], base_z, height}` - A convex outline, in
+      order, extruded upwards from `base_z`
+
+  ## Options
+
+    * `:notify` - The process to notify on completion. Defaults to `self()`.
+
+  ## Returns
+
+    * `:ok` - The rebuild has been queued
+    * `{:error, reason}` - The GUID is already in use, or the shape is invalid
+
+  """
+  @spec add_obstacle(t(), non_neg_integer(), obstacle_shape(), keyword()) ::
+          :ok | {:error, term()}
+  def add_obstacle(%__MODULE__{ref: ref}, guid, shape, opts \\ []) do
+    notify = Keyword.get(opts, :notify, self())
+    NIF.map_add_obstacle(ref, guid, shape, notify)
+  rescue
+    exception -> {:error, normalize_error(exception)}
+  end
+
+  @doc """
+  Remove an obstacle added with `add_obstacle/4`.
+
+  The affected tiles are rebuilt in the background, and the process given by
+  `:notify` receives `{:namigator_obstacle, guid, :ok | :error}` once they
+  have all been swapped in.
+
+  ## Options
+
+    * `:notify` - The process to notify on completion. Defaults to `self()`.
+
+  ## Returns
+
+    * `:ok` - The rebuild has been queued
+    * `{:error, :not_found}` - No obstacle has the given GUID
+
+  """
+  @spec remove_obstacle(t(), non_neg_integer(), keyword()) :: :ok | {:error, :not_found}
+  def remove_obstacle(%__MODULE__{ref: ref}, guid, opts \\ []) do
+    notify = Keyword.get(opts, :notify, self())
+    NIF.map_remove_obstacle(ref, guid, notify)
+  end
+
+  @doc """
+  Returns the number of tile rebuilds that are queued or in progress.
+  """
+  @spec pending_rebuilds(t()) :: non_neg_integer()
+  def pending_rebuilds(%__MODULE__{ref: ref}) do
+    NIF.map_pending_rebuilds(ref)
+  end
+
+  @doc """
+  Select how tiles are partitioned into regions when they are rebuilt for a
+  temporary obstacle. Applies to rebuilds queued after the call.
+
+  Rebuilds of different tiles already run in parallel, on a pool with one
+  thread per CPU core shared by every map. The
+  partitioning step is the most expensive part of each rebuild, so a cheaper
+  partition lowers obstacle latency further.
+
+    * `:watershed` - The default. Matches the map builder and gives the best
+      polygons, but is the slowest.
+    * `:monotone` - Much faster, but may produce long, thin polygons.
+    * `:layers` - Faster than watershed, with better polygons than monotone
+      on tiles with overlapping floors.
+
+  Raises `ArgumentError` for any other value.
+  """
+  @spec set_rebuild_partition(t(), partition()) :: :ok
+  def set_rebuild_partition(%__MODULE__{ref: ref}, partition) do
+    NIF.map_set_rebuild_partition(ref, partition)
+  end
+
+  @doc """
+  Report the memory held by each loaded tile.
+
+  The height field of a tile is only loaded once a temporary obstacle has been
+  added to it, and is kept in a packed form between rebuilds.
+
+  ## Returns
+
+  A list with one map per loaded tile:
+
+    * `:x`, `:y` - The tile coordinates
+    * `:navmesh_bytes` - Size of the tile's navigation mesh
+    * `:heightfield_bytes` - Size of the tile's height field, or `0` if it is
+      not loaded
+
+  """
+  @spec tile_memory(t()) :: [
+          %{
+            x: integer(),
+            y: integer(),
+            navmesh_bytes: non_neg_integer(),
+            heightfield_bytes: non_neg_integer()
+          }
+        ]
+  def tile_memory(%__MODULE__{ref: ref}) do
+    ref
+    |> NIF.map_tile_memory()
+    |> Enum.map(fn {x, y, navmesh, heightfield} ->
+      %{x: x, y: y, navmesh_bytes: navmesh, heightfield_bytes: heightfield}
+    end)
+  end
+
   defp normalize_error(exception) do
     message = Exception.message(exception)
 
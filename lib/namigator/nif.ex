@@ -10,6 +10,10 @@ defmodule Namigator.NIF do
   @adt_min 0
   @adt_max 63
 
+  # Tile grid bounds (0-1023 for 1024x1024 grid)
+  @tile_min 0
+  @tile_max 1023
+
   def load_nif do
     path = :filename.join(:code.priv_dir(:namigator), ~c"namigator_nif")
 
@@ -28,6 +32,15 @@ defmodule Namigator.NIF do
     end
   end
 
+  # Validates tile coordinates are within bounds (0-1023)
+  defp validate_tile_coords!(x, y) do
+    unless is_integer(x) and is_integer(y) and
+             x >= @tile_min and x <= @tile_max and
+             y >= @tile_min and y <= @tile_max do
+      raise ArgumentError, "tile coordinates must be between 0 and 1023"
+    end
+  end
+
   # Test function
   @spec test_add(integer(), integer()) :: integer()
   def test_add(_a, _b), do: :erlang.nif_error(:not_loaded)
@@ -36,6 +49,15 @@ defmodule Namigator.NIF do
   @spec map_new(String.t(), String.t()) :: map_ref()
   def map_new(_data_path, _map_name), do: :erlang.nif_error(:not_loaded)
 
+  @spec map_fork(map_ref()) :: map_ref()
+  def map_fork(_map), do: :erlang.nif_error(:not_loaded)
+
+  @spec set_compact_models(boolean()) :: :ok
+  def set_compact_models(_enabled), do: :erlang.nif_error(:not_loaded)
+
+  @spec pending_teardowns() :: non_neg_integer()
+  def pending_teardowns, do: :erlang.nif_error(:not_loaded)
+
   # ADT loading
   @spec map_load_all_adts(map_ref()) :: integer()
   def map_load_all_adts(_map), do: :erlang.nif_error(:not_loaded)
@@ -72,11 +94,35 @@ defmodule Namigator.NIF do
 
   defp map_is_adt_loaded_nif(_map, _x, _y), do: :erlang.nif_error(:not_loaded)
 
+  # Tile loading
+  @spec map_load_tiles(map_ref(), integer(), integer(), integer(), integer()) :: integer()
+  def map_load_tiles(_map, _min_x, _min_y, _max_x, _max_y), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_unload_tiles(map_ref(), integer(), integer(), integer(), integer()) :: :ok
+  def map_unload_tiles(_map, _min_x, _min_y, _max_x, _max_y),
+    do: :erlang.nif_error(:not_loaded)
+
+  @spec map_load_tiles_around(map_ref(), float(), float(), float()) :: integer()
+  def map_load_tiles_around(_map, _x, _y, _radius), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_is_tile_loaded(map_ref(), integer(), integer()) :: boolean()
+  def map_is_tile_loaded(map, x, y) do
+    validate_tile_coords!(x, y)
+    map_is_tile_loaded_nif(map, x, y)
+  end
+
+  defp map_is_tile_loaded_nif(_map, _x, _y), do: :erlang.nif_error(:not_loaded)
+
   # Pathfinding functions
   @spec map_find_path(map_ref(), coord(), coord(), boolean()) ::
           {:ok, [coord()]} | {:error, :no_path}
   def map_find_path(_map, _start, _stop, _allow_partial), do: :erlang.nif_error(:not_loaded)
 
+  @spec map_find_path_with_filter(map_ref(), coord(), coord(), boolean(), atom()) ::
+          {:ok, [coord()]} | {:error, :no_path}
+  def map_find_path_with_filter(_map, _start, _stop, _allow_partial, _filter),
+    do: :erlang.nif_error(:not_loaded)
+
   @spec map_find_height(map_ref(), coord(), float(), float()) ::
           {:ok, float()} | {:error, :not_found}
   def map_find_height(_map, _source, _x, _y), do: :erlang.nif_error(:not_loaded)
@@ -85,6 +131,20 @@ defmodule Namigator.NIF do
           {:ok, [float()]} | {:error, :not_found}
   def map_find_heights(_map, _x, _y), do: :erlang.nif_error(:not_loaded)
 
+  @spec map_find_heights_batch(map_ref(), binary(), binary()) :: {binary(), binary()}
+  def map_find_heights_batch(_map, _sources, _targets), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_find_heights_grid(
+          map_ref(),
+          float(),
+          float(),
+          float(),
+          pos_integer(),
+          pos_integer()
+        ) :: [[float()]]
+  def map_find_heights_grid(_map, _x, _y, _step, _columns, _rows),
+    do: :erlang.nif_error(:not_loaded)
+
   # Spatial query functions
   @spec map_line_of_sight(map_ref(), coord(), coord(), boolean()) :: boolean()
   def map_line_of_sight(_map, _start, _stop, _include_doodads), do: :erlang.nif_error(:not_loaded)
@@ -93,6 +153,13 @@ defmodule Namigator.NIF do
           {:ok, {non_neg_integer(), non_neg_integer()}} | {:error, :not_found}
   def map_zone_and_area(_map, _position), do: :erlang.nif_error(:not_loaded)
 
+  @spec map_zone_and_area_batch(map_ref(), binary()) ::
+          [{non_neg_integer(), non_neg_integer()} | nil]
+  def map_zone_and_area_batch(_map, _positions), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_set_zone_area_raster(map_ref(), boolean()) :: :ok
+  def map_set_zone_area_raster(_map, _enabled), do: :erlang.nif_error(:not_loaded)
+
   @spec map_find_random_point_around_circle(map_ref(), coord(), float()) ::
           {:ok, coord()} | {:error, :not_found}
   def map_find_random_point_around_circle(_map, _center, _radius),
@@ -101,4 +168,119 @@ defmodule Namigator.NIF do
   @spec map_find_point_in_between(map_ref(), coord(), coord(), float()) ::
           {:ok, coord()} | {:error, :not_found}
   def map_find_point_in_between(_map, _start, _stop, _distance), do: :erlang.nif_error(:not_loaded)
+
+  # Temporary obstacle functions
+  @spec map_add_game_object(map_ref(), non_neg_integer(), non_neg_integer(), coord(), float(), pid()) ::
+          :ok
+  def map_add_game_object(_map, _guid, _display_id, _position, _orientation, _notify),
+    do: :erlang.nif_error(:not_loaded)
+
+  @spec map_add_obstacle(map_ref(), non_neg_integer(), tuple(), pid()) :: :ok
+  def map_add_obstacle(_map, _guid, _shape, _notify), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_remove_obstacle(map_ref(), non_neg_integer(), pid()) :: :ok | {:error, :not_found}
+  def map_remove_obstacle(_map, _guid, _notify), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_pending_rebuilds(map_ref()) :: non_neg_integer()
+  def map_pending_rebuilds(_map), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_set_rebuild_partition(map_ref(), :watershed | :monotone | :layers) :: :ok
+  def map_set_rebuild_partition(_map, _partition), do: :erlang.nif_error(:not_loaded)
+
+  # Path filter functions
+  @spec map_set_path_filter(map_ref(), atom(), non_neg_integer(), non_neg_integer(), [float()]) ::
+          :ok
+  def map_set_path_filter(_map, _name, _include, _exclude, _costs),
+    do: :erlang.nif_error(:not_loaded)
+
+  # Path corridor functions
+  @spec corridor_new(map_ref(), coord(), coord(), atom() | nil) ::
+          {:ok, reference()} | {:error, :no_path}
+  def corridor_new(_map, _start, _target, _filter), do: :erlang.nif_error(:not_loaded)
+
+  @spec corridor_move_position(reference(), coord()) :: {:ok, coord()} | {:error, :no_path}
+  def corridor_move_position(_corridor, _position), do: :erlang.nif_error(:not_loaded)
+
+  @spec corridor_move_target(reference(), coord()) :: {:ok, coord()} | {:error, :no_path}
+  def corridor_move_target(_corridor, _target), do: :erlang.nif_error(:not_loaded)
+
+  @spec corridor_corners(reference(), pos_integer()) :: [coord()]
+  def corridor_corners(_corridor, _max_corners), do: :erlang.nif_error(:not_loaded)
+
+  @spec corridor_partial(reference()) :: boolean()
+  def corridor_partial(_corridor), do: :erlang.nif_error(:not_loaded)
+
+  # Crowd functions
+  @spec crowd_new(map_ref()) :: reference()
+  def crowd_new(_map), do: :erlang.nif_error(:not_loaded)
+
+  @spec crowd_add_agent(reference(), coord(), float(), float(), float(), float(), atom() | nil) ::
+          {:ok, non_neg_integer()} | {:error, :not_found}
+  def crowd_add_agent(_crowd, _position, _radius, _height, _max_speed, _max_acceleration, _filter),
+    do: :erlang.nif_error(:not_loaded)
+
+  @spec crowd_remove_agent(reference(), non_neg_integer()) :: :ok
+  def crowd_remove_agent(_crowd, _id), do: :erlang.nif_error(:not_loaded)
+
+  @spec crowd_set_target(reference(), non_neg_integer(), coord() | nil) :: :ok | {:error, :no_path}
+  def crowd_set_target(_crowd, _id, _target), do: :erlang.nif_error(:not_loaded)
+
+  @spec crowd_update(reference(), float()) :: [{non_neg_integer(), coord(), coord(), boolean()}]
+  def crowd_update(_crowd, _dt), do: :erlang.nif_error(:not_loaded)
+
+  # Memory reporting functions
+  @spec map_tile_memory(map_ref()) ::
+          [{integer(), integer(), non_neg_integer(), non_neg_integer()}]
+  def map_tile_memory(_map), do: :erlang.nif_error(:not_loaded)
+
+  # Thread pool functions
+  @type submitted :: {:ok, reference()} | {:error, :queue_full}
+
+  @spec async_configure(non_neg_integer(), non_neg_integer()) ::
+          :ok | {:error, :already_started}
+  def async_configure(_workers, _queue_limit), do: :erlang.nif_error(:not_loaded)
+
+  @spec async_stats() ::
+          {non_neg_integer(), non_neg_integer(), non_neg_integer(), non_neg_integer(),
+           non_neg_integer(), non_neg_integer(), non_neg_integer(), non_neg_integer(),
+           non_neg_integer()}
+  def async_stats, do: :erlang.nif_error(:not_loaded)
+
+  @spec map_load_all_adts_async(map_ref()) :: submitted()
+  def map_load_all_adts_async(_map), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_load_adt_async(map_ref(), integer(), integer()) :: submitted()
+  def map_load_adt_async(map, x, y) do
+    validate_adt_coords!(x, y)
+    map_load_adt_async_nif(map, x, y)
+  end
+
+  defp map_load_adt_async_nif(_map, _x, _y), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_load_tiles_async(map_ref(), integer(), integer(), integer(), integer()) ::
+          submitted()
+  def map_load_tiles_async(_map, _min_x, _min_y, _max_x, _max_y),
+    do: :erlang.nif_error(:not_loaded)
+
+  @spec map_load_tiles_around_async(map_ref(), float(), float(), float()) :: submitted()
+  def map_load_tiles_around_async(_map, _x, _y, _radius), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_find_path_async(map_ref(), coord(), coord(), boolean()) :: submitted()
+  def map_find_path_async(_map, _start, _stop, _allow_partial),
+    do: :erlang.nif_error(:not_loaded)
+
+  @spec map_find_path_with_filter_async(map_ref(), coord(), coord(), boolean(), atom()) ::
+          submitted()
+  def map_find_path_with_filter_async(_map, _start, _stop, _allow_partial, _filter),
+    do: :erlang.nif_error(:not_loaded)
+
+  @spec map_find_height_async(map_ref(), coord(), float(), float()) :: submitted()
+  def map_find_height_async(_map, _source, _x, _y), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_find_heights_async(map_ref(), float(), float()) :: submitted()
+  def map_find_heights_async(_map, _x, _y), do: :erlang.nif_error(:not_loaded)
+
+  @spec map_line_of_sight_async(map_ref(), coord(), coord(), boolean()) :: submitted()
+  def map_line_of_sight_async(_map, _start, _stop, _include_doodads),
+    do: :erlang.nif_error(:not_loaded)
 end
@@ -0,0 +1,113 @@
+defmodule Namigator.AsyncTest do
+  use ExUnit.Case, async: true
+
+  alias Namigator.Async
+  alias Namigator.Map
+
+  describe "configure/1" do
+    test "rejects negative workers" do
+      assert_raise ArgumentError, ~r/workers must be a non-negative integer/, fn ->
+        Async.configure(workers: -1)
+      end
+    end
+
+    test "rejects a non-integer queue limit" do
+      assert_raise ArgumentError, ~r/queue_limit must be a non-negative integer/, fn ->
+        Async.configure(queue_limit: :none)
+      end
+    end
+  end
+
+  describe "stats/0" do
+    test "reports the pool" do
+      stats = Async.stats()
+
+      assert stats.workers > 0
+      assert stats.queued >= 0
+      assert stats.running >= 0
+      assert stats.completed >= 0
+      assert stats.stolen >= 0
+      assert {:error, :already_started} = Async.configure(workers: 2)
+    end
+  end
+
+  describe "await/2" do
+    test "times out without a reply" do
+      assert {:error, :timeout} = Async.await(make_ref(), 0)
+    end
+
+    test "returns the reply to the ref" do
+      ref = make_ref()
+      send(self(), {ref, {:ok, 3}})
+      assert {:ok, 3} = Async.await(ref)
+    end
+  end
+
+  describe "replies" do
+    @describetag :tmp_dir
+
+    # a map without any ADTs, on which every path search and height query
+    # runs and finds nothing
+    setup %{tmp_dir: dir} do
+      File.mkdir_p!(Path.join(dir, "BVH"))
+      File.write!(Path.join([dir, "BVH", "bvh.idx"]), <<0::little-32, 0::little-32>>)
+
+      # the 'MAP1' magic, the terrain flag and an empty ADT bitmap, followed
+      # by no WMO or doodad instances
+      File.write!(
+        Path.join(dir, "Test.map"),
+        <<"1PAM", 1, 0::size(512 * 8), 0::little-32, 0::little-32>>
+      )
+
+      {:ok, map} = Map.new(dir, "Test")
+      %{map: map}
+    end
+
+    test "find_path/4 sends the result of Map.find_path/4", %{map: map} do
+      start = {0.0, 0.0, 0.0}
+      stop = {10.0, 10.0, 0.0}
+
+      assert {:ok, ref} = Async.find_path(map, start, stop)
+      assert_receive {^ref, {:error, :no_path}}, 5_000
+      assert Map.find_path(map, start, stop) == {:error, :no_path}
+    end
+
+    test "find_height/4 sends the result of Map.find_height/4", %{map: map} do
+      source = {0.0, 0.0, 100.0}
+
+      assert {:ok, ref} = Async.find_height(map, source, 0.0, 0.0)
+      assert_receive {^ref, {:error, :not_found}}, 5_000
+      assert Map.find_height(map, source, 0.0, 0.0) == {:error, :not_found}
+    end
+  end
+
+  describe "error handling with invalid refs" do
+    test "load_all_adts/1 raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Async.load_all_adts(map)
+      end
+    end
+
+    test "find_path/4 raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Async.find_path(map, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0})
+      end
+    end
+
+    test "line_of_sight/4 raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Async.line_of_sight(map, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0})
+      end
+    end
+
+    test "load_adt/3 raises for out-of-bounds coordinates" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/ADT coordinates must be between 0 and 63/, fn ->
+        Async.load_adt(map, 64, 0)
+      end
+    end
+  end
+end
@@ -0,0 +1,80 @@
+defmodule Namigator.CorridorTest do
+  use ExUnit.Case, async: true
+
+  alias Namigator.Corridor
+  alias Namigator.Map
+
+  describe "struct definition" do
+    test "Corridor struct fields are correct" do
+      assert Corridor.__struct__() == %Corridor{ref: nil}
+    end
+  end
+
+  describe "error handling with invalid refs" do
+    test "new/4 raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Corridor.new(map, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0})
+      end
+    end
+
+    test "new/4 with filter option raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Corridor.new(map, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, filter: :land_only)
+      end
+    end
+
+    test "move_position/2 raises on invalid ref" do
+      corridor = %Corridor{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Corridor.move_position(corridor, {0.0, 0.0, 0.0})
+      end
+    end
+
+    test "move_target/2 raises on invalid ref" do
+      corridor = %Corridor{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Corridor.move_target(corridor, {0.0, 0.0, 0.0})
+      end
+    end
+
+    test "corners/2 raises on invalid ref" do
+      corridor = %Corridor{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Corridor.corners(corridor, 4)
+      end
+    end
+
+    test "partial?/1 raises on invalid ref" do
+      corridor = %Corridor{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Corridor.partial?(corridor)
+      end
+    end
+  end
+
+  describe "function existence" do
+    test "new/3 and new/4 exist" do
+      assert function_exported?(Corridor, :new, 3)
+      assert function_exported?(Corridor, :new, 4)
+    end
+
+    test "move_position/2 exists" do
+      assert function_exported?(Corridor, :move_position, 2)
+    end
+
+    test "move_target/2 exists" do
+      assert function_exported?(Corridor, :move_target, 2)
+    end
+
+    test "corners/1 and corners/2 exist" do
+      assert function_exported?(Corridor, :corners, 1)
+      assert function_exported?(Corridor, :corners, 2)
+    end
+
+    test "partial?/1 exists" do
+      assert function_exported?(Corridor, :partial?, 1)
+    end
+  end
+end
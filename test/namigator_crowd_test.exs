@@ -0,0 +1,83 @@
+defmodule Namigator.CrowdTest do
+  use ExUnit.Case, async: true
+
+  alias Namigator.Crowd
+  alias Namigator.Map
+
+  describe "struct definition" do
+    test "Crowd struct fields are correct" do
+      assert Crowd.__struct__() == %Crowd{ref: nil}
+    end
+  end
+
+  describe "error handling with invalid refs" do
+    test "new/1 raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Crowd.new(map)
+      end
+    end
+
+    test "add_agent/3 raises on invalid ref" do
+      crowd = %Crowd{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Crowd.add_agent(crowd, {0.0, 0.0, 0.0}, radius: 0.6, filter: :land_only)
+      end
+    end
+
+    test "remove_agent/2 raises on invalid ref" do
+      crowd = %Crowd{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Crowd.remove_agent(crowd, 1)
+      end
+    end
+
+    test "set_target/3 raises on invalid ref" do
+      crowd = %Crowd{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Crowd.set_target(crowd, 1, {0.0, 0.0, 0.0})
+      end
+    end
+
+    test "stop/2 raises on invalid ref" do
+      crowd = %Crowd{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Crowd.stop(crowd, 1)
+      end
+    end
+
+    test "update/2 raises on invalid ref" do
+      crowd = %Crowd{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Crowd.update(crowd, 0.1)
+      end
+    end
+  end
+
+  describe "function existence" do
+    test "new/1 exists" do
+      assert function_exported?(Crowd, :new, 1)
+    end
+
+    test "add_agent/2 and add_agent/3 exist" do
+      assert function_exported?(Crowd, :add_agent, 2)
+      assert function_exported?(Crowd, :add_agent, 3)
+    end
+
+    test "remove_agent/2 exists" do
+      assert function_exported?(Crowd, :remove_agent, 2)
+    end
+
+    test "set_target/3 exists" do
+      assert function_exported?(Crowd, :set_target, 3)
+    end
+
+    test "stop/2 exists" do
+      assert function_exported?(Crowd, :stop, 2)
+    end
+
+    test "update/2 exists" do
+      assert function_exported?(Crowd, :update, 2)
+    end
+  end
+end
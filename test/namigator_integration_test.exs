@@ -102,6 +102,28 @@ defmodule Namigator.IntegrationTest do
         end
       end
     end
+
+    test "unload_tiles and load_tiles work on part of an ADT", context do
+      if context[:map] do
+        exists =
+          for x <- 0..63, y <- 0..63, Map.has_adt?(context.map, x, y), do: {x, y}
+
+        if length(exists) > 0 do
+          {x, y} = hd(exists)
+          {min_x, min_y} = {x * 16, y * 16}
+
+          # Unload one quarter of the ADT
+          assert Map.unload_tiles(context.map, min_x, min_y, min_x + 7, min_y + 7) == :ok
+          assert Map.adt_loaded?(context.map, x, y) == false
+          assert Map.tile_loaded?(context.map, min_x, min_y) == false
+
+          # Loading the whole ADT reads only the missing quarter again
+          assert {:ok, count} = Map.load_tiles(context.map, min_x, min_y, min_x + 15, min_y + 15)
+          assert count <= 64
+          assert Map.adt_loaded?(context.map, x, y) == true
+        end
+      end
+    end
   end
 
   describe "pathfinding with real data" do
@@ -174,6 +196,34 @@ defmodule Namigator.IntegrationTest do
     end
   end
 
+  describe "async queries with real data" do
+    test "find_path replies with the path Map.find_path finds", context do
+      if context[:map] do
+        start = {0.0, 0.0, 0.0}
+        stop = {10.0, 10.0, 0.0}
+
+        assert {:ok, ref} = Namigator.Async.find_path(context.map, start, stop)
+        assert_receive {^ref, result}, 5_000
+        assert result == Map.find_path(context.map, start, stop)
+      end
+    end
+
+    test "find_height replies with the height Map.find_height finds", context do
+      if context[:map] do
+        source = {0.0, 0.0, 100.0}
+
+        assert {:ok, ref} = Namigator.Async.find_height(context.map, source, 0.0, 0.0)
+        assert_receive {^ref, result}, 5_000
+        assert result == Map.find_height(context.map, source, 0.0, 0.0)
+
+        case result do
+          {:ok, z} -> assert is_float(z)
+          {:error, :not_found} -> assert true
+        end
+      end
+    end
+  end
+
   describe "line of sight with real data" do
     test "line_of_sight? returns boolean", context do
       if context[:map] do
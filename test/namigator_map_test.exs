@@ -46,6 +46,14 @@ defmodule Namigator.MapTest do
     end
   end
 
+  describe "fork/1" do
+    test "returns error tuple on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert {:error, reason} = Map.fork(map)
+      assert reason =~ "decode failed"
+    end
+  end
+
   describe "load_all_adts/1" do
     test "returns error tuple on invalid map ref" do
       map = %Map{ref: make_ref()}
@@ -100,6 +108,27 @@ defmodule Namigator.MapTest do
     end
   end
 
+  describe "tile loading" do
+    test "load_tiles/5 returns error tuple on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert {:error, reason} = Map.load_tiles(map, 0, 0, 15, 15)
+      assert is_binary(reason)
+    end
+
+    test "load_tiles_around/4 returns error tuple on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert {:error, reason} = Map.load_tiles_around(map, 0, 0.0, 100.0)
+      assert is_binary(reason)
+    end
+
+    test "tile_loaded?/3 raises for out-of-bounds coordinates" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/tile coordinates must be between 0 and 1023/, fn ->
+        Map.tile_loaded?(map, 1024, 0)
+      end
+    end
+  end
+
   describe "error handling with invalid refs" do
     # All functions should handle invalid map refs gracefully
     # Fine raises ArgumentError with "decode failed" for invalid resource refs
@@ -125,6 +154,20 @@ defmodule Namigator.MapTest do
       end
     end
 
+    test "find_heights_batch/3 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.find_heights_batch(map, [{0.0, 0.0, 0.0}], [{1.0, 1.0}])
+      end
+    end
+
+    test "find_heights_grid/5 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.find_heights_grid(map, {0.0, 0.0}, 1.0, 4, 4)
+      end
+    end
+
     test "line_of_sight?/4 raises on invalid ref" do
       map = %Map{ref: make_ref()}
       assert_raise ArgumentError, ~r/decode failed/, fn ->
@@ -139,6 +182,20 @@ defmodule Namigator.MapTest do
       end
     end
 
+    test "zone_and_area_batch/2 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.zone_and_area_batch(map, [{0.0, 0.0, 0.0}])
+      end
+    end
+
+    test "set_zone_area_raster/2 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.set_zone_area_raster(map, true)
+      end
+    end
+
     test "find_random_point_around_circle/3 raises on invalid ref" do
       map = %Map{ref: make_ref()}
       assert_raise ArgumentError, ~r/decode failed/, fn ->
@@ -173,6 +230,78 @@ defmodule Namigator.MapTest do
         Map.unload_adt(map, 32, 32)
       end
     end
+
+    test "pending_rebuilds/1 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.pending_rebuilds(map)
+      end
+    end
+
+    test "set_rebuild_partition/2 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.set_rebuild_partition(map, :monotone)
+      end
+    end
+
+    test "tile_memory/1 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.tile_memory(map)
+      end
+    end
+
+    test "set_path_filter/3 raises on invalid ref" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.set_path_filter(map, :avoid_water, costs: [liquid: 10.0])
+      end
+    end
+  end
+
+  describe "add_game_object/6" do
+    test "returns error tuple on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert {:error, reason} = Map.add_game_object(map, 1, 1, {0.0, 0.0, 0.0}, 0.0)
+      assert reason =~ "decode failed"
+    end
+
+    test "returns error tuple for a negative guid" do
+      map = %Map{ref: make_ref()}
+      assert {:error, _reason} = Map.add_game_object(map, -1, 1, {0.0, 0.0, 0.0}, 0.0)
+    end
+  end
+
+  describe "heights_to_list/2" do
+    test "returns nil for queries without a height" do
+      heights = <<1.5::float-32-native, 0.0::float-32-native, -2.0::float-32-native>>
+      valid = <<0b10100000>>
+
+      assert Map.heights_to_list(heights, valid) == [1.5, nil, -2.0]
+    end
+
+    test "returns an empty list for an empty batch" do
+      assert Map.heights_to_list(<<>>, <<>>) == []
+    end
+  end
+
+  describe "add_obstacle/4" do
+    test "returns error tuple on invalid map ref" do
+      map = %Map{ref: make_ref()}
+      assert {:error, reason} = Map.add_obstacle(map, 1, {:cylinder, {0.0, 0.0, 0.0}, 1.0, 2.0})
+      assert reason =~ "decode failed"
+    end
+  end
+
+  describe "remove_obstacle/3" do
+    test "raises on invalid map ref" do
+      map = %Map{ref: make_ref()}
+
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.remove_obstacle(map, 1)
+      end
+    end
   end
 
   describe "type specs" do
@@ -198,6 +327,10 @@ defmodule Namigator.MapTest do
       assert function_exported?(Map, :new, 2)
     end
 
+    test "fork/1 exists" do
+      assert function_exported?(Map, :fork, 1)
+    end
+
     test "load_all_adts/1 exists" do
       assert function_exported?(Map, :load_all_adts, 1)
     end
@@ -234,6 +367,14 @@ defmodule Namigator.MapTest do
       assert function_exported?(Map, :find_heights, 3)
     end
 
+    test "find_heights_batch/3 exists" do
+      assert function_exported?(Map, :find_heights_batch, 3)
+    end
+
+    test "find_heights_grid/5 exists" do
+      assert function_exported?(Map, :find_heights_grid, 5)
+    end
+
     # Verify the newly added wrapper function
     @tag :find_heights
     test "find_heights/3 wrapper delegates to NIF" do
@@ -253,6 +394,14 @@ defmodule Namigator.MapTest do
       assert function_exported?(Map, :zone_and_area, 2)
     end
 
+    test "zone_and_area_batch/2 exists" do
+      assert function_exported?(Map, :zone_and_area_batch, 2)
+    end
+
+    test "set_zone_area_raster/2 exists" do
+      assert function_exported?(Map, :set_zone_area_raster, 2)
+    end
+
     test "find_random_point_around_circle/3 exists" do
       assert function_exported?(Map, :find_random_point_around_circle, 3)
     end
@@ -260,6 +409,46 @@ defmodule Namigator.MapTest do
     test "find_point_in_between/4 exists" do
       assert function_exported?(Map, :find_point_in_between, 4)
     end
+
+    test "add_game_object/5 exists (without options)" do
+      assert function_exported?(Map, :add_game_object, 5)
+    end
+
+    test "add_game_object/6 exists (with options)" do
+      assert function_exported?(Map, :add_game_object, 6)
+    end
+
+    test "add_obstacle/3 exists (without options)" do
+      assert function_exported?(Map, :add_obstacle, 3)
+    end
+
+    test "add_obstacle/4 exists (with options)" do
+      assert function_exported?(Map, :add_obstacle, 4)
+    end
+
+    test "remove_obstacle/2 exists (without options)" do
+      assert function_exported?(Map, :remove_obstacle, 2)
+    end
+
+    test "remove_obstacle/3 exists (with options)" do
+      assert function_exported?(Map, :remove_obstacle, 3)
+    end
+
+    test "pending_rebuilds/1 exists" do
+      assert function_exported?(Map, :pending_rebuilds, 1)
+    end
+
+    test "set_rebuild_partition/2 exists" do
+      assert function_exported?(Map, :set_rebuild_partition, 2)
+    end
+
+    test "tile_memory/1 exists" do
+      assert function_exported?(Map, :tile_memory, 1)
+    end
+
+    test "set_path_filter/3 exists" do
+      assert function_exported?(Map, :set_path_filter, 3)
+    end
   end
 
   describe "option parsing" do
@@ -288,6 +477,24 @@ defmodule Namigator.MapTest do
         Map.line_of_sight?(map, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, include_doodads: false)
       end
     end
+
+    test "find_path with filter option" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        Map.find_path(map, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}, filter: :land_only)
+      end
+    end
+
+    test "set_path_filter rejects unknown flags" do
+      map = %Map{ref: make_ref()}
+      assert_raise ArgumentError, ~r/unknown polygon flag/, fn ->
+        Map.set_path_filter(map, :bad, exclude: [:lava])
+      end
+
+      assert_raise ArgumentError, ~r/unknown polygon flag/, fn ->
+        Map.set_path_filter(map, :bad, costs: [lava: 2.0])
+      end
+    end
   end
 
   describe "data path validation" do
@@ -242,11 +242,43 @@ defmodule Namigator.NIFTest do
     end
   end
 
+  describe "tile coordinate bounds validation" do
+    # Tile grid is 1024x1024, valid range is 0-1023
+
+    test "map_is_tile_loaded rejects out-of-bounds coordinates" do
+      assert_raise ArgumentError, ~r/tile coordinates must be between 0 and 1023/, fn ->
+        NIF.map_is_tile_loaded(make_ref(), 1024, 0)
+      end
+
+      assert_raise ArgumentError, ~r/tile coordinates must be between 0 and 1023/, fn ->
+        NIF.map_is_tile_loaded(make_ref(), 0, -1)
+      end
+    end
+
+    test "map_is_tile_loaded accepts boundary coordinates" do
+      assert_raise ArgumentError, ~r/decode failed/, fn ->
+        NIF.map_is_tile_loaded(make_ref(), 0, 1023)
+      end
+    end
+  end
+
   describe "NIF function stubs exist" do
     # Use __info__(:functions) which is more reliable than function_exported?
     # after NIFs have been loaded
     @exported_functions NIF.__info__(:functions)
 
+    test "map_fork/1 stub exists" do
+      assert {:map_fork, 1} in @exported_functions
+    end
+
+    test "set_compact_models/1 stub exists" do
+      assert {:set_compact_models, 1} in @exported_functions
+    end
+
+    test "pending_teardowns/0 stub exists" do
+      assert {:pending_teardowns, 0} in @exported_functions
+    end
+
     test "map_load_all_adts/1 stub exists" do
       assert {:map_load_all_adts, 1} in @exported_functions
     end
@@ -267,6 +299,22 @@ defmodule Namigator.NIFTest do
       assert {:map_is_adt_loaded, 3} in @exported_functions
     end
 
+    test "map_load_tiles/5 stub exists" do
+      assert {:map_load_tiles, 5} in @exported_functions
+    end
+
+    test "map_unload_tiles/5 stub exists" do
+      assert {:map_unload_tiles, 5} in @exported_functions
+    end
+
+    test "map_load_tiles_around/4 stub exists" do
+      assert {:map_load_tiles_around, 4} in @exported_functions
+    end
+
+    test "map_is_tile_loaded/3 stub exists" do
+      assert {:map_is_tile_loaded, 3} in @exported_functions
+    end
+
     test "map_find_path/4 stub exists" do
       assert {:map_find_path, 4} in @exported_functions
     end
@@ -279,6 +327,14 @@ defmodule Namigator.NIFTest do
       assert {:map_find_heights, 3} in @exported_functions
     end
 
+    test "map_find_heights_batch/3 stub exists" do
+      assert {:map_find_heights_batch, 3} in @exported_functions
+    end
+
+    test "map_find_heights_grid/6 stub exists" do
+      assert {:map_find_heights_grid, 6} in @exported_functions
+    end
+
     test "map_line_of_sight/4 stub exists" do
       assert {:map_line_of_sight, 4} in @exported_functions
     end
@@ -287,6 +343,14 @@ defmodule Namigator.NIFTest do
       assert {:map_zone_and_area, 2} in @exported_functions
     end
 
+    test "map_zone_and_area_batch/2 stub exists" do
+      assert {:map_zone_and_area_batch, 2} in @exported_functions
+    end
+
+    test "map_set_zone_area_raster/2 stub exists" do
+      assert {:map_set_zone_area_raster, 2} in @exported_functions
+    end
+
     test "map_find_random_point_around_circle/3 stub exists" do
       assert {:map_find_random_point_around_circle, 3} in @exported_functions
     end
@@ -294,5 +358,93 @@ defmodule Namigator.NIFTest do
     test "map_find_point_in_between/4 stub exists" do
       assert {:map_find_point_in_between, 4} in @exported_functions
     end
+
+    test "map_add_game_object/6 stub exists" do
+      assert {:map_add_game_object, 6} in @exported_functions
+    end
+
+    test "map_add_obstacle/4 stub exists" do
+      assert {:map_add_obstacle, 4} in @exported_functions
+    end
+
+    test "map_remove_obstacle/3 stub exists" do
+      assert {:map_remove_obstacle, 3} in @exported_functions
+    end
+
+    test "map_pending_rebuilds/1 stub exists" do
+      assert {:map_pending_rebuilds, 1} in @exported_functions
+    end
+
+    test "map_set_rebuild_partition/2 stub exists" do
+      assert {:map_set_rebuild_partition, 2} in @exported_functions
+    end
+
+    test "map_tile_memory/1 stub exists" do
+      assert {:map_tile_memory, 1} in @exported_functions
+    end
+
+    test "map_find_path_with_filter/5 stub exists" do
+      assert {:map_find_path_with_filter, 5} in @exported_functions
+    end
+
+    test "map_set_path_filter/5 stub exists" do
+      assert {:map_set_path_filter, 5} in @exported_functions
+    end
+
+    test "corridor_new/4 stub exists" do
+      assert {:corridor_new, 4} in @exported_functions
+    end
+
+    test "corridor_move_position/2 stub exists" do
+      assert {:corridor_move_position, 2} in @exported_functions
+    end
+
+    test "corridor_move_target/2 stub exists" do
+      assert {:corridor_move_target, 2} in @exported_functions
+    end
+
+    test "corridor_corners/2 stub exists" do
+      assert {:corridor_corners, 2} in @exported_functions
+    end
+
+    test "corridor_partial/1 stub exists" do
+      assert {:corridor_partial, 1} in @exported_functions
+    end
+
+    test "crowd_new/1 stub exists" do
+      assert {:crowd_new, 1} in @exported_functions
+    end
+
+    test "crowd_add_agent/7 stub exists" do
+      assert {:crowd_add_agent, 7} in @exported_functions
+    end
+
+    test "crowd_remove_agent/2 stub exists" do
+      assert {:crowd_remove_agent, 2} in @exported_functions
+    end
+
+    test "crowd_set_target/3 stub exists" do
+      assert {:crowd_set_target, 3} in @exported_functions
+    end
+
+    test "crowd_update/2 stub exists" do
+      assert {:crowd_update, 2} in @exported_functions
+    end
+
+    test "async_configure/2 stub exists" do
+      assert {:async_configure, 2} in @exported_functions
+    end
+
+    test "async_stats/0 stub exists" do
+      assert {:async_stats, 0} in @exported_functions
+    end
+
+    test "map_find_path_async/4 stub exists" do
+      assert {:map_find_path_async, 4} in @exported_functions
+    end
+
+    test "map_load_adt_async/3 stub exists" do
+      assert {:map_load_adt_async, 3} in @exported_functions
+    end
   end
 end
@@ -0,0 +1,21 @@
+defmodule NamigatorTest do
+  use ExUnit.Case, async: true
+
+  describe "set_compact_models/1" do
+    test "returns :ok" do
+      assert :ok = Namigator.set_compact_models(false)
+    end
+
+    test "rejects non-boolean values" do
+      assert_raise FunctionClauseError, fn ->
+        Namigator.set_compact_models(:yes)
+      end
+    end
+  end
+
+  describe "pending_teardowns/0" do
+    test "returns a non-negative count" do
+      assert Namigator.pending_teardowns() >= 0
+    end
+  end
+end
@@ -0,0 +1,125 @@
+// rewrites the model files of a navigation data directory from the BVH1
+// format to BVH2, whose vertex, index and node arrays are each loaded with a
+// single copy.  files which are not BVH1 models, including those already in
+// the BVH2 format and the index, are left alone.  the data following the tree
+// in WMO files (name sets and doodad sets) is copied unchanged, and each file
+// is replaced only once its conversion succeeded.
+//
+// build with: make tools
+// run with:   tools/bvh_convert /path/to/nav_data
+
+#include "utility/AABBTree.hpp"
+#include "utility/BinaryStream.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+enum class Outcome
+{
+    Converted,
+    Skipped,
+    Failed,
+};
+
+Outcome Convert(const fs::path& path)
+{
+    utility::BinaryStream in(path);
+
+    if (in.wpos() < sizeof(std::uint32_t) ||
+        !math::AABBTree::IsLegacyFormat(in))
+        return Outcome::Skipped;
+
+    math::AABBTree tree;
+    if (!tree.Deserialize(in))
+        return Outcome::Failed;
+
+    utility::BinaryStream out(in.wpos());
+    tree.Serialize(out);
+
+    // everything after the tree belongs to the model, not the tree
+    std::vector<std::uint8_t> rest(in.wpos() - in.rpos());
+    in.ReadBytes(rest.data(), rest.size());
+    out.Write(rest.data(), rest.size());
+
+    auto const temporary = fs::path(path).concat(".tmp");
+
+    {
+        std::ofstream file(temporary,
+                           std::ofstream::binary | std::ofstream::trunc);
+        file << out;
+
+        if (file.fail())
+            return Outcome::Failed;
+    }
+
+    fs::rename(temporary, path);
+
+    return Outcome::Converted;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <nav data path>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto const bvhPath = fs::path(argv[1]) / "BVH";
+
+    if (!fs::is_directory(bvhPath))
+    {
+        std::cerr << bvhPath.string() << " is not a directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // collected first, as the directory is changed while converting
+    std::vector<fs::path> files;
+    for (auto const& entry : fs::recursive_directory_iterator(bvhPath))
+        if (entry.is_regular_file() && entry.path().filename() != "bvh.idx")
+            files.push_back(entry.path());
+
+    std::size_t converted = 0, skipped = 0, failed = 0;
+
+    for (auto const& file : files)
+    {
+        try
+        {
+            switch (Convert(file))
+            {
+                case Outcome::Converted:
+                    ++converted;
+                    break;
+                case Outcome::Skipped:
+                    ++skipped;
+                    break;
+                case Outcome::Failed:
+                    std::cerr << "could not convert " << file.string()
+                              << std::endl;
+                    ++failed;
+                    break;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "could not convert " << file.string() << ": "
+                      << e.what() << std::endl;
+            ++failed;
+        }
+    }
+
+    std::cout << "converted " << converted << ", skipped " << skipped
+              << ", failed " << failed << std::endl;
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
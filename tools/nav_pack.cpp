@@ -0,0 +1,232 @@
+// packs the nav files of each map of a navigation data directory into a single
+// archive per map (see pathfind::NavArchive), written beside the map's nav
+// directory as Nav/<map>.pack.  maps which have an archive load every adt from
+// it, and no longer touch the loose files, which are left in place.  each
+// file is decompressed and split into its tiles, which are compressed again
+// one by one, so that a tile can be loaded without the rest of its adt.  with
+// --lz4, tiles are compressed with lz4 instead of deflate, which makes the
+// archive larger but loads its tiles faster.  each archive is replaced only
+// once it has been written in full, so the tool can be run again after
+// rebuilding a map.
+//
+// build with: make tools
+// run with:   tools/nav_pack [--lz4] /path/to/nav_data [map ...]
+
+#include "Common.hpp"
+#include "pathfind/NavArchive.hpp"
+#include "pathfind/Tile.hpp"
+#include "utility/BinaryStream.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using pathfind::NavArchive;
+
+namespace
+{
+// the file header of Map.cpp
+struct NavFileHeader
+{
+    std::uint32_t sig;
+    std::uint32_t ver;
+    std::uint32_t kind;
+    std::uint32_t x;
+    std::uint32_t y;
+    std::uint32_t tileCount;
+};
+
+// reads the nav file, and adds it and its compressed tiles to the tables
+bool AddFile(const fs::path& path, utility::Compression compression,
+             std::vector<NavArchive::FileEntry>& files,
+             std::vector<NavArchive::TileEntry>& tiles,
+             std::vector<utility::BinaryStream>& tileData)
+{
+    utility::BinaryStream in(path);
+    in.Decompress();
+
+    NavFileHeader header;
+    in >> header;
+
+    if (header.sig != MeshSettings::FileSignature ||
+        header.ver != MeshSettings::FileVersion)
+        return false;
+
+    NavArchive::FileEntry file;
+    file.m_x = header.x;
+    file.m_y = header.y;
+    file.m_firstTile = static_cast<std::uint32_t>(tiles.size());
+    file.m_tileCount = header.tileCount;
+
+    for (auto i = 0u; i < header.tileCount; ++i)
+    {
+        auto const start = in.rpos();
+
+        NavArchive::TileEntry tile {};
+        in >> tile.m_x >> tile.m_y;
+        in.rpos(start);
+
+        pathfind::Tile::Skip(in);
+
+        if (in.rpos() > in.wpos())
+            return false;
+
+        std::vector<std::uint8_t> bytes(in.rpos() - start);
+        in.rpos(start);
+        in.ReadBytes(bytes.data(), bytes.size());
+
+        tile.m_uncompressedSize = static_cast<std::uint32_t>(bytes.size());
+
+        utility::BinaryStream data(bytes);
+        data.Compress(compression);
+
+        tile.m_size = static_cast<std::uint32_t>(data.wpos());
+
+        tiles.push_back(tile);
+        tileData.push_back(std::move(data));
+    }
+
+    files.push_back(file);
+
+    return true;
+}
+
+bool Pack(const fs::path& navPath, const std::string& mapName,
+          utility::Compression compression)
+{
+    auto const mapPath = navPath / mapName;
+
+    std::vector<NavArchive::FileEntry> files;
+    std::vector<NavArchive::TileEntry> tiles;
+    std::vector<utility::BinaryStream> tileData;
+
+    for (auto const& entry : fs::directory_iterator(mapPath))
+    {
+        if (!entry.is_regular_file() || entry.path().extension() != ".nav")
+            continue;
+
+        if (!AddFile(entry.path(), compression, files, tiles, tileData))
+        {
+            std::cerr << entry.path().string() << " is not a nav file"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (files.empty())
+        return false;
+
+    NavArchive::Header header {NavArchive::Magic, NavArchive::Version,
+                               static_cast<std::uint32_t>(files.size()),
+                               static_cast<std::uint32_t>(tiles.size()),
+                               static_cast<std::uint32_t>(compression)};
+
+    std::uint64_t offset = sizeof(header) +
+                           files.size() * sizeof(NavArchive::FileEntry) +
+                           tiles.size() * sizeof(NavArchive::TileEntry);
+
+    for (auto& tile : tiles)
+    {
+        tile.m_offset = offset;
+        offset += tile.m_size;
+    }
+
+    auto const archivePath = NavArchive::PathFor(navPath.parent_path(), mapName);
+    auto const temporary = fs::path(archivePath).concat(".tmp");
+
+    {
+        std::ofstream out(temporary,
+                          std::ofstream::binary | std::ofstream::trunc);
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        out.write(reinterpret_cast<const char*>(files.data()),
+                  files.size() * sizeof(NavArchive::FileEntry));
+        out.write(reinterpret_cast<const char*>(tiles.data()),
+                  tiles.size() * sizeof(NavArchive::TileEntry));
+
+        for (auto const& data : tileData)
+            out << data;
+
+        if (out.fail())
+            return false;
+    }
+
+    fs::rename(temporary, archivePath);
+
+    // check that the archive can be read back
+    NavArchive archive(archivePath);
+
+    std::cout << mapName << ": " << files.size() << " files, " << tiles.size()
+              << " tiles" << std::endl;
+
+    return true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    auto compression = utility::Compression::Deflate;
+    auto first = 1;
+
+    if (argc > 1 && std::string(argv[1]) == "--lz4")
+    {
+        compression = utility::Compression::Lz4;
+        ++first;
+    }
+
+    if (argc <= first)
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [--lz4] <nav data path> [map ...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto const navPath = fs::path(argv[first]) / "Nav";
+
+    if (!fs::is_directory(navPath))
+    {
+        std::cerr << navPath.string() << " is not a directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> maps(argv + first + 1, argv + argc);
+
+    if (maps.empty())
+        for (auto const& entry : fs::directory_iterator(navPath))
+            if (entry.is_directory())
+                maps.push_back(entry.path().filename().string());
+
+    std::size_t packed = 0, failed = 0;
+
+    for (auto const& map : maps)
+    {
+        try
+        {
+            if (Pack(navPath, map, compression))
+                ++packed;
+            else
+            {
+                std::cerr << "could not pack " << map << std::endl;
+                ++failed;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "could not pack " << map << ": " << e.what()
+                      << std::endl;
+            ++failed;
+        }
+    }
+
+    std::cout << "packed " << packed << ", failed " << failed << std::endl;
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}